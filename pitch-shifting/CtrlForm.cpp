@@ -2,6 +2,9 @@
 #include "../imgui/imgui.h"
 #include "../imgui/imgui_internal.h"
 #include <vector>
+#include <algorithm>
+#include <mutex>
+#include <set>
 
 using std::vector;
 // NOTE: if want to refresh audio sources or files in form GUI, considering:
@@ -72,10 +75,21 @@ int inFileIndex = -1;
 vector<SourceDesc> outFileList;
 int outFileIndex = -1;
 
+// files from scanner threads, taken by render loop
+std::mutex scanLock;
+vector<SourceDesc> scanPending;
+// paths reported by current scan, the others are removed from list once scan completes
+std::set<string> scanSeen;
+bool scanActive = false;
+bool scanCanceled = false;
+// selected or default input file, selected again once the scan lists it
+string scanSelection;
+
 void GLUI::CtrlForm::SetAudioFileList(std::vector<PitchShifting::SourceDesc>& files, char* defInFile, char* defOutFile)
 {
 	inFileList = files;
 	if (defInFile) {
+		scanSelection = defInFile;
 		auto found = std::find_if(inFileList.begin(), inFileList.end(), [&defInFile](SourceDesc& item) {
 			return item.desc == defInFile;
 			});
@@ -129,19 +143,66 @@ void GLUI::CtrlForm::RefreshSourceList() {
 	//sther->ListAudioDevices(anySrc);
 	//SetAudioDeviceList(anySrc, inSrcIndex, outSrcIndex);
 
-	// get current selection
-	char* inFile = nullptr;
+	// keep current selection
 	if (inFileIndex != -1 && inFileIndex < inFileList.size()) {
-		auto len = inFileList[inFileIndex].desc.length() + 1;
-		inFile = (char*)malloc(len);
-#ifdef _WIN32
-		memcpy_s(inFile, len, inFileList[inFileIndex].desc.c_str(), len);
-#else
-		memcpy(inFile, inFileList[inFileIndex].desc.c_str(), len);
-#endif
+		scanSelection = inFileList[inFileIndex].desc;
+	}
+	// no callback from previous scan after cancel
+	sther->CancelLocalScan();
+	{
+		std::lock_guard<std::mutex> guard(scanLock);
+		scanPending.clear();
+	}
+	scanSeen.clear();
+	scanCanceled = false;
+	scanActive = sther->ScanLocalFiles([](const SourceDesc& file) {
+		std::lock_guard<std::mutex> guard(scanLock);
+		scanPending.push_back(file);
+	});
+}
+
+void GLUI::CtrlForm::mergeScannedFiles() {
+	if (!scanActive) return;
+	// check before taking results, the last results are queued before scan turns idle
+	bool completed = !sther->IsScanningLocalFiles();
+	vector<SourceDesc> found;
+	{
+		std::lock_guard<std::mutex> guard(scanLock);
+		found.swap(scanPending);
+	}
+	vector<SourceDesc> files = inFileList;
+	bool changed = false;
+	for (auto& file : found) {
+		scanSeen.insert(file.desc);
+		auto exists = std::find_if(files.begin(), files.end(), [&file](SourceDesc& item) {
+			return item.desc == file.desc;
+			});
+		if (exists == files.end()) {
+			files.push_back(file);
+			changed = true;
+		}
 	}
-	sther->ListLocalFiles(anySrc);
-	SetAudioFileList(anySrc, inFile, nullptr);
+	if (completed) {
+		scanActive = false;
+		// removed or unreadable files since last scan, a canceled scan did not see all of them
+		if (!scanCanceled) {
+			auto removed = std::remove_if(files.begin(), files.end(), [](SourceDesc& item) {
+				return scanSeen.count(item.desc) == 0;
+				});
+			if (removed != files.end()) {
+				files.erase(removed, files.end());
+				changed = true;
+			}
+		}
+	}
+	if (!changed) return;
+	std::sort(files.begin(), files.end(), [](const SourceDesc& a, const SourceDesc& b) {
+		return a.desc < b.desc;
+		});
+	for (int i = 0; i < files.size(); i++) {
+		files[i].index = i;
+	}
+	SetAudioFileList(files, scanSelection.empty() ? nullptr : &scanSelection[0], nullptr);
 }
 
 
@@ -158,6 +219,8 @@ void GLUI::CtrlForm::Render()
 	//ImGui::GetStyle().WindowRounding = 4.f; // change style to the next control
 	ImGui::Begin(ctrlFormName, NULL, ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_AlwaysAutoResize);
 
+	mergeScannedFiles();
+
 	if (ImGui::Button("Set##inputdevice")) {
 		if (OnButtonClicked) {
 			OnButtonClicked(this, ButtonEventArgs(CtrlFormIds::SetInputDeviceButton, &FormData));
@@ -215,8 +278,10 @@ void GLUI::CtrlForm::Render()
 		preview = FormData.InputSource.desc.c_str();
 	}
 	if (ImGui::BeginCombo("Input File", preview)) {
-		// refresh list when open combobox
-		RefreshSourceList();
+		// rescan when open combobox, listed files stay until scan completes
+		if (ImGui::IsWindowAppearing()) {
+			RefreshSourceList();
+		}
 		for (int i = 0; i < inFileList.size(); i++) {
 			const bool isSelected = (inFileIndex == i);
 			if (ImGui::Selectable(inFileList[i].desc.c_str(), inFileIndex)) {
@@ -227,6 +292,14 @@ void GLUI::CtrlForm::Render()
 		}
 		ImGui::EndCombo();
 	}
+	if (scanActive) {
+		ImGui::Text("scanning... %d files", (int)inFileList.size());
+		ImGui::SameLine();
+		if (ImGui::SmallButton("Cancel##scan")) {
+			scanCanceled = true;
+			sther->CancelLocalScan();
+		}
+	}
 
 	ImGui::Text("in: %d, out: %d", FormData.InputSource.index, FormData.OutputSource.index);
 
@@ -53,6 +53,7 @@ public:
 	void(*OnButtonClicked)(void* inst, ButtonEventArgs param) = nullptr;
 
 	void SetStretcher(PitchShifting::Stretcher* sther);
+	/* (re)start background scan of local files, results are merged into file list on render */
 	void RefreshSourceList();
 
 	void SetAudioDeviceList(std::vector<PitchShifting::SourceDesc>& devices, int defInDevIndex = -1, int defOutDevIndex = -1);
@@ -70,6 +71,8 @@ public:
 private:
 	GLFWwindow* parentWindow;
 	const char* ctrlFormName;
+	// move files found by background scan into file list, keeps selection
+	void mergeScannedFiles();
 };
 
 } // namespace GLUI
\ No newline at end of file
@@ -19,8 +19,8 @@ GLUI::RealTimePlot::RealTimePlot(const char* surffix) : PlotChartBase(surffix) {
 	currentTime = 0;
 	elapsedRange = 5.f;
 
-	pitchPtr = nullptr;
-	pitchPtrSize = 0;
+	pitchSeries = nullptr;
+	pitchCursor = 0;
 }
 
 GLUI::RealTimePlot::~RealTimePlot() {
@@ -44,10 +44,13 @@ void GLUI::RealTimePlot::SetAudioInfo(int samplerate, int channels, float* ptr,
 	audioDevice.Buffer = (float*)calloc(audioDevice.Frames * audioDevice.Channels, sizeof(float));
 }
 
-void GLUI::RealTimePlot::SetPitchInfo(double* ptr, int size) {
-	pitchPtr = ptr;
-	pitchPtrSize = size;
-
+void GLUI::RealTimePlot::SetPitchSeries(const PitchShifting::PitchSeries* series) {
+	pitchSeries = series;
+	// only points from now on, the history may belong to previous stream
+	pitchCursor = series ? series->GetCount() : 0;
+	if (series) {
+		pitchPoints.resize(series->GetCapacity());
+	}
 }
 
 void GLUI::RealTimePlot::Update() {
@@ -112,14 +115,17 @@ void GLUI::RealTimePlot::UpdatePlot() {
 		realtimeBuffer[ch].PushBack(currentTime, positive, negative);
 	}
 
-	// fill pitch data if assigned
-	if (pitchPtr && pitchPtrSize > 0) {
-		// normalize all fftSize between 0 to 1.f, find which bin has maximum value for the plot
-		float bin = 0.f;
-		float power = 0.f;
-		// TODO: we need averagely large power of a seminote range instead of which power of bin is largest
-		bin /= pitchPtrSize;
-		pitchBuffer.PushBack(currentTime, bin, power);
+	// fill pitch points tracked since last frame, placed back from current time by their age to the newest one
+	if (pitchSeries) {
+		size_t count = pitchSeries->Read(&pitchCursor, pitchPoints.data(), pitchPoints.size());
+		if (count > 0) {
+			double newest = pitchPoints[count - 1].time;
+			for (size_t i = 0; i < count; i++) {
+				auto& point = pitchPoints[i];
+				// unvoiced points are 0Hz, below the axis range
+				pitchBuffer.PushBack(currentTime - (float)(newest - point.time), point.f0, point.confidence);
+			}
+		}
 	}
 
 	if (ImPlot::BeginPlot(realtimePlotTitle.c_str(), ImVec2(-1, 300))) {
@@ -131,6 +137,10 @@ void GLUI::RealTimePlot::UpdatePlot() {
 		else {
 			ImPlot::SetupAxisLimits(ImAxis_Y1, 0, 1, ImGuiCond_Always);
 		}
+		if (pitchSeries) {
+			ImPlot::SetupAxis(ImAxis_Y2, "Hz", ImPlotAxisFlags_AuxDefault);
+			ImPlot::SetupAxisLimits(ImAxis_Y2, pitchRangeMin, pitchRangeMax, ImGuiCond_Always);
+		}
 		// NOTE: apply to all shaded, or use ImPlot::SetNextFillStyle(IMPLOT_AUTO_COL, 0.25f) to specific
 		ImPlot::PushStyleVar(ImPlotStyleVar_FillAlpha, 0.25f);
 		for (auto ch = 0; ch < audioDevice.Channels; ch++) {
@@ -160,12 +170,13 @@ void GLUI::RealTimePlot::UpdatePlot() {
 				&realtimeBuffer[ch].Amplitudes[0].n,
 				realtimeBuffer[ch].Amplitudes.size(), 0, realtimeBuffer[ch].Offset, 3 * sizeof(float));
 		}
-		// draw pitch
-		if (pitchPtr && pitchPtrSize > 0) {
-			ImPlot::PlotLine("pitch", &pitchBuffer.Amplitudes[0].x, &pitchBuffer.Amplitudes[0].p,
-				pitchBuffer.Amplitudes.size(), 0, pitchBuffer.Offset, 3 * sizeof(float));
-			ImPlot::PlotLine("power(pitch)", &pitchBuffer.Amplitudes[0].x, &pitchBuffer.Amplitudes[0].n,
+		// draw pitch, scatter since unvoiced gaps would be joined by a line
+		if (pitchSeries && pitchBuffer.Amplitudes.size() > 0) {
+			ImPlot::SetAxes(ImAxis_X1, ImAxis_Y2);
+			ImPlot::SetNextMarkerStyle(ImPlotMarker_Circle, 1.5f);
+			ImPlot::PlotScatter("f0", &pitchBuffer.Amplitudes[0].x, &pitchBuffer.Amplitudes[0].p,
 				pitchBuffer.Amplitudes.size(), 0, pitchBuffer.Offset, 3 * sizeof(float));
+			ImPlot::SetAxes(ImAxis_X1, ImAxis_Y1);
 		}
 		ImPlot::PopStyleVar();
 		ImPlot::EndPlot();
@@ -1,6 +1,8 @@
 #pragma once
 /* the realtime time-domain plot chart (separated from Waveform class) */
 #include "Waveform.h"
+#include "pitchtracker.hpp"
+#include <vector>
 
 namespace GLUI {
 
@@ -13,7 +15,8 @@ public:
 	 */
 	void SetAudioInfo(int samplerate, int channels, float* framePtr, int ptrSize);
 
-	void SetPitchInfo(double* pitchPtr, int ptrSize);
+	/* f0 series of the same stream from stretcher, drawn in Hz on the second y axis, null to disable */
+	void SetPitchSeries(const PitchShifting::PitchSeries* series);
 
 	// NOTE: all realtime plot instances will drawing on the same window(the same window id but identical widget id by surffix) 
 	void Update() override;
@@ -46,9 +49,13 @@ private:
 	AmplitudeBuffer realtimeBuffer[2];
 
 	// pitch plot for combination with waveform (likes koixxx app)
-	double* pitchPtr = nullptr;
-	int pitchPtrSize = 0;
+	const PitchShifting::PitchSeries* pitchSeries = nullptr;
+	uint64_t pitchCursor = 0;
+	std::vector<PitchShifting::PitchPoint> pitchPoints;
+	// x time, p f0 in Hz, n confidence
 	AmplitudeBuffer pitchBuffer;
+	float pitchRangeMin = 50.f;
+	float pitchRangeMax = 1000.f;
 
 }; // class
 
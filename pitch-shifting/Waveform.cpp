@@ -24,83 +24,97 @@ Waveform::Waveform(const char* surffix) : PlotChartBase(surffix) {
 }
 
 Waveform::~Waveform() {
-	if (audioFile.Buffer) {
-		delete audioFile.Buffer;
-		audioFile.Buffer = nullptr;
-	}
+	// a running cache job keeps its pending overview alive
+	pending.reset();
+	overview.reset();
 }
 
-bool Waveform::LoadAudioFile(std::string fileName, int* samplerate, int* channels, size_t* frames, float** buf) {
-	// get audio file info via sndfile
-	SNDFILE* f = nullptr;
-	SF_INFO inf = { 0 };
-	SF_INFO* info = &inf;
-	f = sf_open(fileName.c_str(), SFM_READ, info);
-	if (!f) {
-		printf("error read file %s\n", fileName.c_str());
-		return false;
+bool Waveform::LoadAudioFile(std::string fileName, int* samplerate, int* channels, size_t* frames) {
+	// NOTE: only min/max summary is kept, the whole file is never held in memory
+	pending.reset();
+	overview.reset();
+	auto loaded = std::make_unique<WaveformOverview>();
+	uint64_t size = 0;
+	int64_t mtime = 0;
+	bool cached = peakCache && peakCache->IsEnabled() && PitchShifting::PeakCache::GetFileStamp(fileName, &size, &mtime);
+	string peakFile = cached ? peakCache->GetPeakFile(fileName) : string();
+	if (cached && loaded->LoadCache(peakFile, fileName, size, mtime)) {
+		overview = std::move(loaded);
 	}
-	audioFile.SampleRate = info->samplerate;
-	audioFile.Channels = info->channels;
-	audioFile.Frames = info->frames;
-	printf("file %s:\n samplerate:%d, channels:%d, format:%d, frames:%lld\n", fileName.c_str(), info->samplerate, info->channels, info->format, info->frames);
-	// return to caller if specific
-	if (samplerate) *samplerate = info->samplerate;
-	if (channels) *channels = info->channels;
-	if (frames) *frames = info->frames;
-
-	// rebuild data buffer
-	if (audioFile.Buffer) {
-		delete audioFile.Buffer;
+	else if (cached) {
+		// stale or missing peaks, file info from index and rebuild in background
+		PitchShifting::PeakCacheEntry info;
+		if (!peakCache->GetInfo(fileName, &info) || info.sampleRate == 0) {
+			printf("error read file %s\n", fileName.c_str());
+			return false;
+		}
+		audioFile.SampleRate = info.sampleRate;
+		audioFile.Channels = info.channels;
+		audioFile.Frames = (size_t)info.frames;
+		auto job = std::make_shared<PendingOverview>();
+		pending = job;
+		peakCache->Enqueue([job, fileName, peakFile, size, mtime]() {
+			auto built = std::make_unique<WaveformOverview>();
+			// the same file may be rebuilt by previous job already
+			if (!built->LoadCache(peakFile, fileName, size, mtime)) {
+				if (!built->Build(fileName)) return;
+				built->SaveCache(peakFile, size, mtime);
+			}
+			std::lock_guard<std::mutex> guard(job->lock);
+			job->overview = std::move(built);
+		});
 	}
-	// NOTE: it quite huge mem usage from a wave file...
-	audioFile.Buffer = (float*)calloc(audioFile.Frames * audioFile.Channels, sizeof(float));
-	float* tmp = audioFile.Buffer;
-	// read all float audio data
-	size_t read = 0;
-	while (read < info->frames) {
-		int count = sf_readf_float(f, tmp, 2048);
-		tmp += count * info->channels;
-		read += count;
+	else if (loaded->Build(fileName)) {
+		overview = std::move(loaded);
 	}
-	printf("do something to buffer %p\n", audioFile.Buffer);
-	// return to caller if pointer of buffer exists
-	if (buf) *buf = audioFile.Buffer;
-
-	// close file
-	if (f) {
-		sf_close(f);
+	else {
+		return false;
+	}
+	if (overview) {
+		audioFile.SampleRate = overview->GetSampleRate();
+		audioFile.Channels = overview->GetChannels();
+		audioFile.Frames = overview->GetFrames();
 	}
+	printf("file %s:\n samplerate:%d, channels:%d, frames:%zu, overview:%s\n", fileName.c_str(),
+		audioFile.SampleRate, audioFile.Channels, audioFile.Frames,
+		overview ? (cached ? "cached" : "built") : "rebuilding");
+	// return to caller if specific
+	if (samplerate) *samplerate = audioFile.SampleRate;
+	if (channels) *channels = audioFile.Channels;
+	if (frames) *frames = audioFile.Frames;
 
 	// reserve wav plot buffer for second audio channel(maximum only support 2 channels)
 	if (audioFile.Channels > 1) {
 		wavPlotBuffer[1].reserve(PLOT_WIDTH_MAX);
 	}
+	wavPlotBuffer[0].resize(0);
+	wavPlotBuffer[1].resize(0);
+	// force resampling on next plot update
+	wavPlotWidth = 0;
 
 	return true;
 }
 
-void Waveform::ResampleAmplitudes(int width, double begin, double end, int samplerate, int frames, int channels, float* buf, int ch)
+void Waveform::ResampleAmplitudes(int width, double begin, double end)
 {
-	int beginIndex = floor(begin * samplerate);
-	int endIndex = floor(end * samplerate);
+	if (width <= 0) return;
+	int channels = (audioFile.Channels > 2) ? 2 : audioFile.Channels;
+	float* highPtr[2];
+	float* lowPtr[2];
+	for (int ch = 0; ch < channels; ch++) {
+		wavPlotHigh[ch].resize(width);
+		wavPlotLow[ch].resize(width);
+		highPtr[ch] = wavPlotHigh[ch].data();
+		lowPtr[ch] = wavPlotLow[ch].data();
+	}
+	// a min max represent an interval samples per ui width pixel
+	overview->Query(begin * audioFile.SampleRate, end * audioFile.SampleRate, width, highPtr, lowPtr, channels);
 	double interval = (end - begin) / width;
-	int sampleCnt = floor(interval * samplerate);
-	// loop by ui width pixel
-	for (int i = 0; i < width; i++) {
-		int idx = beginIndex + floor(interval * samplerate * i);
-		float high = -1.f;
-		float low = 1.f;
-		// get a min max represent an interval samples
-		GetRangeMinMax(idx, sampleCnt, frames, channels, buf, ch, &high, &low);
-		if (high == -1.f) high = 0.f;
-		if (low == 1.f) low = 0.f;
-		// rescale time(x axis)
-		if (wavPlotBuffer[ch].size() <= i) {
-			wavPlotBuffer[ch].push_back(Amplitude(begin + interval * i, high, low));
-		}
-		else {
-			wavPlotBuffer[ch][i] = Amplitude(begin + interval * i, high, low);
+	for (int ch = 0; ch < channels; ch++) {
+		wavPlotBuffer[ch].resize(width);
+		for (int i = 0; i < width; i++) {
+			// rescale time(x axis)
+			wavPlotBuffer[ch][i] = Amplitude(begin + interval * i, wavPlotHigh[ch][i], wavPlotLow[ch][i]);
 		}
 	}
 }
@@ -111,6 +125,24 @@ void Waveform::UpdatePlot()
 	}
 
 	if (wavPlotEnabled == false) return;
+
+	// take over overview built on peak cache thread
+	if (pending) {
+		std::unique_ptr<WaveformOverview> built;
+		{
+			std::lock_guard<std::mutex> guard(pending->lock);
+			built = std::move(pending->overview);
+		}
+		if (built) {
+			overview = std::move(built);
+			pending.reset();
+			wavPlotWidth = 0;
+		}
+		else {
+			ImGui::SameLine();
+			ImGui::Text("building peaks...");
+		}
+	}
 	
 	if (ImPlot::BeginPlot(wavPlotTitle.c_str(), ImVec2(-1, 300))) {
 		ImPlot::SetupAxes("time", "amp");
@@ -119,11 +151,8 @@ void Waveform::UpdatePlot()
 		auto width = ImPlot::GetPlotSize().x;
 		auto begin = ImPlot::GetPlotLimits().X.Min;
 		auto end = ImPlot::GetPlotLimits().X.Max;
-		if (audioFile.Buffer && (wavPlotWidth != width || wavPlotBegin != begin || wavPlotEnd != end)) {
-			for (auto ch = 0; ch < audioFile.Channels; ch++) {
-				if (ch > 1) break;
-				ResampleAmplitudes(width, begin, end, audioFile.SampleRate, audioFile.Frames, audioFile.Channels, audioFile.Buffer, ch);
-			}
+		if (overview && overview->IsLoaded() && (wavPlotWidth != width || wavPlotBegin != begin || wavPlotEnd != end)) {
+			ResampleAmplitudes(width, begin, end);
 			wavPlotWidth = width;
 			wavPlotBegin = begin;
 			wavPlotEnd = end;
@@ -132,6 +161,8 @@ void Waveform::UpdatePlot()
 		ImPlot::PushStyleVar(ImPlotStyleVar_FillAlpha, 0.25f);
 		for (auto ch = 0; ch < audioFile.Channels; ch++) {
 			if (ch > 1) break;
+			// nothing resampled yet while overview is rebuilding
+			if (wavPlotBuffer[ch].Size < (int)width) continue;
 			ImPlot::SetNextLineStyle(IMPLOT_AUTO_COL);
 			auto label = std::string("ch").append(std::to_string(ch));
 			ImPlot::PlotShaded(label.c_str(),
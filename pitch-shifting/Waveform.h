@@ -6,6 +6,12 @@
 
 // for audio files read/write
 #include <sndfile.h>
+// min/max summary of file for plot instead of whole samples
+#include "WaveformOverview.h"
+// summary loaded from or rebuilt into the local library cache
+#include "peakcache.hpp"
+#include <memory>
+#include <mutex>
 
 // for stretcher ringbuffer
 #include <src/common/RingBuffer.h>
@@ -69,11 +75,15 @@ class Waveform: public PlotChartBase {
 public:
 	/* given surffix for unique ImGui ID generation instead of PushID */
 	Waveform(const char* surffix);
-	/* load audio file to get audio info and read buffer for plot chart drawing */
-	bool LoadAudioFile(std::string fileName, int* samplerate = nullptr, int* channels = nullptr, size_t* frames = nullptr, float** buf = nullptr);
+	/* peak cache owned by stretcher, given nullptr builds overview on every load */
+	void SetPeakCache(PitchShifting::PeakCache* cache) { peakCache = cache; }
+	/* load audio file to get audio info and min/max overview for plot chart drawing,
+	 * overview comes from peak cache if fresh, otherwise it is rebuilt on cache thread and plotted once ready
+	 */
+	bool LoadAudioFile(std::string fileName, int* samplerate = nullptr, int* channels = nullptr, size_t* frames = nullptr);
 
-	/* resampling data based on GUI width, prevent useless plot points redrawing on GUI */
-	void ResampleAmplitudes(int width, double begin, double end, int samplerate, int frames, int channels, float* buf, int ch = 0);
+	/* resampling overview based on GUI width, prevent useless plot points redrawing on GUI */
+	void ResampleAmplitudes(int width, double begin, double end);
 	
 	void UpdatePlot() override; // time-amp plot
 
@@ -85,7 +95,15 @@ private:
 	std::string wavPlotTitle;
 	std::string wavPlotFittingLabel;
 
-	AudioInfo audioFile; // for LoadAudioFile
+	AudioInfo audioFile; // for LoadAudioFile, Buffer is unused
+	std::unique_ptr<WaveformOverview> overview;
+	PitchShifting::PeakCache* peakCache = nullptr;
+	// overview built by peak cache thread, taken over at next plot update, shared with the job for its lifetime
+	struct PendingOverview {
+		std::mutex lock;
+		std::unique_ptr<WaveformOverview> overview;
+	};
+	std::shared_ptr<PendingOverview> pending;
 
 	bool wavPlotEnabled;
 	// for wavform zoom in/out on fill line plot
@@ -93,6 +111,9 @@ private:
 	double wavPlotBegin;
 	double wavPlotEnd;
 	ImVector<Amplitude> wavPlotBuffer[2];
+	// per column min/max from overview query
+	std::vector<float> wavPlotHigh[2];
+	std::vector<float> wavPlotLow[2];
 
 }; // class
 
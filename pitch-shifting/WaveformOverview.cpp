@@ -0,0 +1,283 @@
+#include "WaveformOverview.h"
+#include "kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace GLUI {
+
+static inline int16_t toPeak(float v) {
+	// float files may exceed full scale, plot is fixed in [-1, 1]
+	if (v > 1.f) v = 1.f;
+	if (v < -1.f) v = -1.f;
+	return (int16_t)lrintf(v * 32767.f);
+}
+
+static inline float fromPeak(int16_t v) {
+	return v / 32767.f;
+}
+
+WaveformOverview::~WaveformOverview() {
+	Close();
+}
+
+bool WaveformOverview::Build(std::string fileName, int chunk) {
+	Close();
+	SF_INFO info;
+	memset(&info, 0, sizeof(SF_INFO));
+	file = sf_open(fileName.c_str(), SFM_READ, &info);
+	if (!file) {
+		printf("error read file %s\n", fileName.c_str());
+		return false;
+	}
+	sampleRate = info.samplerate;
+	channels = info.channels;
+	frames = (size_t)info.frames;
+	// keep chunks aligned to bins, a bin never spans two reads except the last one
+	chunkFrames = std::max(BIN_FRAMES, chunk / BIN_FRAMES * BIN_FRAMES);
+	readBuffer.resize((size_t)chunkFrames * channels);
+
+	size_t binCount = (frames + BIN_FRAMES - 1) / BIN_FRAMES;
+	levels.assign(1, std::vector<std::vector<Peak>>(channels));
+	for (auto& b : levels[0]) b.reserve(binCount);
+	std::vector<float> low(channels), high(channels);
+
+	size_t read = 0;
+	while (read < frames) {
+		sf_count_t count = sf_readf_float(file, readBuffer.data(), chunkFrames);
+		if (count <= 0) break;
+		for (sf_count_t i = 0; i < count; i += BIN_FRAMES) {
+			sf_count_t len = std::min((sf_count_t)BIN_FRAMES, count - i);
+			PitchShifting::InterleavedMinMax(readBuffer.data() + (size_t)i * channels, channels, (size_t)len, low.data(), high.data());
+			for (int ch = 0; ch < channels; ch++) {
+				levels[0][ch].push_back(Peak{ toPeak(low[ch]), toPeak(high[ch]) });
+			}
+		}
+		read += count;
+	}
+	// header may claim more frames than decodable, trust what was read
+	frames = read;
+
+	// reduce each level by LEVEL_FACTOR until a single bin covers the file
+	while (channels > 0 && levels.back()[0].size() > 1) {
+		std::vector<std::vector<Peak>> next(channels);
+		for (int ch = 0; ch < channels; ch++) {
+			auto& src = levels.back()[ch];
+			auto& dst = next[ch];
+			dst.reserve((src.size() + LEVEL_FACTOR - 1) / LEVEL_FACTOR);
+			for (size_t i = 0; i < src.size(); i += LEVEL_FACTOR) {
+				Peak peak = src[i];
+				size_t end = std::min(src.size(), i + LEVEL_FACTOR);
+				for (size_t j = i + 1; j < end; j++) {
+					peak.min = std::min(peak.min, src[j].min);
+					peak.max = std::max(peak.max, src[j].max);
+				}
+				dst.push_back(peak);
+			}
+		}
+		levels.push_back(std::move(next));
+	}
+	return true;
+}
+
+// peak cache file layout, host endian: header, then per level the bin count and bins of each channel
+struct PeakCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t size;
+	int64_t mtime;
+	int32_t sampleRate;
+	int32_t channels;
+	uint64_t frames;
+	int32_t binFrames;
+	int32_t levelFactor;
+	int32_t levels;
+	int32_t reserved;
+};
+static const char peakMagic[4] = { 'P', 'S', 'P', 'K' };
+
+bool WaveformOverview::SaveCache(std::string cacheFile, uint64_t size, int64_t mtime) const {
+	if (levels.empty() || cacheFile.empty()) return false;
+	PeakCacheHeader header{};
+	memcpy(header.magic, peakMagic, sizeof(peakMagic));
+	header.version = 1;
+	header.size = size;
+	header.mtime = mtime;
+	header.sampleRate = sampleRate;
+	header.channels = channels;
+	header.frames = frames;
+	header.binFrames = BIN_FRAMES;
+	header.levelFactor = LEVEL_FACTOR;
+	header.levels = (int32_t)levels.size();
+	// write aside and replace, a reader never sees a partial file
+	std::string tmpFile = cacheFile + ".tmp";
+	{
+		std::ofstream out(tmpFile, std::ios::binary | std::ios::trunc);
+		if (!out) return false;
+		out.write((const char*)&header, sizeof(header));
+		for (auto& level : levels) {
+			uint64_t count = level[0].size();
+			out.write((const char*)&count, sizeof(count));
+			for (auto& b : level) {
+				out.write((const char*)b.data(), b.size() * sizeof(Peak));
+			}
+		}
+		if (!out) return false;
+	}
+	remove(cacheFile.c_str());
+	return rename(tmpFile.c_str(), cacheFile.c_str()) == 0;
+}
+
+bool WaveformOverview::LoadCache(std::string cacheFile, std::string fileName, uint64_t size, int64_t mtime, int chunk) {
+	Close();
+	if (cacheFile.empty()) return false;
+	std::ifstream in(cacheFile, std::ios::binary);
+	if (!in) return false;
+	PeakCacheHeader header;
+	if (!in.read((char*)&header, sizeof(header)) || memcmp(header.magic, peakMagic, sizeof(peakMagic)) != 0 ||
+		header.version != 1 || header.size != size || header.mtime != mtime ||
+		header.binFrames != BIN_FRAMES || header.levelFactor != LEVEL_FACTOR ||
+		header.channels <= 0 || header.levels <= 0) {
+		return false;
+	}
+	// the largest level must be what the frames give, otherwise file is corrupted
+	size_t expected = ((size_t)header.frames + BIN_FRAMES - 1) / BIN_FRAMES;
+	std::vector<std::vector<std::vector<Peak>>> loaded(header.levels);
+	for (auto& level : loaded) {
+		uint64_t count = 0;
+		if (!in.read((char*)&count, sizeof(count)) || count != expected) return false;
+		level.assign(header.channels, std::vector<Peak>(count));
+		for (auto& b : level) {
+			if (!in.read((char*)b.data(), count * sizeof(Peak))) return false;
+		}
+		expected = (expected + LEVEL_FACTOR - 1) / LEVEL_FACTOR;
+	}
+
+	SF_INFO info;
+	memset(&info, 0, sizeof(SF_INFO));
+	file = sf_open(fileName.c_str(), SFM_READ, &info);
+	if (!file || info.channels != header.channels) {
+		Close();
+		return false;
+	}
+	sampleRate = header.sampleRate;
+	channels = header.channels;
+	frames = (size_t)header.frames;
+	chunkFrames = std::max(BIN_FRAMES, chunk / BIN_FRAMES * BIN_FRAMES);
+	readBuffer.resize((size_t)chunkFrames * channels);
+	levels = std::move(loaded);
+	return true;
+}
+
+void WaveformOverview::Close() {
+	if (file) {
+		sf_close(file);
+		file = nullptr;
+	}
+	sampleRate = 0;
+	channels = 0;
+	frames = 0;
+	levels.clear();
+	readBuffer.clear();
+	readBuffer.shrink_to_fit();
+}
+
+size_t WaveformOverview::GetMemoryBytes() const {
+	size_t bytes = readBuffer.capacity() * sizeof(float);
+	for (auto& level : levels) {
+		for (auto& b : level) bytes += b.capacity() * sizeof(Peak);
+	}
+	return bytes;
+}
+
+void WaveformOverview::Query(double beginFrame, double endFrame, int width, float** maximum, float** minimum, int n) {
+	if (width <= 0) return;
+	n = std::min(n, channels);
+	for (int ch = 0; ch < n; ch++) {
+		std::fill(maximum[ch], maximum[ch] + width, 0.f);
+		std::fill(minimum[ch], minimum[ch] + width, 0.f);
+	}
+	if (!file || endFrame <= beginFrame || n <= 0) return;
+
+	double framesPerColumn = (endFrame - beginFrame) / width;
+	if (framesPerColumn < BIN_FRAMES || levels.empty()) {
+		queryFile(beginFrame, endFrame, width, maximum, minimum, n);
+		return;
+	}
+	// pick the coarsest level still finer than a column, a column spans less than LEVEL_FACTOR + 2 bins
+	size_t level = 0;
+	size_t binFrames = BIN_FRAMES;
+	while (level + 1 < levels.size() && (double)binFrames * LEVEL_FACTOR <= framesPerColumn) {
+		level++;
+		binFrames *= LEVEL_FACTOR;
+	}
+	queryLevel(levels[level], binFrames, beginFrame, endFrame, width, maximum, minimum, n);
+}
+
+void WaveformOverview::queryLevel(const std::vector<std::vector<Peak>>& level, size_t binFrames, double beginFrame, double endFrame, int width, float** maximum, float** minimum, int n) {
+	double framesPerColumn = (endFrame - beginFrame) / width;
+	long long binCount = (long long)level[0].size();
+	for (int i = 0; i < width; i++) {
+		// bins touched by the column, partial bins at edges count as whole
+		long long b0 = (long long)floor((beginFrame + framesPerColumn * i) / (double)binFrames);
+		long long b1 = (long long)ceil((beginFrame + framesPerColumn * (i + 1)) / (double)binFrames);
+		b0 = std::max(b0, 0LL);
+		b1 = std::min(b1, binCount);
+		if (b0 >= b1) continue;
+		for (int ch = 0; ch < n; ch++) {
+			const Peak* p = level[ch].data();
+			int16_t high = p[b0].max;
+			int16_t low = p[b0].min;
+			for (long long b = b0 + 1; b < b1; b++) {
+				if (high < p[b].max) high = p[b].max;
+				if (low > p[b].min) low = p[b].min;
+			}
+			maximum[ch][i] = fromPeak(high);
+			minimum[ch][i] = fromPeak(low);
+		}
+	}
+}
+
+void WaveformOverview::queryFile(double beginFrame, double endFrame, int width, float** maximum, float** minimum, int n) {
+	double framesPerColumn = (endFrame - beginFrame) / width;
+	sf_count_t first = std::max((sf_count_t)floor(beginFrame), (sf_count_t)0);
+	sf_count_t last = std::min((sf_count_t)ceil(endFrame), (sf_count_t)frames);
+	if (first >= last) return;
+	if (sf_seek(file, first, SEEK_SET) < 0) return;
+
+	// NOTE: visible range is less than width * BIN_FRAMES frames here, read it through the chunk buffer
+	std::vector<bool> touched(width, false);
+	sf_count_t pos = first;
+	while (pos < last) {
+		sf_count_t count = sf_readf_float(file, readBuffer.data(), std::min((sf_count_t)chunkFrames, last - pos));
+		if (count <= 0) break;
+		for (sf_count_t j = 0; j < count; j++) {
+			int i = (int)((pos + j - beginFrame) / framesPerColumn);
+			if (i < 0 || i >= width) continue;
+			const float* p = readBuffer.data() + (size_t)j * channels;
+			for (int ch = 0; ch < n; ch++) {
+				float v = std::min(std::max(p[ch], -1.f), 1.f);
+				if (!touched[i] || maximum[ch][i] < v) maximum[ch][i] = v;
+				if (!touched[i] || minimum[ch][i] > v) minimum[ch][i] = v;
+			}
+			touched[i] = true;
+		}
+		pos += count;
+	}
+	// zoomed in beyond one frame per column, hold previous sample over columns inside the file
+	for (int i = 1; i < width; i++) {
+		if (touched[i] || !touched[i - 1]) continue;
+		double frame = beginFrame + framesPerColumn * (i + 0.5);
+		if (frame < first || frame >= last) continue;
+		for (int ch = 0; ch < n; ch++) {
+			maximum[ch][i] = maximum[ch][i - 1];
+			minimum[ch][i] = minimum[ch][i - 1];
+		}
+		touched[i] = true;
+	}
+}
+
+} // namespace
@@ -0,0 +1,73 @@
+#pragma once
+/*
+* Streaming min/max summary of an audio file for waveform plot, file is read once in chunks
+*   - per channel int16 min/max of every BIN_FRAMES frames, reduced by simd kernel from file chunks
+*   - pyramid of levels above it, each bin of next level covers LEVEL_FACTOR bins, up to a single bin
+*   - a query picks the coarsest level finer than a column, so each column reads a few bins at any zoom
+*   - memory is about channels * frames / BIN_FRAMES * 4 * 4/3 bytes, eg: 1 hour 48kHz stereo costs ~7.2MB
+*   - zoomed in below one bin per column, the visible range is read from file on demand in chunks
+*   - levels can be saved to and loaded from a peak cache file stamped with size and mtime of audio file
+*/
+#include <sndfile.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace GLUI {
+
+class WaveformOverview {
+public:
+	/* frames summarized by one min/max pair of base level */
+	static constexpr int BIN_FRAMES = 256;
+	/* bins of a level summarized by one min/max pair of next level */
+	static constexpr int LEVEL_FACTOR = 4;
+
+	WaveformOverview() {}
+	virtual ~WaveformOverview();
+	WaveformOverview(const WaveformOverview&) = delete;
+	WaveformOverview& operator=(const WaveformOverview&) = delete;
+
+	/* read whole file in chunks of chunkFrames and build summary, file stays open for deep zoom reading */
+	bool Build(std::string fileName, int chunkFrames = 65536);
+	void Close();
+	bool IsLoaded() const { return file != nullptr; }
+
+	/* write levels to cache file with stamp of the audio file, \return false if nothing built or write failed */
+	bool SaveCache(std::string cacheFile, uint64_t size, int64_t mtime) const;
+	/* load levels from cache file if its stamp matches, then open audio file for deep zoom reading */
+	bool LoadCache(std::string cacheFile, std::string fileName, uint64_t size, int64_t mtime, int chunkFrames = 65536);
+
+	int GetSampleRate() const { return sampleRate; }
+	int GetChannels() const { return channels; }
+	size_t GetFrames() const { return frames; }
+	/* bytes held by summary levels and read buffer */
+	size_t GetMemoryBytes() const;
+	int GetLevels() const { return (int)levels.size(); }
+
+	/* min/max of each column evenly dividing frame range [beginFrame, endFrame) into width columns,
+	 * maximum/minimum are arrays of width values for first n channels, columns out of file are 0
+	 */
+	void Query(double beginFrame, double endFrame, int width, float** maximum, float** minimum, int n);
+
+private:
+	struct Peak {
+		int16_t min, max;
+	};
+	// summary level with given frames per bin
+	void queryLevel(const std::vector<std::vector<Peak>>& level, size_t binFrames, double beginFrame, double endFrame, int width, float** maximum, float** minimum, int n);
+	// read visible frames from file and reduce per column
+	void queryFile(double beginFrame, double endFrame, int width, float** maximum, float** minimum, int n);
+
+	SNDFILE* file = nullptr;
+	int sampleRate = 0;
+	int channels = 0;
+	size_t frames = 0;
+	int chunkFrames = 0;
+	// [level][channel][bin], level 0 is BIN_FRAMES per bin
+	std::vector<std::vector<std::vector<Peak>>> levels;
+	// interleaved chunk for building and deep zoom reading
+	std::vector<float> readBuffer;
+}; // class
+
+} // namespace
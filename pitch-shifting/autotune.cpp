@@ -0,0 +1,124 @@
+#include "autotune.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+namespace PitchShifting {
+
+struct ScaleSpec {
+    const char* name;
+    int count;
+    int steps[12];
+};
+static const ScaleSpec scaleSpecs[] = {
+    { "chromatic", 12, { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 } },
+    { "major", 7, { 0, 2, 4, 5, 7, 9, 11 } },
+    { "minor", 7, { 0, 2, 3, 5, 7, 8, 10 } },
+    { "harmonic", 7, { 0, 2, 3, 5, 7, 8, 11 } },
+    { "pentatonic", 5, { 0, 2, 4, 7, 9 } },
+    { "minor-pentatonic", 5, { 0, 3, 5, 7, 10 } },
+    { "blues", 6, { 0, 3, 5, 6, 7, 10 } },
+};
+
+static int parseKey(const std::string& key) {
+    if (key.empty()) return -1;
+    if (isdigit((unsigned char)key[0])) {
+        int n = atoi(key.c_str());
+        return (n >= 0 && n < 12) ? n : -1;
+    }
+    static const int naturals[7] = { 9, 11, 0, 2, 4, 5, 7 }; // A to G
+    char letter = (char)toupper((unsigned char)key[0]);
+    if (letter < 'A' || letter > 'G') return -1;
+    int n = naturals[letter - 'A'];
+    for (size_t i = 1; i < key.size(); ++i) {
+        if (key[i] == '#') n++;
+        else if (key[i] == 'b') n--;
+        else return -1;
+    }
+    return (n + 12) % 12;
+}
+
+bool
+AutoTune::ParseScale(const std::string& scale, const std::string& key, bool* notes, int* root) {
+    bool mask[12] = { false };
+    bool found = false;
+    for (const auto& spec : scaleSpecs) {
+        if (scale == spec.name) {
+            for (int i = 0; i < spec.count; ++i) mask[spec.steps[i]] = true;
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        // semitones from key
+        size_t begin = 0;
+        while (begin < scale.size()) {
+            size_t end = scale.find(',', begin);
+            if (end == std::string::npos) end = scale.size();
+            std::string item = scale.substr(begin, end - begin);
+            if (item.empty() || !isdigit((unsigned char)item[0])) return false;
+            int n = atoi(item.c_str());
+            if (n < 0 || n > 11) return false;
+            mask[n] = true;
+            found = true;
+            begin = end + 1;
+        }
+    }
+    int k = parseKey(key);
+    if (!found || k < 0) return false;
+    if (notes) std::copy(mask, mask + 12, notes);
+    if (root) *root = k;
+    return true;
+}
+
+AutoTune::AutoTune(const std::string& scale, const std::string& key, double retuneMs, double minConfidence)
+    : retuneSeconds(std::max(0.0, retuneMs / 1000.0)), minConfidence(minConfidence) {
+    valid = ParseScale(scale, key, notes, &root);
+}
+
+void
+AutoTune::Reset() {
+    currentSemis = 0.0;
+    targetSemis = 0.0;
+    targetNote = -1;
+}
+
+double
+AutoTune::Update(const PitchPoint& input, double pitchScale, double seconds) {
+    if (valid && input.f0 > 0.f && input.confidence >= minConfidence && pitchScale > 0.0) {
+        // fractional midi note of shifted pitch, snapped to the nearest note of scale
+        double note = 69.0 + 12.0 * log2(input.f0 * pitchScale / 440.0);
+        int nearest = (int)floor(note + 0.5);
+        int best = nearest;
+        for (int d = 0; d <= 6; ++d) {
+            int up = nearest + d, down = nearest - d;
+            bool upIn = notes[((up - root) % 12 + 12) % 12];
+            bool downIn = notes[((down - root) % 12 + 12) % 12];
+            if (upIn && downIn) {
+                best = (fabs(up - note) <= fabs(down - note)) ? up : down;
+                break;
+            }
+            if (upIn || downIn) {
+                best = upIn ? up : down;
+                break;
+            }
+        }
+        targetNote = best;
+        targetSemis = best - note;
+    }
+    // first order approach to target, retune speed is the time constant
+    if (retuneSeconds <= 0.0 || seconds <= 0.0) {
+        currentSemis = targetSemis;
+    } else {
+        currentSemis += (targetSemis - currentSemis) * (1.0 - exp(-seconds / retuneSeconds));
+    }
+    return GetCorrection();
+}
+
+double
+AutoTune::GetCorrection() const {
+    return pow(2.0, currentSemis / 12.0);
+}
+
+} // namespace PitchShifting
@@ -0,0 +1,51 @@
+#pragma once
+/*
+ * pitch correction (auto-tune) from tracked f0, snaps to the nearest note of a scale in a key
+ *   - correction is a ratio on top of the pitch scale given by user, the shifted pitch is snapped,
+ *     so a transposed voice lands on the scale as well
+ *   - correction moves to the target in semitones with a time constant of retune speed,
+ *     0 is instant (hard tune), ~100ms keeps natural glides and vibrato
+ *   - unvoiced or low confidence blocks hold the current correction
+ * NOTE: Update() is called once per process block on stretcher thread, rubberband pitch changes per block
+ *   need high consistency pitch mode
+ */
+#include <string>
+#include "pitchtracker.hpp"
+
+namespace PitchShifting {
+
+class AutoTune {
+public:
+    /* scale is a name (chromatic, major, minor, harmonic, pentatonic, minor-pentatonic, blues) or comma separated
+     * semitones from key, eg. "0,2,4,7,9", key is a note name (C, F#, Bb) or semitone 0-11,
+     * \return false if either is not recognized */
+    static bool ParseScale(const std::string& scale, const std::string& key, bool* notes = nullptr, int* root = nullptr);
+
+    AutoTune(const std::string& scale, const std::string& key, double retuneMs, double minConfidence = 0.5);
+    virtual ~AutoTune() {}
+
+    bool IsValid() const { return valid; }
+    /* back to no correction */
+    void Reset();
+
+    /* f0 of input before shifting and pitch scale applied to it, block length in seconds,
+     * \return correction ratio to multiply with pitch scale */
+    double Update(const PitchPoint& input, double pitchScale, double seconds);
+    double GetCorrection() const; // ratio
+    double GetCorrectionCents() const { return currentSemis * 100.0; }
+    /* midi note snapped to by the latest voiced update, -1 if none */
+    int GetTargetNote() const { return targetNote; }
+
+private:
+    bool notes[12] = { false };
+    int root = 0;
+    bool valid = false;
+    double retuneSeconds;
+    double minConfidence;
+
+    double currentSemis = 0.0;
+    double targetSemis = 0.0;
+    int targetNote = -1;
+};
+
+} // namespace PitchShifting
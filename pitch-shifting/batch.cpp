@@ -0,0 +1,289 @@
+#include "batch.hpp"
+#include "renderloop.hpp"
+#include "stretcher.hpp"
+#include "workerpool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace PitchShifting {
+
+/* per thread state, stretcher and buffers live across files processed by the same worker */
+struct BatchProcessor::Worker {
+    RubberBandStretcher* pts = nullptr;
+    RubberBandStretcher::Options options = 0;
+    int sampleRate = 0;
+    int channels = 0;
+    RenderLoop loop;
+    Worker() = default;
+    Worker(const Worker&) = delete;
+    ~Worker() { delete pts; }
+};
+
+BatchProcessor::BatchProcessor(Parameters* parameters, RubberBandStretcher::Options opts, int dbgLevel)
+    : debug(dbgLevel), param(parameters) {
+    options = RenderLoop::SingleThreaded(opts);
+}
+
+bool
+BatchProcessor::LoadDirectory(const std::string& dir, const std::string& outDir) {
+    std::error_code ec;
+    if (!outDir.empty()) {
+        fs::create_directories(outDir, ec);
+        if (ec) {
+            cerr << "ERROR: Failed to create batch output directory \"" << outDir << "\": " << ec.message() << endl;
+            return false;
+        }
+    }
+    std::vector<fs::path> paths;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        if (entry.is_regular_file()) paths.push_back(entry.path());
+    }
+    if (ec) {
+        cerr << "ERROR: Failed to list batch directory \"" << dir << "\": " << ec.message() << endl;
+        return false;
+    }
+    std::sort(paths.begin(), paths.end());
+
+    for (const auto& path : paths) {
+        // outputs of previous run next to inputs
+        if (outDir.empty() && path.stem().extension() == ".out") continue;
+        // only files sndfile can read, the same check as ListLocalFiles()
+        SF_INFO sfinfo;
+        memset(&sfinfo, 0, sizeof(SF_INFO));
+        SNDFILE* sf = sf_open(path.string().c_str(), SFM_READ, &sfinfo);
+        if (!sf) continue;
+        sf_close(sf);
+        if (sfinfo.samplerate == 0) continue;
+
+        BatchJob job;
+        job.input = path.string();
+        if (outDir.empty()) {
+            fs::path out = path;
+            out.replace_extension(".out" + path.extension().string());
+            job.output = out.string();
+        } else {
+            job.output = (fs::path(outDir) / path.filename()).string();
+        }
+        job.pitchshift = param->pitchshift;
+        job.formantshift = param->formantshift;
+        job.timeratio = param->timeratio;
+        job.formant = param->formant;
+        jobs.push_back(job);
+    }
+    if (!param->quiet) {
+        cerr << "Batch " << jobs.size() << " audio file(s) from directory \"" << dir << "\"" << endl;
+    }
+    return true;
+}
+
+bool
+BatchProcessor::LoadManifest(const std::string& file) {
+    std::ifstream ifile(file.c_str());
+    if (!ifile.is_open()) {
+        cerr << "ERROR: Failed to open batch manifest \"" << file << "\"" << endl;
+        return false;
+    }
+    fs::path base = fs::path(file).parent_path();
+    auto resolve = [&base](const std::string& name) {
+        fs::path path(name);
+        return (path.is_relative() ? base / path : path).string();
+    };
+    std::string line;
+    int lineno = 0;
+    while (std::getline(ifile, line)) {
+        ++lineno;
+        std::istringstream iss(line);
+        std::string input, output;
+        if (!(iss >> input) || input[0] == '#') continue;
+        if (!(iss >> output)) {
+            cerr << "ERROR: Batch manifest \"" << file << "\" is malformed at line " << lineno << endl;
+            return false;
+        }
+        BatchJob job;
+        job.input = resolve(input);
+        job.output = resolve(output);
+        job.pitchshift = param->pitchshift;
+        job.formantshift = param->formantshift;
+        job.timeratio = param->timeratio;
+        job.formant = param->formant;
+        // optional fields, per file formant shift enables formant preserving for this file
+        double value;
+        if (iss >> value) job.pitchshift = value;
+        if (iss >> value) {
+            job.formantshift = value;
+            job.formant = true;
+        }
+        if (iss >> value) job.timeratio = value;
+        if (job.timeratio <= 0.0) {
+            cerr << "ERROR: Invalid time ratio " << job.timeratio << " in batch manifest at line " << lineno << endl;
+            return false;
+        }
+        jobs.push_back(job);
+    }
+    if (!param->quiet) {
+        cerr << "Batch " << jobs.size() << " job(s) from manifest \"" << file << "\"" << endl;
+    }
+    return true;
+}
+
+void
+BatchProcessor::processFile(BatchJob& job, Worker& w) {
+    TRACE_SCOPE("batch file");
+    auto begin = std::chrono::steady_clock::now();
+
+    SF_INFO inInfo;
+    memset(&inInfo, 0, sizeof(SF_INFO));
+    SNDFILE* in = sf_open(job.input.c_str(), SFM_READ, &inInfo);
+    if (!in) {
+        // NOTE: error of null handle is global in libsndfile, take its code right away and map it to the static
+        //   message, sf_strerror(nullptr) returns a shared buffer other workers may overwrite
+        job.error = std::string("failed to open input: ") + sf_error_number(sf_error(nullptr));
+        return;
+    }
+    int channels = inInfo.channels;
+    job.sampleRate = inInfo.samplerate;
+
+    SF_INFO outInfo;
+    memset(&outInfo, 0, sizeof(SF_INFO));
+    std::string ext = fs::path(job.output).extension().string();
+    int format = ext.empty() ? 0 : Stretcher::GetFileFormat(ext.substr(1));
+    outInfo.format = format ? format : inInfo.format;
+    outInfo.samplerate = inInfo.samplerate;
+    outInfo.channels = channels;
+    SNDFILE* out = sf_open(job.output.c_str(), SFM_WRITE, &outInfo);
+    if (!out) {
+        job.error = std::string("failed to open output: ") + sf_error_number(sf_error(nullptr));
+        sf_close(in);
+        return;
+    }
+
+    // the same pitch and formant scale calculation as main
+    double frequencyShift = param->frequencyshift * pow(2.0, job.pitchshift / 12.0);
+    double formantScale = 0.0; // default of rubberband
+    RubberBandStretcher::Options opts = options;
+    if (job.formant) {
+        opts |= RubberBandStretcher::OptionFormantPreserved;
+        formantScale = (1.0 / frequencyShift) * pow(2.0, job.formantshift / 12.0);
+    }
+
+    // reset and reuse if creation parameters are the same, ratio and scales can be given again after reset
+    if (w.pts && w.options == opts && w.sampleRate == inInfo.samplerate && w.channels == channels) {
+        w.pts->reset();
+        w.pts->setTimeRatio(job.timeratio);
+        w.pts->setPitchScale(frequencyShift);
+        job.reused = true;
+    } else {
+        delete w.pts;
+        w.pts = new RubberBandStretcher(inInfo.samplerate, channels, opts, job.timeratio, frequencyShift);
+        w.options = opts;
+        w.sampleRate = inInfo.samplerate;
+        w.channels = channels;
+    }
+    RubberBandStretcher* pts = w.pts;
+    pts->setFormantScale(formantScale);
+    size_t frames = (size_t)inInfo.frames;
+    bool realtime = (opts & RubberBandStretcher::OptionProcessRealTime) != 0;
+    if (!realtime) {
+        pts->setExpectedInputDuration(frames);
+    }
+    pts->setMaxProcessSize(blockSize);
+
+    // realtime mode does not know the end, truncate like RetrieveAvailableData() does
+    size_t ideal = realtime ? size_t(frames * job.timeratio) : SIZE_MAX;
+    float inGain = (float)pow(10.0, param->inputgaindb / 20.0);
+    RenderLoop& loop = w.loop;
+    loop.Begin(pts, realtime, ChannelMap::Default(channels, channels), blockSize, inGain, ideal,
+        [out](const float* buf, size_t count) { sf_writef_float(out, buf, (sf_count_t)count); });
+
+    size_t countIn = 0;
+    bool isFinal = false;
+    while (!isFinal) {
+        sf_count_t count = sf_readf_float(in, loop.GetInputBuffer(), blockSize);
+        if (count < 0) count = 0;
+        countIn += count;
+        isFinal = (countIn >= frames || count < blockSize);
+        loop.Process((int)count, isFinal);
+    }
+    sf_close(in);
+    sf_close(out);
+
+    job.inputFrames = countIn;
+    job.outputFrames = loop.GetOutputFrames();
+    job.clipped = loop.IsClipped();
+    job.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    job.done = true;
+}
+
+int
+BatchProcessor::Run() {
+    auto begin = std::chrono::steady_clock::now();
+    std::mutex printMutex;
+    size_t finished = 0;
+    {
+        WorkerPool pool(param->jobs);
+        std::vector<Worker> workers(pool.GetThreadCount());
+        if (!param->quiet) {
+            cerr << "Batch processing " << jobs.size() << " job(s) on " << pool.GetThreadCount() << " thread(s)" << endl;
+        }
+        for (auto& job : jobs) {
+            BatchJob* pjob = &job;
+            pool.Submit([this, pjob, &pool, &workers, &printMutex, &finished]() {
+                Trace::SetThreadName("batch worker");
+                processFile(*pjob, workers[pool.GetWorkerIndex()]);
+                std::lock_guard<std::mutex> lock(printMutex);
+                finished++;
+                if (!pjob->done) {
+                    cerr << "ERROR: Batch \"" << pjob->input << "\" " << pjob->error << endl;
+                } else if (!param->quiet) {
+                    cerr << "[" << finished << "/" << jobs.size() << "] " << pjob->output
+                        << " in " << pjob->seconds << "s" << endl;
+                }
+            });
+        }
+        pool.Wait();
+        // workers are destroyed before pool joins threads, all tasks are done here
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    printSummary(wall);
+    return (int)std::count_if(jobs.begin(), jobs.end(), [](const BatchJob& job) { return !job.done; });
+}
+
+void
+BatchProcessor::printSummary(double wallSeconds) {
+    size_t failed = 0;
+    size_t reused = 0;
+    size_t clipped = 0;
+    double audioSeconds = 0.0;
+    double busySeconds = 0.0;
+    cerr << "=== Batch summary ===" << endl;
+    for (const auto& job : jobs) {
+        if (!job.done) {
+            failed++;
+            cerr << "  FAILED " << job.input << ": " << job.error << endl;
+            continue;
+        }
+        double duration = job.sampleRate > 0 ? double(job.inputFrames) / job.sampleRate : 0.0;
+        audioSeconds += duration;
+        busySeconds += job.seconds;
+        if (job.reused) reused++;
+        if (job.clipped) clipped++;
+        if (debug > 0) {
+            cerr << "  ok " << job.input << " -> " << job.output << " in: " << job.inputFrames
+                << ", out: " << job.outputFrames << ", " << job.seconds << "s"
+                << ", x" << (job.seconds > 0.0 ? duration / job.seconds : 0.0) << " realtime"
+                << (job.clipped ? ", clipped" : "") << endl;
+        }
+    }
+    cerr << "files: " << jobs.size() << ", ok: " << jobs.size() - failed << ", failed: " << failed
+        << ", stretcher reused: " << reused << ", clipped: " << clipped << endl;
+    cerr << "elapsed time: " << wallSeconds << " sec, busy: " << busySeconds << " sec, audio: " << audioSeconds
+        << " sec, x" << (wallSeconds > 0.0 ? audioSeconds / wallSeconds : 0.0) << " realtime" << endl;
+}
+
+} // namespace PitchShifting
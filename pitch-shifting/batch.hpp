@@ -0,0 +1,71 @@
+#pragma once
+/*
+ * batch mode renders many files with the same stretcher options on a worker pool
+ *   - input is a directory (all readable audio files) or a manifest text file, one job per line:
+ *       <input> <output> [pitch semitones [formant semitones [time ratio]]]
+ *     empty lines and lines starting with '#' are ignored, relative paths are relative to the manifest
+ *   - each worker thread keeps its own buffers and rubberband stretcher, the stretcher is reset and reused
+ *     for next file if options, sample rate and channels are the same, otherwise recreated
+ *   - prints per file timings and failures as summary
+ * NOTE: frequency map and channel map are not applied, output has the same channels as input
+ */
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#endif
+#include "rubberband/RubberBandStretcher.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "parameters.h"
+
+namespace PitchShifting {
+
+struct BatchJob {
+    std::string input;
+    std::string output;
+    double pitchshift = 0.0; // semitones
+    double formantshift = 0.0; // semitones
+    double timeratio = 1.0;
+    bool formant = false;
+    // results
+    bool done = false;
+    std::string error;
+    int sampleRate = 0;
+    int64_t inputFrames = 0;
+    int64_t outputFrames = 0;
+    double seconds = 0.0;
+    bool reused = false; // stretcher from previous file of the same worker
+    bool clipped = false;
+};
+
+class BatchProcessor {
+public:
+    /* options are the same as single stretcher, internal threading of rubberband is turned off */
+    BatchProcessor(Parameters* parameters, RubberBand::RubberBandStretcher::Options options, int dbgLevel = 1);
+    virtual ~BatchProcessor() {}
+
+    /* add every audio file in directory, output to outDir with the same name, or next to input as name.out.ext if empty */
+    bool LoadDirectory(const std::string& dir, const std::string& outDir);
+    /* add jobs from manifest file, missing fields use settings from parameters */
+    bool LoadManifest(const std::string& file);
+    const std::vector<BatchJob>& GetJobs() const { return jobs; }
+    void SetBlockSize(int frames) { blockSize = frames; }
+
+    /* process all jobs with param->jobs threads and print summary, \return number of failed jobs */
+    int Run();
+
+private:
+    struct Worker;
+    void processFile(BatchJob& job, Worker& worker);
+    void printSummary(double wallSeconds);
+
+    int debug;
+    Parameters* param;
+    RubberBand::RubberBandStretcher::Options options;
+    std::vector<BatchJob> jobs;
+    int blockSize = 1024;
+};
+
+} // namespace PitchShifting
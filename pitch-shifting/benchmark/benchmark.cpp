@@ -0,0 +1,424 @@
+/* benchmark harness, drives PitchShifting::Stretcher file to file pipeline through a matrix of settings
+ * and reports realtime factor, per-block latency percentiles and peak RSS as JSON for regression tracking
+ * NOTE: kept in own folder, the vscode "build all cpp" task compiles every cpp of pitch-shifting folder into main.out
+ */
+
+#include "../stretcher.hpp"
+#include "../parameters.h"
+#include "../kernels.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <streambuf>
+#include <vector>
+
+#ifdef _MSC_VER
+#include "../../getopt/getopt.h"
+#else
+#include <getopt.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+namespace fs = std::filesystem;
+using PitchShifting::Parameters;
+using PitchShifting::Stretcher;
+
+/* swallow stretcher debug output during measurement */
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+struct BenchCase {
+    bool finer = true;
+    bool psola = false; // TD-PSOLA instead of rubberband, finer is ignored
+    bool realtime = false;
+    bool formant = false;
+    int crispness = -1; // -1 is engine default
+    int threading = 0; // 0=auto, 1=never, 2=always, same as Parameters::threading
+    int blockSize = 1024;
+    int channels = 2;
+    int jobs = 1; // segments on worker pool if not 1, same as Parameters::jobs
+};
+
+struct BenchResult {
+    double audioSeconds = 0.0;
+    double wallSeconds = 0.0;
+    size_t inFrames = 0;
+    size_t outFrames = 0;
+    std::vector<double> blockUs;
+    long peakRssKb = 0;
+    int channels = 0; // of opened input file
+    bool ok = false;
+};
+
+/* quote and escape string for json, eg. windows paths with backslashes */
+static std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (unsigned char ch : text) {
+        switch (ch) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (ch < 0x20) {
+                char hex[8];
+                snprintf(hex, sizeof(hex), "\\u%04x", ch);
+                out += hex;
+            } else {
+                out += (char)ch;
+            }
+            break;
+        }
+    }
+    return out + "\"";
+}
+
+/* process peak resident set, monotonic during process lifetime */
+static long peakRssKb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return (long)(pmc.PeakWorkingSetSize / 1024);
+    }
+    return 0;
+#else
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+    return (long)(ru.ru_maxrss / 1024); // bytes on macOS
+#else
+    return (long)ru.ru_maxrss; // kilobytes on linux
+#endif
+#endif
+}
+
+/* deterministic voice-like test signal, harmonics of 220Hz with vibrato and a little noise */
+static bool writeSyntheticFile(const std::string& path, int sampleRate, int channels, double seconds) {
+    SF_INFO info;
+    memset(&info, 0, sizeof(SF_INFO));
+    info.samplerate = sampleRate;
+    info.channels = channels;
+    info.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+    SNDFILE* file = sf_open(path.c_str(), SFM_WRITE, &info);
+    if (!file) {
+        cerr << "ERROR: Failed to create synthetic input \"" << path << "\": " << sf_strerror(file) << endl;
+        return false;
+    }
+    const double twoPi = 6.283185307179586;
+    const int frames = (int)(seconds * sampleRate);
+    const int block = 4096;
+    std::vector<float> buf((size_t)block * channels);
+    double phase = 0.0;
+    uint32_t noise = 22222;
+    for (int done = 0; done < frames; done += block) {
+        int count = std::min(block, frames - done);
+        for (int i = 0; i < count; ++i) {
+            double t = double(done + i) / sampleRate;
+            phase += twoPi * 220.0 * (1.0 + 0.01 * sin(twoPi * 5.0 * t)) / sampleRate;
+            double v = 0.0;
+            for (int h = 1; h <= 6; ++h) {
+                v += sin(phase * h) / h;
+            }
+            for (int c = 0; c < channels; ++c) {
+                noise ^= noise << 13;
+                noise ^= noise >> 17;
+                noise ^= noise << 5;
+                buf[(size_t)i * channels + c] = (float)(0.3 * v + 0.01 * ((double)noise / 4294967296.0 - 0.5));
+            }
+        }
+        sf_writef_float(file, buf.data(), count);
+    }
+    sf_close(file);
+    return true;
+}
+
+/* same steps as processAudio() in main.cpp for file input through Stretcher::BeginProcess()/ProcessBlock(),
+ * timed per block, or RenderParallel() as a whole if jobs split the file into segments */
+static BenchResult runCase(const BenchCase& bc, const std::string& inPath, const std::string& outPath, double pitch) {
+    BenchResult result;
+    Parameters param;
+    param.finer = bc.finer;
+    param.faster = !bc.finer;
+    param.psola = bc.psola;
+    param.realtime = bc.realtime;
+    param.formant = bc.formant;
+    param.crispness = bc.crispness;
+    param.threading = bc.threading;
+    param.quiet = true;
+    param.debug = 0;
+    param.ignoreClipping = true;
+    param.jobs = bc.jobs;
+    param.frequencyshift = pow(2.0, pitch / 12.0);
+    if (bc.formant) {
+        param.formantscale = 1.0 / param.frequencyshift;
+    }
+
+    Stretcher* sther = new Stretcher(&param, bc.blockSize, 0);
+    int sampleRate = 0;
+    int channels = 0;
+    int format = 0;
+    int64_t inputFrames = 0;
+    if (!sther->LoadInputFile(inPath, &sampleRate, &channels, &format, &inputFrames, param.timeratio, param.duration) ||
+        !sther->SetOutputFile(outPath, sampleRate, channels, SF_FORMAT_WAV | SF_FORMAT_FLOAT)) {
+        delete sther;
+        return result;
+    }
+    result.channels = channels;
+    sther->totalFramesCount = inputFrames;
+    result.blockUs.reserve((size_t)(inputFrames / bc.blockSize + 16));
+
+    bool rendered = true;
+    auto begin = std::chrono::steady_clock::now();
+    if (sther->IsParallelRender()) {
+        rendered = sther->RenderParallel(&sther->inputCount, &sther->outputCount);
+    }
+    else {
+        sther->BeginProcess(inputFrames);
+        int frame = 0;
+        while (frame < inputFrames) {
+            auto blockBegin = std::chrono::steady_clock::now();
+            bool isFinal = false;
+            sther->ProcessBlock(&frame, &isFinal);
+            result.blockUs.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - blockBegin).count());
+            if (isFinal) break;
+        }
+        sther->RetrieveAvailableData(&sther->outputCount);
+    }
+    result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    result.inFrames = sther->inputCount;
+    result.outFrames = sther->outputCount;
+    result.audioSeconds = double(inputFrames) / sampleRate;
+    sther->CloseInputFile();
+    sther->CloseOutputFile();
+    delete sther;
+    result.peakRssKb = peakRssKb();
+    // whole input consumed and something came out, a canceled or broken run does not count
+    result.ok = rendered && (int64_t)result.inFrames >= inputFrames && result.outFrames > 0;
+    return result;
+}
+
+static double percentile(std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t idx = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+static std::vector<int> parseList(const char* arg) {
+    std::vector<int> values;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item == "r2") values.push_back(0);
+        else if (item == "r3") values.push_back(1);
+        else if (item == "psola") values.push_back(2);
+        else if (!item.empty()) values.push_back(atoi(item.c_str()));
+    }
+    return values;
+}
+
+static const char* engineName(const BenchCase& bc) {
+    return bc.psola ? "psola" : bc.finer ? "r3" : "r2";
+}
+
+static void printUsage(const char* name) {
+    cerr << "Usage: " << name << " [options]" << endl;
+    cerr << "  runs the stretcher file to file pipeline through a settings matrix, prints JSON to stdout" << endl;
+    cerr << endl;
+    cerr << "  --engines <L>     r2,r3,psola (default r2,r3)" << endl;
+    cerr << "  --realtime <L>    0,1 offline and/or realtime mode (default both)" << endl;
+    cerr << "  --formant <L>     0,1 formant preserving (default both)" << endl;
+    cerr << "  --crispness <L>   0..6, -1 for engine default (default -1)" << endl;
+    cerr << "  --threading <L>   0 auto, 1 never, 2 always (default 0)" << endl;
+    cerr << "  --block-sizes <L> process block sizes (default 1024)" << endl;
+    cerr << "  --channels <L>    synthetic input channels (default 2)" << endl;
+    cerr << "  --jobs <L>        parallel segment render jobs, 1 for the block loop (default 1)" << endl;
+    cerr << "  --full            crispness 0..6, all threading, block 256..2048, mono and stereo" << endl;
+    cerr << "  --input <F>       use wav file F instead of synthetic signal, --channels is ignored" << endl;
+    cerr << "  --seconds <S>     synthetic signal duration (default 10)" << endl;
+    cerr << "  --pitch <P>       pitch shift semitones (default 3)" << endl;
+    cerr << "  --output <F>      write JSON to file F instead of stdout" << endl;
+    cerr << "  --verbose         keep stretcher debug output" << endl;
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> engines = { 0, 1 };
+    std::vector<int> realtimes = { 0, 1 };
+    std::vector<int> formants = { 0, 1 };
+    std::vector<int> crispnesses = { -1 };
+    std::vector<int> threadings = { 0 };
+    std::vector<int> blockSizes = { 1024 };
+    std::vector<int> channelCounts = { 2 };
+    std::vector<int> jobCounts = { 1 };
+    std::string inputFile;
+    std::string outputFile;
+    double seconds = 10.0;
+    double pitch = 3.0;
+    bool verbose = false;
+
+    static struct option longOpts[] = {
+        { "engines",     1, 0, 'e' },
+        { "realtime",    1, 0, 'R' },
+        { "formant",     1, 0, 'F' },
+        { "crispness",   1, 0, 'c' },
+        { "threading",   1, 0, 't' },
+        { "block-sizes", 1, 0, 'b' },
+        { "channels",    1, 0, 'n' },
+        { "jobs",        1, 0, 'j' },
+        { "full",        0, 0, 'a' },
+        { "input",       1, 0, 'i' },
+        { "seconds",     1, 0, 's' },
+        { "pitch",       1, 0, 'p' },
+        { "output",      1, 0, 'o' },
+        { "verbose",     0, 0, 'v' },
+        { "help",        0, 0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+    while (1) {
+        int optionIndex = 0;
+        int optionChar = getopt_long(argc, argv, "hv", longOpts, &optionIndex);
+        if (optionChar == -1) break;
+        switch (optionChar) {
+        case 'e': engines = parseList(optarg); break;
+        case 'R': realtimes = parseList(optarg); break;
+        case 'F': formants = parseList(optarg); break;
+        case 'c': crispnesses = parseList(optarg); break;
+        case 't': threadings = parseList(optarg); break;
+        case 'b': blockSizes = parseList(optarg); break;
+        case 'n': channelCounts = parseList(optarg); break;
+        case 'j': jobCounts = parseList(optarg); break;
+        case 'a':
+            crispnesses = { 0, 1, 2, 3, 4, 5, 6 };
+            threadings = { 0, 1, 2 };
+            blockSizes = { 256, 512, 1024, 2048 };
+            channelCounts = { 1, 2 };
+            break;
+        case 'i': inputFile = optarg; break;
+        case 's': seconds = atof(optarg); break;
+        case 'p': pitch = atof(optarg); break;
+        case 'o': outputFile = optarg; break;
+        case 'v': verbose = true; break;
+        default: printUsage(argv[0]); return 0;
+        }
+    }
+    if (!inputFile.empty()) {
+        channelCounts = { 0 }; // from file
+    }
+
+    fs::path tempDir = fs::temp_directory_path();
+    std::string outPath = (tempDir / "pitch-shifting-bench.out.wav").string();
+
+    NullBuffer nullBuffer;
+    std::streambuf* cerrBuffer = cerr.rdbuf();
+
+    std::stringstream json;
+    json << "{\n";
+    json << "  \"rubberband\": \"" << RUBBERBAND_VERSION << "\",\n";
+    json << "  \"simd\": \"" << PitchShifting::SimdKernelName() << "\",\n";
+    json << "  \"input\": " << jsonString(inputFile.empty() ? "synthetic" : inputFile) << ",\n";
+    json << "  \"pitch\": " << pitch << ",\n";
+    json << "  \"cases\": [";
+
+    int total = (int)(engines.size() * realtimes.size() * formants.size() * crispnesses.size() *
+        threadings.size() * blockSizes.size() * channelCounts.size() * jobCounts.size());
+    int index = 0;
+    int failed = 0;
+    for (int channels : channelCounts) {
+        std::string inPath = inputFile;
+        if (inPath.empty()) {
+            inPath = (tempDir / ("pitch-shifting-bench." + std::to_string(channels) + "ch.wav")).string();
+            if (!writeSyntheticFile(inPath, 48000, channels, seconds)) return 1;
+        }
+        for (int engine : engines)
+        for (int realtime : realtimes)
+        for (int formant : formants)
+        for (int crispness : crispnesses)
+        for (int threading : threadings)
+        for (int blockSize : blockSizes)
+        for (int jobs : jobCounts) {
+            BenchCase bc;
+            bc.finer = (engine == 1);
+            bc.psola = (engine == 2);
+            bc.realtime = (realtime != 0);
+            bc.formant = (formant != 0);
+            bc.crispness = crispness;
+            bc.threading = threading;
+            bc.blockSize = blockSize;
+            bc.channels = channels;
+            bc.jobs = jobs;
+
+            cerr << "[" << ++index << "/" << total << "] " << engineName(bc)
+                << (bc.realtime ? " realtime" : " offline") << (bc.formant ? " formant" : "")
+                << " crispness:" << crispness << " threading:" << threading
+                << " block:" << blockSize << " channels:" << channels << " jobs:" << jobs << endl;
+            // sndfile read/write mode would take format of previous case output
+            fs::remove(outPath);
+            if (!verbose) cerr.rdbuf(&nullBuffer);
+            BenchResult r = runCase(bc, inPath, outPath, pitch);
+            cerr.rdbuf(cerrBuffer);
+
+            std::sort(r.blockUs.begin(), r.blockUs.end());
+            double mean = 0.0;
+            for (double us : r.blockUs) mean += us;
+            if (!r.blockUs.empty()) mean /= r.blockUs.size();
+            double factor = (r.wallSeconds > 0.0) ? r.audioSeconds / r.wallSeconds : 0.0;
+            if (!r.ok) failed++;
+            cerr << "    " << (r.ok ? "" : "FAILED ") << "realtime factor " << factor
+                << ", block p50 " << percentile(r.blockUs, 50) << "us p99 " << percentile(r.blockUs, 99) << "us" << endl;
+
+            json << (index > 1 ? "," : "") << "\n    {";
+            json << "\"engine\": \"" << engineName(bc) << "\", ";
+            json << "\"realtime\": " << (bc.realtime ? "true" : "false") << ", ";
+            json << "\"formant\": " << (bc.formant ? "true" : "false") << ", ";
+            json << "\"crispness\": " << bc.crispness << ", ";
+            json << "\"threading\": " << bc.threading << ", ";
+            json << "\"blockSize\": " << bc.blockSize << ", ";
+            json << "\"channels\": " << (r.channels > 0 ? r.channels : bc.channels) << ", ";
+            json << "\"jobs\": " << bc.jobs << ", ";
+            json << "\"ok\": " << (r.ok ? "true" : "false") << ", ";
+            json << "\"audioSeconds\": " << r.audioSeconds << ", ";
+            json << "\"wallSeconds\": " << r.wallSeconds << ", ";
+            json << "\"realtimeFactor\": " << factor << ", ";
+            json << "\"inFrames\": " << r.inFrames << ", ";
+            json << "\"outFrames\": " << r.outFrames << ", ";
+            json << "\"blocks\": " << r.blockUs.size() << ", ";
+            json << "\"blockLatencyUs\": {";
+            json << "\"mean\": " << mean << ", ";
+            json << "\"p50\": " << percentile(r.blockUs, 50) << ", ";
+            json << "\"p90\": " << percentile(r.blockUs, 90) << ", ";
+            json << "\"p99\": " << percentile(r.blockUs, 99) << ", ";
+            json << "\"max\": " << (r.blockUs.empty() ? 0.0 : r.blockUs.back()) << "}, ";
+            // NOTE: process peak so far, cases run in the same process
+            json << "\"peakRssKb\": " << r.peakRssKb << "}";
+        }
+        if (inputFile.empty()) {
+            fs::remove(inPath);
+        }
+    }
+    fs::remove(outPath);
+    json << "\n  ]\n}\n";
+
+    if (outputFile.empty()) {
+        std::cout << json.str();
+    }
+    else {
+        std::ofstream out(outputFile);
+        out << json.str();
+        cerr << "results written to " << outputFile << endl;
+    }
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,229 @@
+#include "envelope.hpp"
+#include "kernels.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace PitchShifting {
+
+static const double pi = 3.14159265358979323846;
+// frames analyzed per Process() call at most, the older ones of a large block are skipped
+static const int maxFramesPerCall = 8;
+// floor of power spectrum before log, ~-200dB keeps silence finite
+static const float powerFloor = 1e-20f;
+// natural log of magnitude to dB
+static const double logToDb = 20.0 / log(10.0);
+
+EnvelopeAnalyzer::EnvelopeAnalyzer() {
+}
+
+EnvelopeAnalyzer::~EnvelopeAnalyzer() {
+    CloseCsv();
+}
+
+bool
+EnvelopeAnalyzer::Prepare(int rate, int size, double cutoffMs, double rateOfFrames) {
+    if (rate <= 0 || size < 64 || size > 65536 || cutoffMs <= 0.0 || rateOfFrames <= 0.0) return false;
+    size = Fft::NextPowerOfTwo(size);
+    sampleRate = rate;
+    frameRate = rateOfFrames;
+    hop = std::max(1, (int)lround(rate / rateOfFrames));
+    // lifter can not be wider than half of the cepstrum
+    lifter = std::min(size / 2 - 1, std::max(1, (int)lround(cutoffMs * 0.001 * rate)));
+
+    if (!fft || fft->GetSize() != size) {
+        fft.reset(new Fft(size));
+    }
+    fftSize = size;
+    // hann scaled to sum 2, a full scale sine at a bin center reads magnitude 1
+    window.resize(size);
+    double sum = 0.0;
+    for (int i = 0; i < size; ++i) {
+        window[i] = (float)(0.5 - 0.5 * cos(2.0 * pi * i / size));
+        sum += window[i];
+    }
+    for (int i = 0; i < size; ++i) window[i] = (float)(window[i] * 2.0 / sum);
+    re.assign(size, 0.f);
+    im.assign(size, 0.f);
+    logMag.assign(size / 2 + 1, 0.f);
+    cepstra.assign(size, 0.0);
+    envelope.assign(size / 2 + 1, 0.0);
+    spectrum.assign(size / 2 + 1, 0.0);
+    real.assign(size / 2 + 1, 0.0);
+    imag.assign(size / 2 + 1, 0.0);
+    previousSpectrum.assign(size / 2 + 1, 0.0);
+    frameCount = 0;
+    Reset();
+    return true;
+}
+
+void
+EnvelopeAnalyzer::Reset() {
+    history.assign(fftSize, 0.f);
+    writePos = 0;
+    sinceHop = 0;
+    framesIn = 0;
+}
+
+void
+EnvelopeAnalyzer::Process(const float* const* channels, int channelCount, size_t frames) {
+    if (sampleRate <= 0 || channelCount <= 0) return;
+    TRACE_SCOPE("envelope");
+    float gain = 1.f / channelCount;
+    // frames before it would be overwritten by later frames of the same block
+    int64_t analyzeFrom = framesIn + (int64_t)frames - (int64_t)maxFramesPerCall * hop;
+    size_t length = history.size();
+    for (size_t i = 0; i < frames; ++i) {
+        float mono = 0.f;
+        for (int c = 0; c < channelCount; ++c) mono += channels[c][i];
+        history[writePos] = mono * gain;
+        if (++writePos == length) writePos = 0;
+        framesIn++;
+        if (++sinceHop < hop) continue;
+        sinceHop = 0;
+        if (framesIn >= analyzeFrom) {
+            analyze();
+        }
+    }
+}
+
+void
+EnvelopeAnalyzer::analyze() {
+    int size = fftSize;
+    int bins = size / 2 + 1;
+    // unroll the ring from the oldest sample
+    size_t first = size - writePos;
+    for (size_t j = 0; j < first; ++j) re[j] = history[writePos + j] * window[j];
+    for (size_t j = first; j < (size_t)size; ++j) re[j] = history[j - first] * window[j];
+    fft->ForwardReal(re.data(), im.data());
+
+    for (int k = 0; k < bins; ++k) {
+        float power = re[k] * re[k] + im[k] * im[k];
+        logMag[k] = power + powerFloor;
+        previousSpectrum[k] = spectrum[k];
+        spectrum[k] = sqrt((double)power);
+        real[k] = re[k];
+        imag[k] = im[k];
+    }
+    FastLog(logMag.data(), logMag.data(), bins);
+    // log power halved is log magnitude, mirrored to a real even spectrum, its inverse is the real cepstrum
+    for (int k = 0; k < bins; ++k) {
+        logMag[k] *= 0.5f;
+        re[k] = logMag[k];
+        im[k] = 0.f;
+    }
+    for (int k = bins; k < size; ++k) {
+        re[k] = logMag[size - k];
+        im[k] = 0.f;
+    }
+    fft->Inverse(re.data(), im.data());
+    for (int q = 0; q < size; ++q) cepstra[q] = re[q];
+
+    // keep quefrencies below the cutoff on both sides, the rest is pitch harmonics and noise
+    for (int q = lifter + 1; q < size - lifter; ++q) re[q] = 0.f;
+    std::fill(im.begin(), im.end(), 0.f);
+    fft->Forward(re.data(), im.data());
+    if (csvThread.joinable() && bins == csvBins) {
+        queueCsv((double)framesIn / sampleRate, re.data());
+    }
+    FastExp(re.data(), re.data(), bins);
+    for (int k = 0; k < bins; ++k) envelope[k] = re[k];
+    frameCount++;
+}
+
+bool
+EnvelopeAnalyzer::OpenCsv(const std::string& path) {
+    CloseCsv();
+    csv.open(path, std::ios::out | std::ios::trunc);
+    if (!csv.is_open()) return false;
+    int bins = fftSize / 2 + 1;
+    csv << "time";
+    for (int k = 0; k < bins; ++k) {
+        csv << "," << (double)k * sampleRate / fftSize;
+    }
+    csv << "\n";
+    if (!csv.good()) {
+        csv.close();
+        return false;
+    }
+    // time and up to 12 chars per bin, eg. ",-123.4"
+    csvLine.resize(32 + (size_t)bins * 12);
+    // rows of a former file are all back in free list after CloseCsv(), replace them
+    float* row = nullptr;
+    while (csvFree.read(&row, 1) == 1) {}
+    csvBins = bins;
+    csvStorage.assign(csvRows, std::vector<float>(bins));
+    for (auto& storage : csvStorage) {
+        row = storage.data();
+        csvFree.write(&row, 1);
+    }
+    csvStalls.store(0);
+    csvQuit.store(false);
+    csvThread = std::thread(&EnvelopeAnalyzer::runCsv, this);
+    return true;
+}
+
+void
+EnvelopeAnalyzer::CloseCsv() {
+    if (csvThread.joinable()) {
+        csvQuit.store(true);
+        csvPendingSignal.Signal();
+        csvThread.join();
+    }
+    if (csv.is_open()) {
+        csv.close();
+    }
+}
+
+void
+EnvelopeAnalyzer::queueCsv(double time, const float* logEnvelope) {
+    float* row = nullptr;
+    if (csvFree.read(&row, 1) == 0) {
+        // all rows are queued, writer falls behind
+        csvStalls.fetch_add(1, std::memory_order_relaxed);
+        TRACE_SCOPE("csv stall");
+        while (csvFree.read(&row, 1) == 0) {
+            csvFreeSignal.Wait(signalTimeoutMs);
+        }
+    }
+    std::copy(logEnvelope, logEnvelope + csvBins, row);
+    CsvRow pending = { time, row };
+    csvPending.write(&pending, 1);
+    csvPendingSignal.Signal();
+}
+
+void
+EnvelopeAnalyzer::drainCsv() {
+    CsvRow pending;
+    while (csvPending.read(&pending, 1) == 1) {
+        TRACE_SCOPE("csv row");
+        char* line = csvLine.data();
+        size_t capacity = csvLine.size();
+        size_t used = (size_t)snprintf(line, capacity, "%.4f", pending.time);
+        for (int k = 0; k < csvBins && used < capacity; ++k) {
+            used += (size_t)snprintf(line + used, capacity - used, ",%.1f", pending.logEnvelope[k] * logToDb);
+        }
+        if (used >= capacity) used = capacity - 1;
+        line[used++] = '\n';
+        // row is free again as soon as formatted
+        csvFree.write(&pending.logEnvelope, 1);
+        csvFreeSignal.Signal();
+        csv.write(line, used);
+    }
+}
+
+void
+EnvelopeAnalyzer::runCsv() {
+    Trace::SetThreadName("csv writer");
+    while (true) {
+        csvPendingSignal.Wait(signalTimeoutMs);
+        drainCsv();
+        if (csvQuit.load()) {
+            drainCsv();
+            break;
+        }
+    }
+}
+
+} // namespace PitchShifting
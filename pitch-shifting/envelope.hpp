@@ -0,0 +1,126 @@
+#pragma once
+/*
+ * spectral envelope (formant) analysis of stretcher input, independent of rubberband internals
+ *   - channels are mixed to mono, every hop (1 / frame rate) the latest fft size window is hann windowed
+ *   - log magnitude goes back by inverse fft to the real cepstrum, quefrencies above cutoff are liftered out
+ *     and the forward fft of the rest is the smoothed log envelope, log and exp are simd kernels
+ *   - fft plan and buffers are allocated by Prepare(), Process() never allocates
+ *   - latest frame is kept in double buffers in the same layout as rubberband formant data for plotting
+ *     (cepstra fft size, envelope and spectrum fft size / 2 + 1), overwritten in place every frame,
+ *     real/imaginary parts and the previous magnitude of the windowed spectrum feed the scale plot
+ *   - optional csv export of every frame, time and envelope dB per bin, rows are copied to a free list
+ *     and formatted and written on a csv writer thread the same way FileWriter does for audio
+ *   - per Process() call at most a few frames are analyzed, a large block skips the older frames
+ * NOTE: Process() and Reset() are called by one thread (stretcher thread), plot readers may see a frame
+ *   partially written the same as rubberband formant data
+ */
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "fft.hpp"
+#include "ringbuffer.hpp"
+#include "semaphore.hpp"
+
+namespace PitchShifting {
+
+class EnvelopeAnalyzer {
+public:
+    EnvelopeAnalyzer();
+    virtual ~EnvelopeAnalyzer();
+    EnvelopeAnalyzer(const EnvelopeAnalyzer&) = delete;
+    EnvelopeAnalyzer& operator=(const EnvelopeAnalyzer&) = delete;
+
+    /* fftSize is rounded up to power of 2, cutoffMs is the lifter quefrency (lower is smoother),
+     * frameRate is envelopes per second, start a new stream, \return false if out of range */
+    bool Prepare(int sampleRate, int fftSize = 2048, double cutoffMs = 1.5, double frameRate = 50.0);
+    void Reset();
+    bool IsPrepared() const { return sampleRate > 0; }
+
+    /* per channel blocks of frames, eg. stretcher cbuf */
+    void Process(const float* const* channels, int channelCount, size_t frames);
+
+    /* export frames to csv from now on, header row is bin frequencies, \return false if not writable */
+    bool OpenCsv(const std::string& path);
+    /* write queued rows, stop csv writer thread and close the file */
+    void CloseCsv();
+    bool IsCsvOpen() const { return csvThread.joinable(); }
+    /* frames waited for a free row, csv writer falls behind */
+    uint64_t GetCsvStalls() const { return csvStalls.load(std::memory_order_relaxed); }
+
+    int GetFftSize() const { return fftSize; }
+    int GetBinCount() const { return fftSize / 2 + 1; }
+    double GetFrameRate() const { return frameRate; }
+    /* frames analyzed since Prepare() */
+    uint64_t GetFrameCount() const { return frameCount; }
+
+    /* latest frame, fft size of real cepstrum */
+    double* GetCepstra() { return cepstra.data(); }
+    /* latest frame, bin count of magnitude, smoothed envelope and the spectrum it comes from */
+    double* GetEnvelope() { return envelope.data(); }
+    double* GetSpectrum() { return spectrum.data(); }
+    /* latest frame, bin count of windowed spectrum parts and the magnitude of the frame before */
+    double* GetReal() { return real.data(); }
+    double* GetImaginary() { return imag.data(); }
+    double* GetPreviousSpectrum() { return previousSpectrum.data(); }
+
+private:
+    // analyze the window ending at the newest sample
+    void analyze();
+    // stretcher thread, copy log envelope of bins to a free row and queue it, waits only if none is free
+    void queueCsv(double time, const float* logEnvelope);
+    // csv writer thread
+    void runCsv();
+    void drainCsv();
+
+    struct CsvRow {
+        double time;
+        float* logEnvelope;
+    };
+    static const int csvRows = 64;
+
+    int sampleRate = 0;
+    int fftSize = 0;
+    int hop = 0;
+    int lifter = 0; // cepstral coefficients kept on each side
+    double frameRate = 0.0;
+
+    // mono ring of fft size, write position is the oldest sample
+    std::vector<float> history;
+    size_t writePos = 0;
+    int sinceHop = 0;
+    int64_t framesIn = 0;
+    uint64_t frameCount = 0;
+
+    std::unique_ptr<Fft> fft;
+    std::vector<float> window;
+    std::vector<float> re, im;
+    std::vector<float> logMag;
+
+    std::vector<double> cepstra;
+    std::vector<double> envelope;
+    std::vector<double> spectrum;
+    std::vector<double> real;
+    std::vector<double> imag;
+    std::vector<double> previousSpectrum;
+
+    // csv writer thread owns the stream and line buffer while running
+    std::ofstream csv;
+    std::vector<char> csvLine;
+    int csvBins = 0;
+    std::vector<std::vector<float>> csvStorage;
+    SpscRingBuffer<float*> csvFree{ csvRows }; // writer -> stretcher
+    SpscRingBuffer<CsvRow> csvPending{ csvRows }; // stretcher -> writer
+    std::thread csvThread;
+    std::atomic<bool> csvQuit{ false };
+    Semaphore csvPendingSignal;
+    Semaphore csvFreeSignal;
+    int signalTimeoutMs = 100;
+    std::atomic<uint64_t> csvStalls{ 0 };
+};
+
+} // namespace PitchShifting
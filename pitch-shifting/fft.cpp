@@ -0,0 +1,128 @@
+#include "fft.hpp"
+#include <cmath>
+#include <utility>
+
+namespace PitchShifting {
+
+static const double pi = 3.14159265358979323846;
+
+int
+Fft::NextPowerOfTwo(int n) {
+    int p = 2;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+Fft::Fft(int size) : size(IsPowerOfTwo(size) ? size : NextPowerOfTwo(size)) {
+    int bits = 0;
+    while ((1 << bits) < this->size) bits++;
+    reversed.resize(this->size);
+    for (int i = 0; i < this->size; ++i) {
+        int r = 0;
+        for (int b = 0; b < bits; ++b) {
+            if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+        }
+        reversed[i] = r;
+    }
+    cosTable.resize(this->size / 2);
+    sinTable.resize(this->size / 2);
+    for (int k = 0; k < this->size / 2; ++k) {
+        cosTable[k] = (float)cos(2.0 * pi * k / this->size);
+        sinTable[k] = (float)sin(2.0 * pi * k / this->size);
+    }
+}
+
+void
+Fft::transform(float* re, float* im, float sign, int n) const {
+    // a shorter power of 2 transform reuses the tables, bit reversal of i over fewer bits is reversed[i * ratio]
+    int ratio = size / n;
+    for (int i = 0; i < n; ++i) {
+        int r = reversed[i * ratio];
+        if (r > i) {
+            std::swap(re[i], re[r]);
+            std::swap(im[i], im[r]);
+        }
+    }
+    // butterflies of growing span, twiddle index steps by size / span
+    for (int span = 2; span <= n; span <<= 1) {
+        int half = span >> 1;
+        int step = size / span;
+        for (int start = 0; start < n; start += span) {
+            for (int k = 0; k < half; ++k) {
+                float wr = cosTable[k * step];
+                float wi = sign * sinTable[k * step];
+                int a = start + k;
+                int b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+void
+Fft::Forward(float* re, float* im) const {
+    transform(re, im, -1.f, size);
+}
+
+void
+Fft::Inverse(float* re, float* im) const {
+    transform(re, im, 1.f, size);
+    float scale = 1.f / size;
+    for (int i = 0; i < size; ++i) {
+        re[i] *= scale;
+        im[i] *= scale;
+    }
+}
+
+void
+Fft::ForwardReal(float* re, float* im) const {
+    int h = size / 2;
+    if (h < 2) {
+        for (int i = 0; i < size; ++i) im[i] = 0.f;
+        transform(re, im, -1.f, size);
+        return;
+    }
+    // even and odd samples packed as one complex sequence z of half size, z lives in re[0, h) and im[h, size)
+    for (int n = 0; n < h; ++n) {
+        im[n] = re[2 * n];
+        im[h + n] = re[2 * n + 1];
+    }
+    for (int n = 0; n < h; ++n) re[n] = im[n];
+    float* zi = im + h;
+    transform(re, zi, -1.f, h);
+
+    // split Z[k] and Z[h - k] into spectra of even E and odd O samples, X[k] = E[k] + w^k O[k],
+    // X[h - k] = conj(E[k]) - conj(w^k O[k]), pairs are read before they are written
+    for (int k = 1; k <= h / 2; ++k) {
+        int m = h - k;
+        float ar = re[k], ai = zi[k];
+        float br = re[m], bi = zi[m];
+        float er = 0.5f * (ar + br), ei = 0.5f * (ai - bi);
+        float or_ = 0.5f * (ai + bi), oi = -0.5f * (ar - br);
+        // w^k = cos - i sin of 2 pi k / size
+        float wr = cosTable[k], wi = -sinTable[k];
+        float tr = or_ * wr - oi * wi;
+        float ti = or_ * wi + oi * wr;
+        re[k] = er + tr;
+        im[k] = ei + ti;
+        re[m] = er - tr;
+        im[m] = -(ei - ti);
+    }
+    float dc = re[0], ny = zi[0];
+    re[0] = dc + ny;
+    im[0] = 0.f;
+    re[h] = dc - ny;
+    im[h] = 0.f;
+    // upper half mirrors the lower one as conjugates, overwrites the rest of z
+    for (int k = h + 1; k < size; ++k) {
+        re[k] = re[size - k];
+        im[k] = -im[size - k];
+    }
+}
+
+} // namespace PitchShifting
@@ -0,0 +1,44 @@
+#pragma once
+/*
+ * radix-2 complex fft for analysis outside rubberband (pitch tracking, spectral envelope)
+ *   - iterative decimation in time on split real/imaginary arrays, in place
+ *   - bit reversal and twiddles are tabled per size at construction, transforms never allocate
+ *   - inverse is scaled by 1/size, Inverse(Forward(x)) == x
+ *   - real input goes through a half size transform sharing the same tables
+ * NOTE: const after construction, one instance can be shared by threads with their own buffers
+ */
+#include <vector>
+
+namespace PitchShifting {
+
+class Fft {
+public:
+    /* size must be a power of 2 and at least 2 */
+    explicit Fft(int size);
+    virtual ~Fft() {}
+
+    static bool IsPowerOfTwo(int n) { return n >= 2 && (n & (n - 1)) == 0; }
+    /* smallest power of 2 not less than n */
+    static int NextPowerOfTwo(int n);
+
+    int GetSize() const { return size; }
+
+    /* re[size] and im[size] are transformed in place */
+    void Forward(float* re, float* im) const;
+    void Inverse(float* re, float* im) const;
+    /* real input, re[size] is transformed in place and im[size] is overwritten, half size complex
+     * transform of packed even/odd samples, bins 0 to size/2 are computed, the upper half mirrors them */
+    void ForwardReal(float* re, float* im) const;
+
+private:
+    // first n points, n is a power of 2 up to size
+    void transform(float* re, float* im, float sign, int n) const;
+
+    int size;
+    std::vector<int> reversed;
+    // cos and sin of 2 * pi * k / size for k < size / 2
+    std::vector<float> cosTable;
+    std::vector<float> sinTable;
+};
+
+} // namespace PitchShifting
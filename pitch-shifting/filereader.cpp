@@ -0,0 +1,112 @@
+#include "filereader.hpp"
+#include "trace.hpp"
+#include <chrono>
+
+namespace PitchShifting {
+
+FileReader::FileReader(int channels, int blockSize, int depth)
+    : channels(channels), blockSize(blockSize), depth(depth < 1 ? 1 : depth) {
+    blocks.resize(FileReader::depth);
+    for (auto& block : blocks) {
+        block.data.resize((size_t)channels * blockSize);
+    }
+}
+
+FileReader::~FileReader() {
+    Stop();
+}
+
+void
+FileReader::Start(SNDFILE* sndfile) {
+    Stop();
+    file = sndfile;
+    writeCount.store(0);
+    readCount.store(0);
+    eof.store(false);
+    quit.store(false);
+    running.store(true);
+    thread = std::thread(&FileReader::run, this);
+}
+
+void
+FileReader::Stop() {
+    if (!thread.joinable()) return;
+    quit.store(true);
+    spaceSignal.Signal();
+    thread.join();
+    running.store(false);
+}
+
+void
+FileReader::Seek(SNDFILE* sndfile, sf_count_t frame) {
+    Stop();
+    sf_seek(sndfile, frame, SEEK_SET);
+    Start(sndfile);
+}
+
+sf_count_t
+FileReader::Front(const float** data) {
+    uint64_t r = readCount.load(std::memory_order_relaxed);
+    if (writeCount.load(std::memory_order_acquire) == r) {
+        // nothing queued, end of file or reader falls behind
+        auto waitBegin = std::chrono::steady_clock::now();
+        bool starved = false;
+        while (writeCount.load(std::memory_order_acquire) == r) {
+            if (eof.load(std::memory_order_acquire) && writeCount.load(std::memory_order_acquire) == r) {
+                return 0;
+            }
+            if (!running.load()) return 0;
+            starved = true;
+            TRACE_SCOPE("reader starved");
+            dataSignal.Wait(signalTimeoutMs);
+        }
+        if (starved) {
+            starvations.fetch_add(1, std::memory_order_relaxed);
+            starvedMicros.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - waitBegin).count(), std::memory_order_relaxed);
+        }
+    }
+    const Block& block = blocks[r % depth];
+    *data = block.data.data();
+    return block.frames;
+}
+
+void
+FileReader::Pop() {
+    readCount.fetch_add(1, std::memory_order_release);
+    spaceSignal.Signal();
+}
+
+void
+FileReader::run() {
+    Trace::SetThreadName("file reader");
+    while (!quit.load()) {
+        uint64_t w = writeCount.load(std::memory_order_relaxed);
+        // queue full, wait consumer releases a block
+        if (w - readCount.load(std::memory_order_acquire) >= (uint64_t)depth) {
+            spaceSignal.Wait(signalTimeoutMs);
+            continue;
+        }
+        Block& block = blocks[w % depth];
+        sf_count_t count;
+        {
+            TRACE_SCOPE("sf_readf_float");
+            count = sf_readf_float(file, block.data.data(), blockSize);
+        }
+        if (count <= 0) {
+            eof.store(true, std::memory_order_release);
+            dataSignal.Signal();
+            break;
+        }
+        block.frames = count;
+        blocksRead.fetch_add(1, std::memory_order_relaxed);
+        writeCount.store(w + 1, std::memory_order_release);
+        dataSignal.Signal();
+        if (count < blockSize) {
+            eof.store(true, std::memory_order_release);
+            break;
+        }
+    }
+}
+
+} // namespace PitchShifting
@@ -0,0 +1,82 @@
+#pragma once
+/*
+ * prefetching reader of input sound file, decodes ahead on its own thread into a bounded queue of blocks,
+ * so disk or page cache stalls do not stall the stretcher thread
+ *   - single producer (reader thread) and single consumer (stretcher thread), block indexes are atomics
+ *   - consumer takes a block in place by Front() and releases it by Pop(), no copy and no lock
+ *   - starvation counts how many times the consumer found the queue empty before end of file
+ * NOTE: sndfile handle is owned by caller, nobody else may read or seek it while reader is running
+ */
+#include <sndfile.h>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "semaphore.hpp"
+
+namespace PitchShifting {
+
+class FileReader {
+public:
+    /* depth is the number of blocks decoded ahead */
+    FileReader(int channels, int blockSize, int depth = 8);
+    virtual ~FileReader();
+    FileReader(const FileReader&) = delete;
+    FileReader& operator=(const FileReader&) = delete;
+
+    /* start reading given file from its current position */
+    void Start(SNDFILE* file);
+    /* stop reader thread and drop queued blocks, file position is undefined afterward */
+    void Stop();
+    bool IsRunning() const { return running; }
+    /* stop, seek file and start again */
+    void Seek(SNDFILE* file, sf_count_t frame);
+
+    /*
+     * wait for next block, data stays valid until Pop()
+     * \return frames of the block, less than block size at end of file, 0 if no more data
+     */
+    sf_count_t Front(const float** data);
+    /* release the block from Front() for reader to fill again */
+    void Pop();
+
+    int GetDepth() const { return depth; }
+    /* blocks ready for consumer */
+    int GetQueued() const { return (int)(writeCount.load(std::memory_order_acquire) - readCount.load(std::memory_order_relaxed)); }
+    uint64_t GetBlocksRead() const { return blocksRead.load(std::memory_order_relaxed); }
+    uint64_t GetStarvations() const { return starvations.load(std::memory_order_relaxed); }
+    /* total time consumer waited on empty queue in microseconds */
+    uint64_t GetStarvedMicros() const { return starvedMicros.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+
+    struct Block {
+        std::vector<float> data;
+        sf_count_t frames = 0;
+    };
+
+    int channels;
+    int blockSize;
+    int depth;
+    std::vector<Block> blocks;
+    SNDFILE* file = nullptr;
+    std::thread thread;
+    std::atomic<bool> running{ false };
+    std::atomic<bool> quit{ false };
+    // reader reached end of file, no block after writeCount
+    std::atomic<bool> eof{ false };
+    // block n is blocks[n % depth], writeCount - readCount is the queued blocks
+    std::atomic<uint64_t> writeCount{ 0 };
+    std::atomic<uint64_t> readCount{ 0 };
+    // signalled by reader per filled block and by consumer per released block
+    Semaphore dataSignal;
+    Semaphore spaceSignal;
+    int signalTimeoutMs = 100;
+
+    std::atomic<uint64_t> blocksRead{ 0 };
+    std::atomic<uint64_t> starvations{ 0 };
+    std::atomic<uint64_t> starvedMicros{ 0 };
+};
+
+} // namespace PitchShifting
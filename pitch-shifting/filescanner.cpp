@@ -0,0 +1,158 @@
+#include "filescanner.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+using std::cerr;
+using std::endl;
+
+namespace PitchShifting {
+
+// small batches, the first results show up before the whole directory is walked
+static const size_t scanBatchSize = 16;
+
+FileScanner::FileScanner(PeakCache* peakCache, int threads)
+    : cache(peakCache ? peakCache : &uncached), pool(threads) {
+}
+
+FileScanner::~FileScanner() {
+    Cancel();
+}
+
+std::vector<std::string>
+FileScanner::ParseExtensions(const std::string& list) {
+    std::vector<std::string> extensions;
+    size_t begin = 0;
+    while (begin <= list.size()) {
+        size_t end = list.find(',', begin);
+        if (end == std::string::npos) end = list.size();
+        std::string ext = list.substr(begin, end - begin);
+        ext.erase(std::remove_if(ext.begin(), ext.end(), [](unsigned char c) { return isspace(c); }), ext.end());
+        if (!ext.empty() && ext[0] != '.') ext.insert(ext.begin(), '.');
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)tolower(c); });
+        if (ext.size() > 1) extensions.push_back(ext);
+        begin = end + 1;
+    }
+    return extensions;
+}
+
+bool
+FileScanner::Start(const std::string& dir, bool recursive, const std::vector<std::string>& extensions, ResultFn onFound) {
+    Cancel();
+    std::error_code ec;
+    if (!fs::is_directory(dir, ec)) return false;
+    canceled.store(false);
+    probed.store(0);
+    found.store(0);
+    skipped.store(0);
+    callback = onFound;
+    walking.store(true);
+    walker = std::thread(&FileScanner::walk, this, dir, recursive, extensions);
+    return true;
+}
+
+void
+FileScanner::Cancel() {
+    canceled.store(true);
+    Wait();
+}
+
+void
+FileScanner::Wait() {
+    if (walker.joinable()) {
+        walker.join();
+    }
+    pool.Wait();
+}
+
+void
+FileScanner::walk(std::string dir, bool recursive, std::vector<std::string> extensions) {
+    Trace::SetThreadName("file scanner");
+    TRACE_SCOPE("scan walk");
+    auto accept = [&extensions](const fs::path& path) {
+        if (extensions.empty()) return true;
+        std::string ext = path.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)tolower(c); });
+        return std::find(extensions.begin(), extensions.end(), ext) != extensions.end();
+    };
+
+    std::vector<std::string> batch;
+    auto add = [this, &batch, &accept](const fs::path& path) {
+        try {
+            if (accept(path)) batch.push_back(path.string());
+        }
+        catch (std::exception&) {
+            // windows path out of the ansi code page has no narrow form, sources are opened by narrow path
+            // (sf_open) everywhere, so the file could not be played anyway
+            skipped.fetch_add(1, std::memory_order_relaxed);
+            cerr << "WARNING: Skipped file, path is not representable in local code page \"" << path.u8string() << "\"" << endl;
+        }
+    };
+    auto submit = [this, &batch]() {
+        if (batch.empty()) return;
+        pendingBatches++;
+        pool.Submit([this, paths = std::move(batch)]() {
+            probe(paths);
+            pendingBatches--;
+        });
+        batch.clear();
+    };
+
+    std::error_code ec;
+    auto options = fs::directory_options::skip_permission_denied;
+    if (recursive) {
+        fs::recursive_directory_iterator it(dir, options, ec);
+        for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+            if (canceled.load()) break;
+            const auto& entry = *it;
+            std::error_code typeEc;
+            // hidden directories, eg. .git and peak cache, never hold sources
+            if (entry.is_directory(typeEc)) {
+                auto name = entry.path().filename().native();
+                if (!name.empty() && name[0] == '.') it.disable_recursion_pending();
+                continue;
+            }
+            if (!entry.is_regular_file(typeEc)) continue;
+            add(entry.path());
+            if (batch.size() >= scanBatchSize) submit();
+        }
+    }
+    else {
+        fs::directory_iterator it(dir, options, ec);
+        for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            if (canceled.load()) break;
+            const auto& entry = *it;
+            std::error_code typeEc;
+            if (!entry.is_regular_file(typeEc)) continue;
+            add(entry.path());
+            if (batch.size() >= scanBatchSize) submit();
+        }
+    }
+    if (!canceled.load()) submit();
+    walking.store(false);
+}
+
+void
+FileScanner::probe(const std::vector<std::string>& paths) {
+    TRACE_SCOPE("scan probe");
+    for (const auto& path : paths) {
+        if (canceled.load()) return;
+        PeakCacheEntry info;
+        bool ok = cache->GetInfo(path, &info);
+        probed.fetch_add(1, std::memory_order_relaxed);
+        if (!ok || info.sampleRate == 0) continue;
+
+        ScannedFile file;
+        file.path = path;
+        file.sampleRate = info.sampleRate;
+        file.channels = info.channels;
+        file.frames = info.frames;
+        found.fetch_add(1, std::memory_order_relaxed);
+        if (callback) callback(file);
+    }
+}
+
+} // namespace PitchShifting
@@ -0,0 +1,78 @@
+#pragma once
+/*
+ * scan of local audio files for source list, runs in background and reports files as they are found
+ *   - walker thread iterates the directory (optionally recursive, hidden directories skipped),
+ *     filters by extension and hands paths in small batches to a worker pool
+ *   - workers probe file info through peak cache, so unchanged files never open sndfile
+ *   - results are reported from worker threads in any order, caller synchronizes by itself
+ *   - Cancel() stops walking and probing, no result is reported after it returns
+ *   - paths without narrow form (unicode out of ansi code page on windows) are skipped with a warning
+ * NOTE: do not call Start()/Cancel()/Wait() from the result callback, they wait for the workers
+ */
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "peakcache.hpp"
+#include "workerpool.hpp"
+
+namespace PitchShifting {
+
+struct ScannedFile {
+    std::string path;
+    int sampleRate = 0;
+    int channels = 0;
+    int64_t frames = 0;
+};
+
+class FileScanner {
+public:
+    typedef std::function<void(const ScannedFile&)> ResultFn;
+
+    /* cache may be null or disabled, threads <= 0 uses hardware concurrency */
+    explicit FileScanner(PeakCache* cache, int threads = 0);
+    virtual ~FileScanner();
+    FileScanner(const FileScanner&) = delete;
+    FileScanner& operator=(const FileScanner&) = delete;
+
+    /* parse comma separated extensions, eg. "wav,flac,.ogg", case insensitive, empty accepts any file */
+    static std::vector<std::string> ParseExtensions(const std::string& list);
+
+    /* cancel running scan and start a new one, \return false if dir is not a directory */
+    bool Start(const std::string& dir, bool recursive, const std::vector<std::string>& extensions, ResultFn onFound);
+    /* stop scan and wait for workers */
+    void Cancel();
+    /* wait for scan to complete */
+    void Wait();
+    /* walker is iterating or workers are probing */
+    bool IsRunning() const { return walking.load() || pendingBatches.load() > 0; }
+
+    /* files matched the filter and probed by workers */
+    uint64_t GetProbed() const { return probed.load(std::memory_order_relaxed); }
+    /* files sndfile can read, reported to callback */
+    uint64_t GetFound() const { return found.load(std::memory_order_relaxed); }
+    /* files skipped by walker, path has no narrow form */
+    uint64_t GetSkipped() const { return skipped.load(std::memory_order_relaxed); }
+
+private:
+    void walk(std::string dir, bool recursive, std::vector<std::string> extensions);
+    void probe(const std::vector<std::string>& paths);
+
+    // stands in for null cache, probes without keeping entries
+    PeakCache uncached{ std::string() };
+    PeakCache* cache;
+    WorkerPool pool;
+    std::thread walker;
+    ResultFn callback;
+    std::atomic<bool> canceled{ false };
+    // batches submitted to pool and not finished, walker is done when it drops to 0 after walking
+    std::atomic<int> pendingBatches{ 0 };
+    std::atomic<bool> walking{ false };
+    std::atomic<uint64_t> probed{ 0 };
+    std::atomic<uint64_t> found{ 0 };
+    std::atomic<uint64_t> skipped{ 0 };
+};
+
+} // namespace PitchShifting
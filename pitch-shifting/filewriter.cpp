@@ -0,0 +1,133 @@
+#include "filewriter.hpp"
+#include "trace.hpp"
+#include <algorithm>
+
+namespace PitchShifting {
+
+FileWriter::FileWriter(int channels, int blockSize, int blocks, int coalesceFrames)
+    : channels(channels), blockSize(blockSize), coalesceFrames(std::max(coalesceFrames, blockSize)),
+    freeBlocks(blocks < 1 ? 1 : blocks), pending(blocks < 1 ? 1 : blocks) {
+    storage.resize(blocks < 1 ? 1 : blocks);
+    for (auto& block : storage) {
+        block.resize((size_t)channels * blockSize);
+        float* ptr = block.data();
+        freeBlocks.write(&ptr, 1);
+    }
+    coalesce.resize((size_t)FileWriter::coalesceFrames * channels);
+}
+
+FileWriter::~FileWriter() {
+    Close();
+}
+
+void
+FileWriter::Start(SNDFILE* sndfile) {
+    Close();
+    file = sndfile;
+    quit.store(false);
+    thread = std::thread(&FileWriter::run, this);
+}
+
+void
+FileWriter::Close() {
+    if (!thread.joinable()) return;
+    quit.store(true);
+    pendingSignal.Signal();
+    thread.join();
+}
+
+float*
+FileWriter::Acquire() {
+    float* block = nullptr;
+    if (freeBlocks.read(&block, 1) == 1) return block;
+    // all blocks are queued, writer falls behind
+    stalls.fetch_add(1, std::memory_order_relaxed);
+    TRACE_SCOPE("writer stall");
+    while (freeBlocks.read(&block, 1) == 0) {
+        freeSignal.Wait(signalTimeoutMs);
+    }
+    return block;
+}
+
+void
+FileWriter::Submit(float* block, int frames) {
+    Pending p = { block, frames };
+    pending.write(&p, 1);
+    pendingSignal.Signal();
+}
+
+void
+FileWriter::Write(const float* data, size_t frames) {
+    while (frames > 0) {
+        int count = (int)std::min(frames, (size_t)blockSize);
+        float* block = Acquire();
+        std::copy(data, data + (size_t)count * channels, block);
+        Submit(block, count);
+        data += (size_t)count * channels;
+        frames -= count;
+    }
+}
+
+void
+FileWriter::Flush() {
+    if (!thread.joinable()) return;
+    flushRequested.store(true);
+    pendingSignal.Signal();
+    while (flushRequested.load()) {
+        flushedSignal.Wait(signalTimeoutMs);
+    }
+}
+
+bool
+FileWriter::drain() {
+    Pending p;
+    bool any = false;
+    while (pending.read(&p, 1) == 1) {
+        any = true;
+        if (coalesced + p.frames > (size_t)coalesceFrames) {
+            writeCoalesced();
+        }
+        std::copy(p.block, p.block + (size_t)p.frames * channels, coalesce.data() + coalesced * channels);
+        coalesced += p.frames;
+        // block is free again as soon as copied
+        freeBlocks.write(&p.block, 1);
+        freeSignal.Signal();
+    }
+    return any;
+}
+
+void
+FileWriter::writeCoalesced() {
+    if (coalesced == 0) return;
+    TRACE_SCOPE("sf_writef_float");
+    sf_count_t count = sf_writef_float(file, coalesce.data(), (sf_count_t)coalesced);
+    if (count != (sf_count_t)coalesced) {
+        errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    framesWritten.fetch_add(coalesced, std::memory_order_relaxed);
+    writeCalls.fetch_add(1, std::memory_order_relaxed);
+    coalesced = 0;
+}
+
+void
+FileWriter::run() {
+    Trace::SetThreadName("file writer");
+    while (true) {
+        pendingSignal.Wait(signalTimeoutMs);
+        drain();
+        // keep partial buffer for next blocks unless asked to write out
+        if (quit.load()) {
+            drain();
+            writeCoalesced();
+            break;
+        }
+        if (flushRequested.load()) {
+            drain();
+            writeCoalesced();
+            flushRequested.store(false);
+            flushedSignal.Signal();
+        }
+    }
+}
+
+} // namespace PitchShifting
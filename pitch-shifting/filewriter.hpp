@@ -0,0 +1,84 @@
+#pragma once
+/*
+ * write-behind of output sound file, encoding and disk latency move from stretcher thread to writer thread
+ *   - stretcher thread takes an empty block from free list by Acquire(), fills it and hands it over by Submit()
+ *   - writer thread coalesces submitted blocks into large sf_writef_float calls and returns blocks to free list
+ *   - both lists are single producer/single consumer rings, stretcher thread never locks or touches sndfile
+ *   - Acquire() only waits if all blocks are queued (writer falls behind), counted as stalls
+ * NOTE: sndfile handle is owned by caller, Close() flushes and must be called before sf_close
+ */
+#include <sndfile.h>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "ringbuffer.hpp"
+#include "semaphore.hpp"
+
+namespace PitchShifting {
+
+class FileWriter {
+public:
+    /* blocks of blockSize frames in free list, writes are coalesced up to coalesceFrames */
+    FileWriter(int channels, int blockSize, int blocks = 16, int coalesceFrames = 65536);
+    virtual ~FileWriter();
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    /* start writer thread on given file at its current position */
+    void Start(SNDFILE* file);
+    /* write all submitted blocks and stop writer thread */
+    void Close();
+    bool IsRunning() const { return thread.joinable(); }
+
+    /* stretcher thread, empty block of blockSize * channels samples, waits if none is free */
+    float* Acquire();
+    /* stretcher thread, queue block from Acquire() with filled frames (<= blockSize) */
+    void Submit(float* block, int frames);
+    /* copy and submit arbitrary frames in blocks */
+    void Write(const float* data, size_t frames);
+    /* wait until all submitted frames are written to file */
+    void Flush();
+
+    int GetBlockSize() const { return blockSize; }
+    uint64_t GetFramesWritten() const { return framesWritten.load(std::memory_order_relaxed); }
+    uint64_t GetWriteCalls() const { return writeCalls.load(std::memory_order_relaxed); }
+    uint64_t GetStalls() const { return stalls.load(std::memory_order_relaxed); }
+    uint64_t GetErrors() const { return errors.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    // writer thread only, move queued blocks to coalesce buffer, \return false if nothing queued
+    bool drain();
+    void writeCoalesced();
+
+    struct Pending {
+        float* block;
+        int frames;
+    };
+
+    int channels;
+    int blockSize;
+    int coalesceFrames;
+    std::vector<std::vector<float>> storage;
+    SpscRingBuffer<float*> freeBlocks; // writer -> stretcher
+    SpscRingBuffer<Pending> pending; // stretcher -> writer
+    std::vector<float> coalesce;
+    size_t coalesced = 0; // frames in coalesce buffer
+    SNDFILE* file = nullptr;
+    std::thread thread;
+    std::atomic<bool> quit{ false };
+    // writer writes partial coalesce buffer and clears it, Flush() waits for that
+    std::atomic<bool> flushRequested{ false };
+    Semaphore pendingSignal;
+    Semaphore freeSignal;
+    Semaphore flushedSignal;
+    int signalTimeoutMs = 100;
+
+    std::atomic<uint64_t> framesWritten{ 0 };
+    std::atomic<uint64_t> writeCalls{ 0 };
+    std::atomic<uint64_t> stalls{ 0 };
+    std::atomic<uint64_t> errors{ 0 };
+};
+
+} // namespace PitchShifting
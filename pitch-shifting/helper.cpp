@@ -84,6 +84,14 @@ void print_usage(bool fullHelp, bool isR3, std::string myName) {
     cerr << "  always produces better results than the R2 engine, but with significantly" << endl;
     cerr << "  higher CPU load." << endl;
     cerr << endl;
+    cerr << "         --psola          Use the TD-PSOLA engine instead of rubberband" << endl;
+    cerr << endl;
+    cerr << "  Pitch synchronous overlap-add for monophonic voice, latency about one period" << endl;
+    cerr << "  of the lowest tracked pitch and a fraction of R3 CPU load. Formants are kept" << endl;
+    cerr << "  as they are unless --formant is given. Not for polyphonic music." << endl;
+    cerr << endl;
+    cerr << "         --psola-min-f0 <F> Lowest pitch tracked by TD-PSOLA in Hz (default 120)" << endl;
+    cerr << endl;
     cerr << "  -F,    --formant        Enable formant preservation when pitch shifting" << endl;
     cerr << endl;
     cerr << "  This option attempts to keep the formant envelope unchanged when changing" << endl;
@@ -143,6 +151,69 @@ void print_usage(bool fullHelp, bool isR3, std::string myName) {
     }
     cerr << "The following options are for output control and administration:" << endl;
     cerr << endl;
+    cerr << "  Input or output can be \"virtual:<S>\" for a headless device without sound card," << endl;
+    cerr << "  input S is null, sine, sine:<hz>, noise or a wav file, output S is null, mem" << endl;
+    cerr << "  or a wav file, both are clocked like an audio device stream." << endl;
+    cerr << endl;
+    cerr << "         --virtual-rate <R> Virtual device clock, 1 is realtime, 0 as fast as possible" << endl;
+    cerr << "         --virtual-jitter <J> Random callback jitter in milliseconds" << endl;
+    cerr << "         --virtual-seconds <S> Synthetic input duration, 0 for infinite (default 10)" << endl;
+    cerr << "         --trace <F>      Record process stages and audio callbacks to chrome trace" << endl;
+    cerr << "                          json file F, open with chrome://tracing or ui.perfetto.dev" << endl;
+    cerr << "         --jobs <N>       Render file to file in N parallel segments, or --batch files" << endl;
+    cerr << "                          on N threads, 0 for all cores" << endl;
+    cerr << "         --segment-seconds <S> Segment length for --jobs (default 30)" << endl;
+    cerr << "         --segment-overlap <S> Overlap each side of segment boundary (default 1)" << endl;
+    cerr << "         --split-silence  Move segment boundaries to the quietest point nearby" << endl;
+    cerr << "         --batch <P>      Process every audio file in directory P, or jobs of manifest" << endl;
+    cerr << "                          file P per line: <in> <out> [pitch [formant [ratio]]]," << endl;
+    cerr << "                          on --jobs threads, input and output arguments are ignored" << endl;
+    cerr << "         --batch-out <D>  Output directory of batch directory, default name.out.ext" << endl;
+    cerr << "         --read-ahead <N> Input file blocks decoded ahead on reader thread, 0 to" << endl;
+    cerr << "                          read on stretcher thread (default 8)" << endl;
+    cerr << "         --write-behind <N> Output file blocks queued for writer thread, 0 to" << endl;
+    cerr << "                          write on stretcher thread (default 16)" << endl;
+    cerr << "         --no-mmap        Read uncompressed wav input via sndfile instead of" << endl;
+    cerr << "                          memory mapped file" << endl;
+    cerr << "         --peak-cache <D> Cache directory of local file info and waveform peaks," << endl;
+    cerr << "                          \"\" to disable (default .peakcache)" << endl;
+    cerr << "         --scan-dir <D>   Directory of local audio files for GUI list (default .)" << endl;
+    cerr << "         --scan-recursive Also scan sub directories, hidden ones are skipped" << endl;
+    cerr << "         --scan-ext <L>   Comma separated extensions of local audio files," << endl;
+    cerr << "                          eg. \"wav,flac\", default any file sndfile can read" << endl;
+    cerr << "         --output-rate <R> Sample rate of output file or device, converted from input" << endl;
+    cerr << "                          rate, default follows input file or device default rate" << endl;
+    cerr << "         --resample-quality <Q> Sample rate conversion of fast, medium or best" << endl;
+    cerr << "                          (default medium)" << endl;
+    cerr << "         --low-latency    Device streams with small callbacks and rings, implies" << endl;
+    cerr << "                          --realtime, --callback-frames 256 --ring-blocks 4" << endl;
+    cerr << "         --callback-frames <N> Frames per device callback and process block" << endl;
+    cerr << "                          (default 1024)" << endl;
+    cerr << "         --ring-blocks <N> Device ring buffers hold N blocks, excess input is dropped" << endl;
+    cerr << "         --preroll <N>    Output silence until N frames are buffered, default sized" << endl;
+    cerr << "                          from rubberband latency (2000 without --low-latency)" << endl;
+    cerr << "         --measure-latency Inject an impulse into input every 2 seconds (input is" << endl;
+    cerr << "                          muted around it) and report its input to output delay" << endl;
+    cerr << "         --pitch-track    Track f0 of input and output, printed with buffer stats" << endl;
+    cerr << "         --autotune <S>   Correct pitch to scale S of chromatic, major, minor, harmonic," << endl;
+    cerr << "                          pentatonic, minor-pentatonic, blues or semitones eg. \"0,2,4,7,9\"," << endl;
+    cerr << "                          implies --realtime" << endl;
+    cerr << "         --autotune-key <K> Key of the scale, note name eg. C, F#, Bb (default C)" << endl;
+    cerr << "         --retune-speed <M> Milliseconds to move to the target note, 0 snaps instantly" << endl;
+    cerr << "                          (default 50)" << endl;
+    cerr << "         --envelope-csv <F> Export spectral envelope of input to csv file F, a row of" << endl;
+    cerr << "                          time and dB per fft bin for each frame" << endl;
+    cerr << "         --envelope-cutoff <M> Cepstral lifter cutoff in milliseconds, lower is smoother" << endl;
+    cerr << "                          (default 1.5)" << endl;
+    cerr << "         --envelope-rate <N> Envelope frames per second (default 50)" << endl;
+    cerr << "         --analyze <F>    Analyze f0 and formants of input file on --jobs threads and" << endl;
+    cerr << "                          write frequency map F for --freqmap instead of rendering" << endl;
+    cerr << "         --analyze-target <H> Median f0 of map moves to H Hz (default keeps median)" << endl;
+    cerr << "         --analyze-range <R> Pitch contour scale around median, 1 keeps prosody at" << endl;
+    cerr << "                          the new key, 0 flattens pitch to the target (default 1)" << endl;
+    cerr << "         --channel-map <S> Route output channels, comma separated per output" << endl;
+    cerr << "                          channel of input channel n, n+m for average or - for" << endl;
+    cerr << "                          silence, eg. \"0,0\" mono to stereo, \"0+1\" downmix" << endl;
     cerr << "  -q,    --quiet          Suppress progress output" << endl;
     cerr << "  -V,    --version        Show version number and exit" << endl;
     cerr << "  -h,    --help           Show the normal help output" << endl;
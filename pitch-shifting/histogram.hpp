@@ -0,0 +1,74 @@
+#pragma once
+/*
+ * log2 buckets histogram for timing measurement in microseconds,
+ * only written by one thread (stretcher thread), printed through debug output
+ */
+#include <cstdint>
+#include <ostream>
+
+namespace PitchShifting {
+
+class LatencyHistogram {
+public:
+    // bucket n counts [2^(n-1), 2^n) us, the first bucket is < 1us, the last bucket is >= 2^(Buckets-2) us
+    static const int Buckets = 24;
+
+    LatencyHistogram() { Reset(); }
+
+    void Reset() {
+        for (int i = 0; i < Buckets; i++) counts[i] = 0;
+        total = 0;
+        sum = 0.0;
+        maximum = 0.0;
+    }
+
+    void Add(double usec) {
+        int b = 0;
+        uint64_t v = usec < 0.0 ? 0 : (uint64_t)usec;
+        while (v > 0 && b < Buckets - 1) {
+            v >>= 1;
+            b++;
+        }
+        counts[b]++;
+        total++;
+        sum += usec;
+        if (usec > maximum) maximum = usec;
+    }
+
+    uint64_t Count() const { return total; }
+    double Mean() const { return total ? sum / total : 0.0; }
+    double Max() const { return maximum; }
+
+    /* upper bound of the bucket which reaches given percentile (0-100) */
+    double Percentile(double p) const {
+        if (total == 0) return 0.0;
+        uint64_t target = (uint64_t)(total * p / 100.0);
+        uint64_t acc = 0;
+        for (int b = 0; b < Buckets; b++) {
+            acc += counts[b];
+            if (acc > target) return (double)((uint64_t)1 << b);
+        }
+        return maximum;
+    }
+
+    /* one line summary, eg. `wait n:100 mean:12.3us p50<16us p99<512us max:300.0us |0 0 3 ...|` */
+    void Print(std::ostream& os, const char* label) const {
+        os << label << " n:" << total << " mean:" << Mean() << "us p50<" << Percentile(50) << "us p99<" << Percentile(99)
+            << "us max:" << maximum << "us |";
+        // skip trailing empty buckets for readability
+        int last = Buckets - 1;
+        while (last > 0 && counts[last] == 0) last--;
+        for (int b = 0; b <= last; b++) {
+            os << counts[b] << (b < last ? " " : "");
+        }
+        os << "|";
+    }
+
+private:
+    uint64_t counts[Buckets];
+    uint64_t total;
+    double sum;
+    double maximum;
+};
+
+} // namespace PitchShifting
@@ -0,0 +1,837 @@
+#include "kernels.hpp"
+#include <cmath>
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__AVX2__)
+#define PS_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PS_SIMD_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PS_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+namespace PitchShifting {
+
+const char* SimdKernelName() {
+#if defined(PS_SIMD_AVX2)
+    return "avx2";
+#elif defined(PS_SIMD_SSE2)
+    return "sse2";
+#elif defined(PS_SIMD_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+/* scalar helpers, also used for the tail of vectorized loops */
+static inline float clampUnit(float v) {
+    return v > 1.f ? 1.f : (v < -1.f ? -1.f : v);
+}
+
+#if defined(PS_SIMD_AVX2)
+static inline __m256 absPs(__m256 v) {
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.f), v);
+}
+static inline float hmaxPs(__m256 v) {
+    __m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+    return _mm_cvtss_f32(m);
+}
+#elif defined(PS_SIMD_SSE2)
+static inline __m128 absPs(__m128 v) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.f), v);
+}
+static inline float hmaxPs(__m128 m) {
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+    return _mm_cvtss_f32(m);
+}
+#elif defined(PS_SIMD_NEON)
+static inline float hmaxPs(float32x4_t v) {
+    float32x2_t m = vpmax_f32(vget_low_f32(v), vget_high_f32(v));
+    m = vpmax_f32(m, m);
+    return vget_lane_f32(m, 0);
+}
+#endif
+
+static float deinterleaveMono(const float* src, float* dst, int frames, float gain) {
+    int i = 0;
+    float peak = 0.f;
+#if defined(PS_SIMD_AVX2)
+    const __m256 g = _mm256_set1_ps(gain), hi = _mm256_set1_ps(1.f), lo = _mm256_set1_ps(-1.f);
+    __m256 p = _mm256_setzero_ps();
+    for (; i + 8 <= frames; i += 8) {
+        __m256 v = _mm256_loadu_ps(src + i);
+        p = _mm256_max_ps(p, absPs(v));
+        _mm256_storeu_ps(dst + i, _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(v, g), lo), hi));
+    }
+    peak = hmaxPs(p);
+#elif defined(PS_SIMD_SSE2)
+    const __m128 g = _mm_set1_ps(gain), hi = _mm_set1_ps(1.f), lo = _mm_set1_ps(-1.f);
+    __m128 p = _mm_setzero_ps();
+    for (; i + 4 <= frames; i += 4) {
+        __m128 v = _mm_loadu_ps(src + i);
+        p = _mm_max_ps(p, absPs(v));
+        _mm_storeu_ps(dst + i, _mm_min_ps(_mm_max_ps(_mm_mul_ps(v, g), lo), hi));
+    }
+    peak = hmaxPs(p);
+#elif defined(PS_SIMD_NEON)
+    const float32x4_t g = vdupq_n_f32(gain), hi = vdupq_n_f32(1.f), lo = vdupq_n_f32(-1.f);
+    float32x4_t p = vdupq_n_f32(0.f);
+    for (; i + 4 <= frames; i += 4) {
+        float32x4_t v = vld1q_f32(src + i);
+        p = vmaxq_f32(p, vabsq_f32(v));
+        vst1q_f32(dst + i, vminq_f32(vmaxq_f32(vmulq_f32(v, g), lo), hi));
+    }
+    peak = hmaxPs(p);
+#endif
+    for (; i < frames; ++i) {
+        float v = src[i];
+        peak = fmaxf(peak, fabsf(v));
+        dst[i] = clampUnit(v * gain);
+    }
+    return peak;
+}
+
+static float deinterleaveStereo(const float* src, float* dstL, float* dstR, int frames, float gain) {
+    int i = 0;
+    float peak = 0.f;
+#if defined(PS_SIMD_AVX2)
+    const __m256 g = _mm256_set1_ps(gain), hi = _mm256_set1_ps(1.f), lo = _mm256_set1_ps(-1.f);
+    __m256 p = _mm256_setzero_ps();
+    for (; i + 8 <= frames; i += 8) {
+        __m256 a = _mm256_loadu_ps(src + i * 2);     // L0 R0 L1 R1 | L2 R2 L3 R3
+        __m256 b = _mm256_loadu_ps(src + i * 2 + 8); // L4 R4 L5 R5 | L6 R6 L7 R7
+        p = _mm256_max_ps(p, _mm256_max_ps(absPs(a), absPs(b)));
+        // in-lane shuffle gives L0 L1 L4 L5 | L2 L3 L6 L7, then fix the 64-bit lane order
+        __m256 l = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 r = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        l = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(l), _MM_SHUFFLE(3, 1, 2, 0)));
+        r = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(r), _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm256_storeu_ps(dstL + i, _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(l, g), lo), hi));
+        _mm256_storeu_ps(dstR + i, _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(r, g), lo), hi));
+    }
+    peak = hmaxPs(p);
+#elif defined(PS_SIMD_SSE2)
+    const __m128 g = _mm_set1_ps(gain), hi = _mm_set1_ps(1.f), lo = _mm_set1_ps(-1.f);
+    __m128 p = _mm_setzero_ps();
+    for (; i + 4 <= frames; i += 4) {
+        __m128 a = _mm_loadu_ps(src + i * 2);     // L0 R0 L1 R1
+        __m128 b = _mm_loadu_ps(src + i * 2 + 4); // L2 R2 L3 R3
+        p = _mm_max_ps(p, _mm_max_ps(absPs(a), absPs(b)));
+        __m128 l = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 r = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(dstL + i, _mm_min_ps(_mm_max_ps(_mm_mul_ps(l, g), lo), hi));
+        _mm_storeu_ps(dstR + i, _mm_min_ps(_mm_max_ps(_mm_mul_ps(r, g), lo), hi));
+    }
+    peak = hmaxPs(p);
+#elif defined(PS_SIMD_NEON)
+    const float32x4_t g = vdupq_n_f32(gain), hi = vdupq_n_f32(1.f), lo = vdupq_n_f32(-1.f);
+    float32x4_t p = vdupq_n_f32(0.f);
+    for (; i + 4 <= frames; i += 4) {
+        float32x4x2_t v = vld2q_f32(src + i * 2); // deinterleave by load
+        p = vmaxq_f32(p, vmaxq_f32(vabsq_f32(v.val[0]), vabsq_f32(v.val[1])));
+        vst1q_f32(dstL + i, vminq_f32(vmaxq_f32(vmulq_f32(v.val[0], g), lo), hi));
+        vst1q_f32(dstR + i, vminq_f32(vmaxq_f32(vmulq_f32(v.val[1], g), lo), hi));
+    }
+    peak = hmaxPs(p);
+#endif
+    for (; i < frames; ++i) {
+        float l = src[i * 2];
+        float r = src[i * 2 + 1];
+        peak = fmaxf(peak, fmaxf(fabsf(l), fabsf(r)));
+        dstL[i] = clampUnit(l * gain);
+        dstR[i] = clampUnit(r * gain);
+    }
+    return peak;
+}
+
+static float deinterleaveChannels(const float* src, float* const* dst, int channels, int frames, float gain) {
+    // walk source memory sequentially, branchless min/max lets compiler vectorize the channel loop
+    float peak = 0.f;
+    for (int i = 0; i < frames; ++i) {
+        const float* frame = src + (size_t)i * channels;
+        for (int c = 0; c < channels; ++c) {
+            float v = frame[c];
+            peak = fmaxf(peak, fabsf(v));
+            dst[c][i] = fminf(fmaxf(v * gain, -1.f), 1.f);
+        }
+    }
+    return peak;
+}
+
+float DeinterleaveGainClamp(const float* src, float* const* dst, int channels, int frames, float gain) {
+    if (frames <= 0 || channels <= 0) return 0.f;
+    switch (channels) {
+    case 1:
+        return deinterleaveMono(src, dst[0], frames, gain);
+    case 2:
+        return deinterleaveStereo(src, dst[0], dst[1], frames, gain);
+    default:
+        return deinterleaveChannels(src, dst, channels, frames, gain);
+    }
+}
+
+ChannelMap ChannelMap::Default(int inChannels, int outChannels) {
+    ChannelMap map;
+    map.inChannels = inChannels;
+    map.outChannels = outChannels;
+    map.weights.assign((size_t)inChannels * outChannels, 0.f);
+    if (inChannels <= 0 || outChannels <= 0) return map;
+    if (inChannels == 2 && outChannels == 1) {
+        map.weights[0] = map.weights[1] = 0.5f;
+        return map;
+    }
+    for (int o = 0; o < outChannels; ++o) {
+        // rest of channels if output has more than input
+        int i = (o < inChannels) ? o : 0;
+        map.weights[(size_t)o * inChannels + i] = 1.f;
+    }
+    return map;
+}
+
+bool ChannelMap::Parse(const std::string& spec, int inChannels, int outChannels, ChannelMap* map) {
+    *map = Default(inChannels, outChannels);
+    if (spec.empty()) return true;
+
+    std::vector<float> weights((size_t)inChannels * outChannels, 0.f);
+    int o = 0;
+    size_t pos = 0;
+    while (pos <= spec.size()) {
+        size_t end = spec.find(',', pos);
+        if (end == std::string::npos) end = spec.size();
+        std::string entry = spec.substr(pos, end - pos);
+        if (o >= outChannels) return false; // more entries than output channels
+        if (entry != "-") {
+            // n or n+m+...
+            std::vector<int> sources;
+            size_t p = 0;
+            while (p <= entry.size()) {
+                size_t plus = entry.find('+', p);
+                if (plus == std::string::npos) plus = entry.size();
+                std::string num = entry.substr(p, plus - p);
+                char* tail = nullptr;
+                long n = strtol(num.c_str(), &tail, 10);
+                if (num.empty() || *tail != '\0' || n < 0 || n >= inChannels) return false;
+                sources.push_back((int)n);
+                p = plus + 1;
+            }
+            for (int i : sources) {
+                weights[(size_t)o * inChannels + i] += 1.f / sources.size();
+            }
+        }
+        ++o;
+        pos = end + 1;
+    }
+    if (o != outChannels) return false; // must describe every output channel
+    map->weights = weights;
+    return true;
+}
+
+int ChannelMap::Source(int out) const {
+    int source = -1;
+    for (int i = 0; i < inChannels; ++i) {
+        float w = weights[(size_t)out * inChannels + i];
+        if (w == 0.f) continue;
+        if (w != 1.f || source != -1) return -2;
+        source = i;
+    }
+    return source;
+}
+
+static float interleaveMono(const float* src, float* dst, int frames, float gain, float lo, float hi) {
+    int i = 0;
+    float peak = 0.f;
+#if defined(PS_SIMD_AVX2)
+    const __m256 g = _mm256_set1_ps(gain), vhi = _mm256_set1_ps(hi), vlo = _mm256_set1_ps(lo);
+    __m256 p = _mm256_setzero_ps();
+    for (; i + 8 <= frames; i += 8) {
+        __m256 v = _mm256_loadu_ps(src + i);
+        p = _mm256_max_ps(p, absPs(v));
+        _mm256_storeu_ps(dst + i, _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(v, g), vlo), vhi));
+    }
+    peak = hmaxPs(p);
+#elif defined(PS_SIMD_SSE2)
+    const __m128 g = _mm_set1_ps(gain), vhi = _mm_set1_ps(hi), vlo = _mm_set1_ps(lo);
+    __m128 p = _mm_setzero_ps();
+    for (; i + 4 <= frames; i += 4) {
+        __m128 v = _mm_loadu_ps(src + i);
+        p = _mm_max_ps(p, absPs(v));
+        _mm_storeu_ps(dst + i, _mm_min_ps(_mm_max_ps(_mm_mul_ps(v, g), vlo), vhi));
+    }
+    peak = hmaxPs(p);
+#elif defined(PS_SIMD_NEON)
+    const float32x4_t g = vdupq_n_f32(gain), vhi = vdupq_n_f32(hi), vlo = vdupq_n_f32(lo);
+    float32x4_t p = vdupq_n_f32(0.f);
+    for (; i + 4 <= frames; i += 4) {
+        float32x4_t v = vld1q_f32(src + i);
+        p = vmaxq_f32(p, vabsq_f32(v));
+        vst1q_f32(dst + i, vminq_f32(vmaxq_f32(vmulq_f32(v, g), vlo), vhi));
+    }
+    peak = hmaxPs(p);
+#endif
+    for (; i < frames; ++i) {
+        float v = src[i];
+        peak = fmaxf(peak, fabsf(v));
+        dst[i] = fminf(fmaxf(v * gain, lo), hi);
+    }
+    return peak;
+}
+
+/* stereo output from 2 sources, srcL == srcR for mono to stereo */
+static float interleavePair(const float* srcL, const float* srcR, float* dst, int frames, float gain, float lo, float hi) {
+    int i = 0;
+    float peak = 0.f;
+#if defined(PS_SIMD_AVX2)
+    const __m256 g = _mm256_set1_ps(gain), vhi = _mm256_set1_ps(hi), vlo = _mm256_set1_ps(lo);
+    __m256 p = _mm256_setzero_ps();
+    for (; i + 8 <= frames; i += 8) {
+        __m256 l = _mm256_loadu_ps(srcL + i);
+        __m256 r = _mm256_loadu_ps(srcR + i);
+        p = _mm256_max_ps(p, _mm256_max_ps(absPs(l), absPs(r)));
+        l = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(l, g), vlo), vhi);
+        r = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(r, g), vlo), vhi);
+        // unpack gives L0 R0 L1 R1 | L4 R4 L5 R5 and L2 R2 L3 R3 | L6 R6 L7 R7, then swap 128-bit lanes
+        __m256 a = _mm256_unpacklo_ps(l, r);
+        __m256 b = _mm256_unpackhi_ps(l, r);
+        _mm256_storeu_ps(dst + i * 2, _mm256_permute2f128_ps(a, b, 0x20));
+        _mm256_storeu_ps(dst + i * 2 + 8, _mm256_permute2f128_ps(a, b, 0x31));
+    }
+    peak = hmaxPs(p);
+#elif defined(PS_SIMD_SSE2)
+    const __m128 g = _mm_set1_ps(gain), vhi = _mm_set1_ps(hi), vlo = _mm_set1_ps(lo);
+    __m128 p = _mm_setzero_ps();
+    for (; i + 4 <= frames; i += 4) {
+        __m128 l = _mm_loadu_ps(srcL + i);
+        __m128 r = _mm_loadu_ps(srcR + i);
+        p = _mm_max_ps(p, _mm_max_ps(absPs(l), absPs(r)));
+        l = _mm_min_ps(_mm_max_ps(_mm_mul_ps(l, g), vlo), vhi);
+        r = _mm_min_ps(_mm_max_ps(_mm_mul_ps(r, g), vlo), vhi);
+        _mm_storeu_ps(dst + i * 2, _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps(dst + i * 2 + 4, _mm_unpackhi_ps(l, r));
+    }
+    peak = hmaxPs(p);
+#elif defined(PS_SIMD_NEON)
+    const float32x4_t g = vdupq_n_f32(gain), vhi = vdupq_n_f32(hi), vlo = vdupq_n_f32(lo);
+    float32x4_t p = vdupq_n_f32(0.f);
+    for (; i + 4 <= frames; i += 4) {
+        float32x4x2_t v;
+        v.val[0] = vld1q_f32(srcL + i);
+        v.val[1] = vld1q_f32(srcR + i);
+        p = vmaxq_f32(p, vmaxq_f32(vabsq_f32(v.val[0]), vabsq_f32(v.val[1])));
+        v.val[0] = vminq_f32(vmaxq_f32(vmulq_f32(v.val[0], g), vlo), vhi);
+        v.val[1] = vminq_f32(vmaxq_f32(vmulq_f32(v.val[1], g), vlo), vhi);
+        vst2q_f32(dst + i * 2, v); // interleave by store
+    }
+    peak = hmaxPs(p);
+#endif
+    for (; i < frames; ++i) {
+        float l = srcL[i];
+        float r = srcR[i];
+        peak = fmaxf(peak, fmaxf(fabsf(l), fabsf(r)));
+        dst[i * 2] = fminf(fmaxf(l * gain, lo), hi);
+        dst[i * 2 + 1] = fminf(fmaxf(r * gain, lo), hi);
+    }
+    return peak;
+}
+
+/* mono output from average of 2 sources */
+static float interleaveDownmix(const float* srcL, const float* srcR, float* dst, int frames, float gain, float lo, float hi) {
+    int i = 0;
+    float peak = 0.f;
+#if defined(PS_SIMD_AVX2)
+    const __m256 g = _mm256_set1_ps(gain), half = _mm256_set1_ps(0.5f), vhi = _mm256_set1_ps(hi), vlo = _mm256_set1_ps(lo);
+    __m256 p = _mm256_setzero_ps();
+    for (; i + 8 <= frames; i += 8) {
+        __m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(srcL + i), _mm256_loadu_ps(srcR + i)), half);
+        p = _mm256_max_ps(p, absPs(v));
+        _mm256_storeu_ps(dst + i, _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(v, g), vlo), vhi));
+    }
+    peak = hmaxPs(p);
+#elif defined(PS_SIMD_SSE2)
+    const __m128 g = _mm_set1_ps(gain), half = _mm_set1_ps(0.5f), vhi = _mm_set1_ps(hi), vlo = _mm_set1_ps(lo);
+    __m128 p = _mm_setzero_ps();
+    for (; i + 4 <= frames; i += 4) {
+        __m128 v = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(srcL + i), _mm_loadu_ps(srcR + i)), half);
+        p = _mm_max_ps(p, absPs(v));
+        _mm_storeu_ps(dst + i, _mm_min_ps(_mm_max_ps(_mm_mul_ps(v, g), vlo), vhi));
+    }
+    peak = hmaxPs(p);
+#elif defined(PS_SIMD_NEON)
+    const float32x4_t g = vdupq_n_f32(gain), half = vdupq_n_f32(0.5f), vhi = vdupq_n_f32(hi), vlo = vdupq_n_f32(lo);
+    float32x4_t p = vdupq_n_f32(0.f);
+    for (; i + 4 <= frames; i += 4) {
+        float32x4_t v = vmulq_f32(vaddq_f32(vld1q_f32(srcL + i), vld1q_f32(srcR + i)), half);
+        p = vmaxq_f32(p, vabsq_f32(v));
+        vst1q_f32(dst + i, vminq_f32(vmaxq_f32(vmulq_f32(v, g), vlo), vhi));
+    }
+    peak = hmaxPs(p);
+#endif
+    for (; i < frames; ++i) {
+        float v = (srcL[i] + srcR[i]) * 0.5f;
+        peak = fmaxf(peak, fabsf(v));
+        dst[i] = fminf(fmaxf(v * gain, lo), hi);
+    }
+    return peak;
+}
+
+/* arbitrary map, weighted sum per output channel, written frame by frame to keep dst sequential */
+static float interleaveWeighted(const float* const* src, float* dst, const ChannelMap& map, int frames, float gain, float lo, float hi) {
+    float peak = 0.f;
+    const int ins = map.inChannels;
+    const int outs = map.outChannels;
+    const float* w = map.weights.data();
+    for (int i = 0; i < frames; ++i) {
+        float* frame = dst + (size_t)i * outs;
+        for (int o = 0; o < outs; ++o) {
+            float v = 0.f;
+            for (int c = 0; c < ins; ++c) {
+                v += w[o * ins + c] * src[c][i];
+            }
+            peak = fmaxf(peak, fabsf(v));
+            frame[o] = fminf(fmaxf(v * gain, lo), hi);
+        }
+    }
+    return peak;
+}
+
+float InterleaveChannelMap(const float* const* src, float* dst, const ChannelMap& map, int frames, float gain, bool clamp) {
+    if (frames <= 0 || map.outChannels <= 0 || map.inChannels <= 0) return 0.f;
+    // unbounded limits if caller wants to detect clipping by itself
+    const float lo = clamp ? -1.f : -FLT_MAX;
+    const float hi = clamp ? 1.f : FLT_MAX;
+
+    if (map.outChannels == 1) {
+        int s = map.Source(0);
+        if (s >= 0) {
+            return interleaveMono(src[s], dst, frames, gain, lo, hi);
+        }
+        if (map.inChannels == 2 && map.weights[0] == 0.5f && map.weights[1] == 0.5f) {
+            return interleaveDownmix(src[0], src[1], dst, frames, gain, lo, hi);
+        }
+    }
+    else if (map.outChannels == 2) {
+        int l = map.Source(0);
+        int r = map.Source(1);
+        if (l >= 0 && r >= 0) {
+            return interleavePair(src[l], src[r], dst, frames, gain, lo, hi);
+        }
+    }
+    return interleaveWeighted(src, dst, map, frames, gain, lo, hi);
+}
+
+void ConvertPcm16(const int16_t* src, float* dst, size_t samples) {
+    const float scale = 1.f / 32768.f;
+    size_t i = 0;
+#if defined(PS_SIMD_AVX2)
+    const __m256 s = _mm256_set1_ps(scale);
+    for (; i + 8 <= samples; i += 8) {
+        __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), s));
+    }
+#elif defined(PS_SIMD_SSE2)
+    const __m128 s = _mm_set1_ps(scale);
+    for (; i + 8 <= samples; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        // sign extend by placing int16 at high half then arithmetic shift
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), s));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), s));
+    }
+#elif defined(PS_SIMD_NEON)
+    for (; i + 8 <= samples; i += 8) {
+        int16x8_t v = vld1q_s16(src + i);
+        vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+    }
+#endif
+    for (; i < samples; ++i) {
+        dst[i] = src[i] * scale;
+    }
+}
+
+void ConvertPcm24(const uint8_t* src, float* dst, size_t samples) {
+    const float scale = 1.f / 8388608.f;
+    for (size_t i = 0; i < samples; ++i, src += 3) {
+        // little endian 24 bits to the top of int32, arithmetic shift back for sign
+        int32_t v = (int32_t)(((uint32_t)src[0] << 8) | ((uint32_t)src[1] << 16) | ((uint32_t)src[2] << 24)) >> 8;
+        dst[i] = v * scale;
+    }
+}
+
+float DeinterleavePcm16GainClamp(const int16_t* src, float* const* dst, int channels, int frames, float gain) {
+    if (frames <= 0 || channels <= 0) return 0.f;
+    const float scale = 1.f / 32768.f;
+    int i = 0;
+    float peak = 0.f;
+    // peak of int16 is taken on the converted value, gain is applied on top of the scale
+#if defined(PS_SIMD_AVX2)
+    const __m256 s = _mm256_set1_ps(scale), g = _mm256_set1_ps(gain), hi = _mm256_set1_ps(1.f), lo = _mm256_set1_ps(-1.f);
+    __m256 p = _mm256_setzero_ps();
+    if (channels == 1) {
+        for (; i + 8 <= frames; i += 8) {
+            __m256 v = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + i)))), s);
+            p = _mm256_max_ps(p, absPs(v));
+            _mm256_storeu_ps(dst[0] + i, _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(v, g), lo), hi));
+        }
+    } else if (channels == 2) {
+        for (; i + 8 <= frames; i += 8) {
+            __m256 a = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + i * 2)))), s);
+            __m256 b = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + i * 2 + 8)))), s);
+            p = _mm256_max_ps(p, _mm256_max_ps(absPs(a), absPs(b)));
+            // the same shuffle as deinterleaveStereo()
+            __m256 l = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            __m256 r = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+            l = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(l), _MM_SHUFFLE(3, 1, 2, 0)));
+            r = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(r), _MM_SHUFFLE(3, 1, 2, 0)));
+            _mm256_storeu_ps(dst[0] + i, _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(l, g), lo), hi));
+            _mm256_storeu_ps(dst[1] + i, _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(r, g), lo), hi));
+        }
+    }
+    peak = hmaxPs(p);
+#elif defined(PS_SIMD_SSE2)
+    const __m128 s = _mm_set1_ps(scale), g = _mm_set1_ps(gain), hi = _mm_set1_ps(1.f), lo = _mm_set1_ps(-1.f);
+    __m128 p = _mm_setzero_ps();
+    if (channels == 1) {
+        for (; i + 8 <= frames; i += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+            __m128 a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)), s);
+            __m128 b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16)), s);
+            p = _mm_max_ps(p, _mm_max_ps(absPs(a), absPs(b)));
+            _mm_storeu_ps(dst[0] + i, _mm_min_ps(_mm_max_ps(_mm_mul_ps(a, g), lo), hi));
+            _mm_storeu_ps(dst[0] + i + 4, _mm_min_ps(_mm_max_ps(_mm_mul_ps(b, g), lo), hi));
+        }
+    } else if (channels == 2) {
+        for (; i + 4 <= frames; i += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + i * 2)); // L0 R0 L1 R1 L2 R2 L3 R3
+            __m128 a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)), s);
+            __m128 b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16)), s);
+            p = _mm_max_ps(p, _mm_max_ps(absPs(a), absPs(b)));
+            __m128 l = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 r = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+            _mm_storeu_ps(dst[0] + i, _mm_min_ps(_mm_max_ps(_mm_mul_ps(l, g), lo), hi));
+            _mm_storeu_ps(dst[1] + i, _mm_min_ps(_mm_max_ps(_mm_mul_ps(r, g), lo), hi));
+        }
+    }
+    peak = hmaxPs(p);
+#elif defined(PS_SIMD_NEON)
+    const float32x4_t g = vdupq_n_f32(gain), hi = vdupq_n_f32(1.f), lo = vdupq_n_f32(-1.f);
+    float32x4_t p = vdupq_n_f32(0.f);
+    if (channels == 1) {
+        for (; i + 8 <= frames; i += 8) {
+            int16x8_t v = vld1q_s16(src + i);
+            float32x4_t a = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale);
+            float32x4_t b = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale);
+            p = vmaxq_f32(p, vmaxq_f32(vabsq_f32(a), vabsq_f32(b)));
+            vst1q_f32(dst[0] + i, vminq_f32(vmaxq_f32(vmulq_f32(a, g), lo), hi));
+            vst1q_f32(dst[0] + i + 4, vminq_f32(vmaxq_f32(vmulq_f32(b, g), lo), hi));
+        }
+    } else if (channels == 2) {
+        for (; i + 4 <= frames; i += 4) {
+            int16x4x2_t v = vld2_s16(src + i * 2); // deinterleave by load
+            float32x4_t l = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(v.val[0])), scale);
+            float32x4_t r = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(v.val[1])), scale);
+            p = vmaxq_f32(p, vmaxq_f32(vabsq_f32(l), vabsq_f32(r)));
+            vst1q_f32(dst[0] + i, vminq_f32(vmaxq_f32(vmulq_f32(l, g), lo), hi));
+            vst1q_f32(dst[1] + i, vminq_f32(vmaxq_f32(vmulq_f32(r, g), lo), hi));
+        }
+    }
+    peak = hmaxPs(p);
+#endif
+    for (; i < frames; ++i) {
+        const int16_t* frame = src + (size_t)i * channels;
+        for (int c = 0; c < channels; ++c) {
+            float v = frame[c] * scale;
+            peak = fmaxf(peak, fabsf(v));
+            dst[c][i] = clampUnit(v * gain);
+        }
+    }
+    return peak;
+}
+
+float DeinterleavePcm24GainClamp(const uint8_t* src, float* const* dst, int channels, int frames, float gain) {
+    if (frames <= 0 || channels <= 0) return 0.f;
+    const float scale = 1.f / 8388608.f;
+    float peak = 0.f;
+    for (int i = 0; i < frames; ++i) {
+        for (int c = 0; c < channels; ++c, src += 3) {
+            int32_t s = (int32_t)(((uint32_t)src[0] << 8) | ((uint32_t)src[1] << 16) | ((uint32_t)src[2] << 24)) >> 8;
+            float v = s * scale;
+            peak = fmaxf(peak, fabsf(v));
+            dst[c][i] = clampUnit(v * gain);
+        }
+    }
+    return peak;
+}
+
+void InterleavedMinMax(const float* src, int channels, size_t frames, float* minimum, float* maximum) {
+    for (int c = 0; c < channels; ++c) {
+        minimum[c] = FLT_MAX;
+        maximum[c] = -FLT_MAX;
+    }
+    size_t samples = frames * channels;
+    size_t i = 0;
+    // lane n of a vector always holds channel n % channels if channels divides vector width
+#if defined(PS_SIMD_AVX2)
+    if (channels == 1 || channels == 2 || channels == 4 || channels == 8) {
+        __m256 lo = _mm256_set1_ps(FLT_MAX);
+        __m256 hi = _mm256_set1_ps(-FLT_MAX);
+        for (; i + 16 <= samples; i += 16) {
+            __m256 a = _mm256_loadu_ps(src + i);
+            __m256 b = _mm256_loadu_ps(src + i + 8);
+            lo = _mm256_min_ps(lo, _mm256_min_ps(a, b));
+            hi = _mm256_max_ps(hi, _mm256_max_ps(a, b));
+        }
+        alignas(32) float l[8], h[8];
+        _mm256_store_ps(l, lo);
+        _mm256_store_ps(h, hi);
+        for (int n = 0; n < 8; ++n) {
+            minimum[n % channels] = fminf(minimum[n % channels], l[n]);
+            maximum[n % channels] = fmaxf(maximum[n % channels], h[n]);
+        }
+    }
+#elif defined(PS_SIMD_SSE2)
+    if (channels == 1 || channels == 2 || channels == 4) {
+        __m128 lo = _mm_set1_ps(FLT_MAX);
+        __m128 hi = _mm_set1_ps(-FLT_MAX);
+        for (; i + 8 <= samples; i += 8) {
+            __m128 a = _mm_loadu_ps(src + i);
+            __m128 b = _mm_loadu_ps(src + i + 4);
+            lo = _mm_min_ps(lo, _mm_min_ps(a, b));
+            hi = _mm_max_ps(hi, _mm_max_ps(a, b));
+        }
+        alignas(16) float l[4], h[4];
+        _mm_store_ps(l, lo);
+        _mm_store_ps(h, hi);
+        for (int n = 0; n < 4; ++n) {
+            minimum[n % channels] = fminf(minimum[n % channels], l[n]);
+            maximum[n % channels] = fmaxf(maximum[n % channels], h[n]);
+        }
+    }
+#elif defined(PS_SIMD_NEON)
+    if (channels == 1 || channels == 2 || channels == 4) {
+        float32x4_t lo = vdupq_n_f32(FLT_MAX);
+        float32x4_t hi = vdupq_n_f32(-FLT_MAX);
+        for (; i + 8 <= samples; i += 8) {
+            float32x4_t a = vld1q_f32(src + i);
+            float32x4_t b = vld1q_f32(src + i + 4);
+            lo = vminq_f32(lo, vminq_f32(a, b));
+            hi = vmaxq_f32(hi, vmaxq_f32(a, b));
+        }
+        float l[4], h[4];
+        vst1q_f32(l, lo);
+        vst1q_f32(h, hi);
+        for (int n = 0; n < 4; ++n) {
+            minimum[n % channels] = fminf(minimum[n % channels], l[n]);
+            maximum[n % channels] = fmaxf(maximum[n % channels], h[n]);
+        }
+    }
+#endif
+    // vectorized part ends at a frame boundary
+    for (; i < samples; i += channels) {
+        for (int c = 0; c < channels; ++c) {
+            float v = src[i + c];
+            if (minimum[c] > v) minimum[c] = v;
+            if (maximum[c] < v) maximum[c] = v;
+        }
+    }
+}
+
+float DotProduct(const float* a, const float* b, int n) {
+    int i = 0;
+    float sum = 0.f;
+    // two accumulators hide latency of add, taps are usually multiple of 16
+#if defined(PS_SIMD_AVX2)
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    for (; i + 16 <= n; i += 16) {
+        s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+    }
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(s0), _mm256_extractf128_ps(s0, 1));
+    s = _mm_add_ps(s, _mm_add_ps(_mm256_castps256_ps128(s1), _mm256_extractf128_ps(s1, 1)));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    sum = _mm_cvtss_f32(s);
+#elif defined(PS_SIMD_SSE2)
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    __m128 s = _mm_add_ps(s0, s1);
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    sum = _mm_cvtss_f32(s);
+#elif defined(PS_SIMD_NEON)
+    float32x4_t s0 = vdupq_n_f32(0.f), s1 = vdupq_n_f32(0.f);
+    for (; i + 8 <= n; i += 8) {
+        s0 = vmlaq_f32(s0, vld1q_f32(a + i), vld1q_f32(b + i));
+        s1 = vmlaq_f32(s1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    float32x4_t s = vaddq_f32(s0, s1);
+    float32x2_t h = vadd_f32(vget_low_f32(s), vget_high_f32(s));
+    sum = vget_lane_f32(vpadd_f32(h, h), 0);
+#endif
+    for (; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// ln(x) = e * ln2 + 2 * atanh((m - 1) / (m + 1)) with mantissa m in [1, 2), series up to t^9
+static const float lnTwo = 0.693147181f;
+static const float logTwoE = 1.44269504f;
+static const float logC3 = 1.f / 3.f, logC5 = 1.f / 5.f, logC7 = 1.f / 7.f, logC9 = 1.f / 9.f;
+// 2^f = e^(f * ln2) for f in [-0.5, 0.5], taylor up to 6th order
+static const float expC2 = 1.f / 2.f, expC3 = 1.f / 6.f, expC4 = 1.f / 24.f, expC5 = 1.f / 120.f, expC6 = 1.f / 720.f;
+
+static inline float fastLogScalar(float x) {
+    if (!(x > FLT_MIN)) x = FLT_MIN;
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    float e = (float)((int)(bits >> 23) - 127);
+    bits = (bits & 0x007fffff) | 0x3f800000;
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+    float t = (m - 1.f) / (m + 1.f);
+    float t2 = t * t;
+    float poly = 1.f + t2 * (logC3 + t2 * (logC5 + t2 * (logC7 + t2 * logC9)));
+    return e * lnTwo + 2.f * t * poly;
+}
+
+static inline float fastExpScalar(float x) {
+    x = x > 88.f ? 88.f : (x < -87.f ? -87.f : x);
+    float y = x * logTwoE;
+    float n = floorf(y + 0.5f);
+    float r = (y - n) * lnTwo;
+    float p = 1.f + r * (1.f + r * (expC2 + r * (expC3 + r * (expC4 + r * (expC5 + r * expC6)))));
+    uint32_t bits = (uint32_t)((int)n + 127) << 23;
+    float scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+void FastLog(const float* src, float* dst, int n) {
+    int i = 0;
+#if defined(PS_SIMD_AVX2)
+    const __m256 minimum = _mm256_set1_ps(FLT_MIN), one = _mm256_set1_ps(1.f), ln2 = _mm256_set1_ps(lnTwo);
+    const __m256i mantissa = _mm256_set1_epi32(0x007fffff), exponentOne = _mm256_set1_epi32(0x3f800000), bias = _mm256_set1_epi32(127);
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_max_ps(_mm256_loadu_ps(src + i), minimum);
+        __m256i bits = _mm256_castps_si256(x);
+        __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), bias));
+        __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, mantissa), exponentOne));
+        __m256 t = _mm256_div_ps(_mm256_sub_ps(m, one), _mm256_add_ps(m, one));
+        __m256 t2 = _mm256_mul_ps(t, t);
+        __m256 poly = _mm256_add_ps(_mm256_set1_ps(logC7), _mm256_mul_ps(t2, _mm256_set1_ps(logC9)));
+        poly = _mm256_add_ps(_mm256_set1_ps(logC5), _mm256_mul_ps(t2, poly));
+        poly = _mm256_add_ps(_mm256_set1_ps(logC3), _mm256_mul_ps(t2, poly));
+        poly = _mm256_add_ps(one, _mm256_mul_ps(t2, poly));
+        __m256 r = _mm256_add_ps(_mm256_mul_ps(e, ln2), _mm256_mul_ps(_mm256_add_ps(t, t), poly));
+        _mm256_storeu_ps(dst + i, r);
+    }
+#elif defined(PS_SIMD_SSE2)
+    const __m128 minimum = _mm_set1_ps(FLT_MIN), one = _mm_set1_ps(1.f), ln2 = _mm_set1_ps(lnTwo);
+    const __m128i mantissa = _mm_set1_epi32(0x007fffff), exponentOne = _mm_set1_epi32(0x3f800000), bias = _mm_set1_epi32(127);
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_max_ps(_mm_loadu_ps(src + i), minimum);
+        __m128i bits = _mm_castps_si128(x);
+        __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), bias));
+        __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, mantissa), exponentOne));
+        __m128 t = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+        __m128 t2 = _mm_mul_ps(t, t);
+        __m128 poly = _mm_add_ps(_mm_set1_ps(logC7), _mm_mul_ps(t2, _mm_set1_ps(logC9)));
+        poly = _mm_add_ps(_mm_set1_ps(logC5), _mm_mul_ps(t2, poly));
+        poly = _mm_add_ps(_mm_set1_ps(logC3), _mm_mul_ps(t2, poly));
+        poly = _mm_add_ps(one, _mm_mul_ps(t2, poly));
+        __m128 r = _mm_add_ps(_mm_mul_ps(e, ln2), _mm_mul_ps(_mm_add_ps(t, t), poly));
+        _mm_storeu_ps(dst + i, r);
+    }
+#elif defined(PS_SIMD_NEON)
+    const float32x4_t minimum = vdupq_n_f32(FLT_MIN), one = vdupq_n_f32(1.f);
+    const uint32x4_t mantissa = vdupq_n_u32(0x007fffff), exponentOne = vdupq_n_u32(0x3f800000);
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t x = vmaxq_f32(vld1q_f32(src + i), minimum);
+        uint32x4_t bits = vreinterpretq_u32_f32(x);
+        float32x4_t e = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), vdupq_n_s32(127)));
+        float32x4_t m = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, mantissa), exponentOne));
+        float32x4_t t = vdivq_f32(vsubq_f32(m, one), vaddq_f32(m, one));
+        float32x4_t t2 = vmulq_f32(t, t);
+        float32x4_t poly = vmlaq_f32(vdupq_n_f32(logC7), t2, vdupq_n_f32(logC9));
+        poly = vmlaq_f32(vdupq_n_f32(logC5), t2, poly);
+        poly = vmlaq_f32(vdupq_n_f32(logC3), t2, poly);
+        poly = vmlaq_f32(one, t2, poly);
+        float32x4_t r = vmlaq_f32(vmulq_n_f32(e, lnTwo), vaddq_f32(t, t), poly);
+        vst1q_f32(dst + i, r);
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = fastLogScalar(src[i]);
+    }
+}
+
+void FastExp(const float* src, float* dst, int n) {
+    int i = 0;
+#if defined(PS_SIMD_AVX2)
+    const __m256 hi = _mm256_set1_ps(88.f), lo = _mm256_set1_ps(-87.f), one = _mm256_set1_ps(1.f);
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), lo), hi);
+        __m256 y = _mm256_mul_ps(x, _mm256_set1_ps(logTwoE));
+        __m256i k = _mm256_cvtps_epi32(y); // round to nearest
+        __m256 r = _mm256_mul_ps(_mm256_sub_ps(y, _mm256_cvtepi32_ps(k)), _mm256_set1_ps(lnTwo));
+        __m256 p = _mm256_add_ps(_mm256_set1_ps(expC5), _mm256_mul_ps(r, _mm256_set1_ps(expC6)));
+        p = _mm256_add_ps(_mm256_set1_ps(expC4), _mm256_mul_ps(r, p));
+        p = _mm256_add_ps(_mm256_set1_ps(expC3), _mm256_mul_ps(r, p));
+        p = _mm256_add_ps(_mm256_set1_ps(expC2), _mm256_mul_ps(r, p));
+        p = _mm256_add_ps(one, _mm256_mul_ps(r, p));
+        p = _mm256_add_ps(one, _mm256_mul_ps(r, p));
+        __m256 scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(k, _mm256_set1_epi32(127)), 23));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(p, scale));
+    }
+#elif defined(PS_SIMD_SSE2)
+    const __m128 hi = _mm_set1_ps(88.f), lo = _mm_set1_ps(-87.f), one = _mm_set1_ps(1.f);
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), lo), hi);
+        __m128 y = _mm_mul_ps(x, _mm_set1_ps(logTwoE));
+        __m128i k = _mm_cvtps_epi32(y); // round to nearest
+        __m128 r = _mm_mul_ps(_mm_sub_ps(y, _mm_cvtepi32_ps(k)), _mm_set1_ps(lnTwo));
+        __m128 p = _mm_add_ps(_mm_set1_ps(expC5), _mm_mul_ps(r, _mm_set1_ps(expC6)));
+        p = _mm_add_ps(_mm_set1_ps(expC4), _mm_mul_ps(r, p));
+        p = _mm_add_ps(_mm_set1_ps(expC3), _mm_mul_ps(r, p));
+        p = _mm_add_ps(_mm_set1_ps(expC2), _mm_mul_ps(r, p));
+        p = _mm_add_ps(one, _mm_mul_ps(r, p));
+        p = _mm_add_ps(one, _mm_mul_ps(r, p));
+        __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(k, _mm_set1_epi32(127)), 23));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(p, scale));
+    }
+#elif defined(PS_SIMD_NEON)
+    const float32x4_t hi = vdupq_n_f32(88.f), lo = vdupq_n_f32(-87.f), one = vdupq_n_f32(1.f);
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t x = vminq_f32(vmaxq_f32(vld1q_f32(src + i), lo), hi);
+        float32x4_t y = vmulq_n_f32(x, logTwoE);
+        int32x4_t k = vcvtnq_s32_f32(y); // round to nearest
+        float32x4_t r = vmulq_n_f32(vsubq_f32(y, vcvtq_f32_s32(k)), lnTwo);
+        float32x4_t p = vmlaq_f32(vdupq_n_f32(expC5), r, vdupq_n_f32(expC6));
+        p = vmlaq_f32(vdupq_n_f32(expC4), r, p);
+        p = vmlaq_f32(vdupq_n_f32(expC3), r, p);
+        p = vmlaq_f32(vdupq_n_f32(expC2), r, p);
+        p = vmlaq_f32(one, r, p);
+        p = vmlaq_f32(one, r, p);
+        float32x4_t scale = vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(k, vdupq_n_s32(127)), 23));
+        vst1q_f32(dst + i, vmulq_f32(p, scale));
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = fastExpScalar(src[i]);
+    }
+}
+
+} // namespace PitchShifting
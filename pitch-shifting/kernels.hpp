@@ -0,0 +1,92 @@
+#pragma once
+/*
+ * sample processing kernels on the stretcher hot path, vectorized by compile target:
+ *   - AVX2 if compiled with /arch:AVX2 or -mavx2
+ *   - SSE2 for x86/x64 (always available on x64)
+ *   - NEON for arm64 (eg. apple silicon)
+ *   - scalar fallback for the others, also handles the tail of vectorized loops
+ * NOTE: kernels never allocate, buffers are owned by the caller
+ */
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace PitchShifting {
+
+/* name of compiled simd instruction set, eg. "avx2", for debug output */
+const char* SimdKernelName();
+
+/*
+ * deinterleave src[frames * channels] to dst[channel][frames], multiply gain and clamp to [-1.f, 1.f],
+ * specialized for mono, stereo and N channels
+ * \return peak absolute value of src (before gain) for input level metering
+ */
+float DeinterleaveGainClamp(const float* src, float* const* dst, int channels, int frames, float gain);
+
+/*
+ * output channel routing for interleave kernel, each output channel is a weighted sum of input channels,
+ * spec is comma separated per output channel, an entry can be:
+ *   "n"   input channel n
+ *   "n+m" average of input channels n and m (or more)
+ *   "-"   silence
+ * eg. "0,0" mono to stereo, "0+1" stereo downmix to mono, "1,0" swap stereo channels
+ */
+struct ChannelMap {
+    int inChannels = 0;
+    int outChannels = 0;
+    // weights[out * inChannels + in]
+    std::vector<float> weights;
+
+    /* identity if the same channels, stereo downmix to mono, otherwise copy channels and duplicate channel 0 to the rest */
+    static ChannelMap Default(int inChannels, int outChannels);
+    /* parse given spec, \return false with default map if spec is invalid or channels are mismatched */
+    static bool Parse(const std::string& spec, int inChannels, int outChannels, ChannelMap* map);
+    /* \return input channel if output channel takes exactly one input with unity weight, -1 for silence, -2 for mixing */
+    int Source(int out) const;
+};
+
+/*
+ * interleave src[channel][frames] to dst[frames * map.outChannels] through channel map with gain in a single pass,
+ * clamp to [-1.f, 1.f] if clamp is true, otherwise leave clipped samples for caller detection,
+ * specialized for mono, stereo, mono to stereo and stereo to mono, arbitrary maps use weighted sums
+ * \return peak absolute value of routed samples before gain, caller detects clipping by peak * gain >= 1.f
+ */
+float InterleaveChannelMap(const float* const* src, float* dst, const ChannelMap& map, int frames, float gain, bool clamp);
+
+/*
+ * convert little endian pcm samples (eg. data chunk of memory mapped wav file) to float in [-1.f, 1.f),
+ * int16 is vectorized, packed int24 has 3 bytes stride and stays scalar
+ */
+void ConvertPcm16(const int16_t* src, float* dst, size_t samples);
+void ConvertPcm24(const uint8_t* src, float* dst, size_t samples);
+
+/*
+ * DeinterleaveGainClamp() straight from little endian pcm, conversion is fused so no interleaved float block
+ * is written in between, eg. memory mapped int16/int24 wav to stretcher input,
+ * int16 mono and stereo are vectorized, int24 stays scalar
+ * \return peak absolute value of converted samples (before gain)
+ */
+float DeinterleavePcm16GainClamp(const int16_t* src, float* const* dst, int channels, int frames, float gain);
+float DeinterleavePcm24GainClamp(const uint8_t* src, float* const* dst, int channels, int frames, float gain);
+
+/*
+ * per channel minimum and maximum of interleaved src[frames * channels], eg. waveform overview bins,
+ * vectorized if channels divides the vector width (mono, stereo, quad), FLT_MAX/-FLT_MAX if frames is 0
+ */
+void InterleavedMinMax(const float* src, int channels, size_t frames, float* minimum, float* maximum);
+
+/*
+ * sum of a[i] * b[i] for n samples, eg. fir filter taps of resampler, no alignment required,
+ * vectorized with multiple accumulators, summing order differs from scalar loop in the last bits
+ */
+float DotProduct(const float* a, const float* b, int n);
+
+/*
+ * natural log and exp of n samples for spectral envelopes, exponent from float bits and short polynomial of the rest,
+ * log input is clamped to FLT_MIN (no -inf), exp input to [-87, 88], relative error ~1e-6, src and dst may alias
+ */
+void FastLog(const float* src, float* dst, int n);
+void FastExp(const float* src, float* dst, int n);
+
+} // namespace PitchShifting
@@ -12,6 +12,8 @@
 #include <limits>
 
 #include "stretcher.hpp"
+// offline f0 and formant analysis to frequency map
+#include "mapanalyzer.hpp"
 using PitchShifting::SourceType;
 using PitchShifting::SourceDesc;
 std::thread* stherThread = nullptr;
@@ -145,6 +147,7 @@ void uiCreate(const std::map<int, void*>& cbFnMapRef, PitchShifting::Parameters*
 }
 
 int uiPrepareFrame() {
+    TRACE_SCOPE("gui frame");
     int code = window->PrepareFrame();
     if (code > 0) return code;
 
@@ -235,16 +238,11 @@ void setGLWindow(PitchShifting::Parameters* param)
 void mapDataPtrToGuiPlot(PitchShifting::Stretcher* sther) {
     auto version = sther->GetLibraryVersion();
     printf("rubberband version:%s\n", version.c_str());
-    // NOTE: gcc will get invalid address from pointer of channel data in vector directly
-    //auto ptr_of_shared_ptr = sther->GetChannelData();
     auto formantFFTSize = sther->GetFormantFFTSize();
     auto scaleSizes = sther->GetChannelScaleSizes(0);
     std::cout << "got channel data: formant fft size:" << formantFFTSize << " scale size count:" << scaleSizes << std::endl;
     int bufSize = 0;
     double* dataPtr = nullptr;
-    // TODO: draw pitch to realtime waveform, i guess prev mag is for input which store before change formant, or real?
-    sther->GetChannelScaleData(PitchShifting::Stretcher::ScaleDataType::Real, 0, formantFFTSize, &dataPtr, &bufSize);
-    inWaveform->SetPitchInfo(dataPtr, bufSize);
     // using scale plot chart drawing formant data
     sther->GetFormantData(PitchShifting::Stretcher::FormantDataType::Cepstra, 0, &formantFFTSize, &dataPtr, &bufSize);
     formantChart->SetPlotInfo("Ceps", 1, 0, formantFFTSize, dataPtr, bufSize);
@@ -252,25 +250,17 @@ void mapDataPtrToGuiPlot(PitchShifting::Stretcher* sther) {
     formantChart->SetPlotInfo("Envelop", 2, 0, formantFFTSize, dataPtr, bufSize);
     sther->GetFormantData(PitchShifting::Stretcher::FormantDataType::Spare, 0, &formantFFTSize, &dataPtr, &bufSize);
     formantChart->SetPlotInfo("Spare", 3, 0, formantFFTSize, dataPtr, bufSize);
+    // spectrum of envelope analyzer, not prepared without gui or envelope csv
+    if (scaleSizes <= 0) return;
     int fftSize = formantFFTSize; // scale data just using formant fft size 2048
-    //int fftSize = pow(2, (i + 10)); // 1024, 2048, 4096
-    //int bufSize = fftSize / 2 + 1; // 513, 1025, 2049 (bin size)
-    sther->GetChannelScaleData(PitchShifting::Stretcher::ScaleDataType::Real, 0, fftSize, &dataPtr, &bufSize); /* resolution 100 */
+    sther->GetChannelScaleData(PitchShifting::Stretcher::ScaleDataType::Real, 0, fftSize, &dataPtr, &bufSize);
     scaleChart->SetPlotInfo("Real", 1, 0, fftSize, dataPtr, bufSize);
     sther->GetChannelScaleData(PitchShifting::Stretcher::ScaleDataType::Imaginary, 0, fftSize, &dataPtr, &bufSize);
     scaleChart->SetPlotInfo("Imag", 2, 0, fftSize, dataPtr, bufSize);
-    //sther->GetChannelScaleData(PitchShifting::Stretcher::ScaleDataType::Magnitude, 0, fftSize, &dataPtr, &bufSize); /* resolution 0.1 */
+    //sther->GetChannelScaleData(PitchShifting::Stretcher::ScaleDataType::Magnitude, 0, fftSize, &dataPtr, &bufSize);
     //scaleChart->SetPlotInfo("Mag", 3, 0, fftSize, dataPtr, bufSize);
     sther->GetChannelScaleData(PitchShifting::Stretcher::ScaleDataType::PreviousMagnitude, 0, fftSize, &dataPtr, &bufSize);
     scaleChart->SetPlotInfo("PrevMag", 6, 0, fftSize, dataPtr, bufSize, 1000.f);
-    //sther->GetChannelScaleData(PitchShifting::Stretcher::ScaleDataType::Phase, 0, fftSize, &dataPtr, &bufSize); /* resolution pi */
-    //scaleChart->SetPlotInfo("Phase", 4, 0, fftSize, dataPtr, bufSize);
-    //sther->GetChannelScaleData(PitchShifting::Stretcher::ScaleDataType::AdvancedPhase, 0, fftSize, &dataPtr, &bufSize);
-    //scaleChart->SetPlotInfo("AdPhase", 5, 0, fftSize, dataPtr, bufSize);
-    //sther->GetChannelScaleData(PitchShifting::Stretcher::ScaleDataType::PendingKick, 0, fftSize, &dataPtr, &bufSize); /* so far zero values */
-    //scaleChart->SetPlotInfo("Kick", 7, 0, fftSize, dataPtr, bufSize);
-    //sther->GetChannelScaleData(PitchShifting::Stretcher::ScaleDataType::Accumulator, 0, fftSize, &dataPtr, &bufSize); /* resolution 0.1 */
-    //scaleChart->SetPlotInfo("Accu", 8, 0, fftSize, dataPtr, bufSize);
 }
 
 bool setAudioSource(PitchShifting::Parameters& param, PitchShifting::Stretcher* sther,
@@ -287,6 +277,10 @@ bool setAudioSource(PitchShifting::Parameters& param, PitchShifting::Stretcher*
         result = sther->SetInputStream(param.inDeviceIdx, &sampleRate, &channels);
         inputFrames = std::numeric_limits<int64_t>::max();//sampleRate * 3600 * 3; // 3hr for long duration test 
         break;
+    case SourceType::AudioVirtual:
+        result = sther->SetInputVirtual(param.inVirtualSpec, &sampleRate, &channels, &inputFrames);
+        if (inputFrames <= 0) inputFrames = std::numeric_limits<int64_t>::max();
+        break;
     default:
         result = false;
         break;
@@ -300,11 +294,15 @@ bool setAudioSource(PitchShifting::Parameters& param, PitchShifting::Stretcher*
         // manually assign audio format incase the output is file
         format = sther->GetFileFormat(param.outFileExt);
         if (format == 0) format = 65538;
-        result = sther->SetOutputFile(param.outFilePath, sampleRate, 2, format);
+        result = sther->SetOutputFile(param.outFilePath, param.outputRate > 0 ? param.outputRate : sampleRate, 2, format);
         break;
     case SourceType::AudioDevice:
         result = sther->SetOutputStream(param.outDeviceIdx);
         break;
+    case SourceType::AudioVirtual:
+        // same as file output, stereo and follow input sample rate unless given
+        result = sther->SetOutputVirtual(param.outVirtualSpec, param.outputRate > 0 ? param.outputRate : sampleRate, 2);
+        break;
     default:
         result = false;
         break;
@@ -327,68 +325,64 @@ RubberBand::
 timeval etv;
 
 void processAudio(PitchShifting::Stretcher* sther, PitchShifting::Parameters* param) {
+    PitchShifting::Trace::SetThreadName("stretcher");
     sther->stop = false;
     sther->stopped = false;
 
     bool successful = false;
-    int thisBlockSize;
-    int defBlockSize = sther->GetDefBlockSize();
-    double formantScale = param->formantscale;
     int64_t inputFrames = sther->totalFramesCount;
 
+    // file to file with multiple jobs, segments are stretched on worker pool and stitched in order,
+    // segment renderer creates rubberband stretchers, psola, autotune and envelope export render in a single pass
+    if (sther->IsParallelRender()) {
+        int percent = 0;
+        sther->RenderParallel(&sther->inputCount, &sther->outputCount, [&](size_t countIn) {
+            int p = int((double(countIn) * 100.0) / inputFrames);
+            if (p > percent && !param->quiet) {
+                percent = p;
+                cerr << "\r" << percent << "% ";
+            }
+            if (isWaitKeyPressed()) {
+                cerr << "=== Cancel reading inputs ===" << endl;
+                return false;
+            }
+            return true;
+        });
+        if (!param->quiet) {
+            cerr << "\r    " << endl;
+        }
+        sther->stopped = true;
+        return;
+    }
+
     while (!successful) { // we may have to repeat with a modified
         // gain, if clipping occurs
         successful = true;
 
-        sther->Create();
+        sther->BeginProcess(inputFrames);
 
-        /* DEBUG: playground with channel data */
+        /* DEBUG: playground with channel data, formant and scale data from envelope analyzer */
         if (param->gui) {
             mapDataPtrToGuiPlot(sther);
         }
 
-        if (param->inAudioType == SourceType::AudioFile) {
-            sther->ExpectedInputDuration(inputFrames); // estimate from input file
-        }
-        sther->MaxProcessSize(defBlockSize);
-        sther->FormantScale(formantScale);
-        sther->SetIgnoreClipping(param->ignoreClipping);
-
         // NOTE: study input sound here is now meaningless which, will not process twice with first run studying
         //if (!param->realtime) {
         //    sther->StudyInputSound(); // only works on input data source is file
         //}
 
-        int frame = 0;
-        int percent = 0;
-
         // macOS need to recompiling rubberbandstretcher for setKeyFrameMap()
         //sther->SetKeyFrameMap();
 
-        // reset counters
-        sther->inputCount = 0;
-        sther->outputCount = 0;
-        bool clipping = false;
-
-        // The stretcher only pads the start in offline mode; to avoid
-        // a fade in at the start, we pad it manually in RT mode. Both
-        // of these functions are defined to return zero in offline mode
-        int toDrop = 0;
-        toDrop = sther->ProcessStartPad();
-        sther->SetDropFrames(toDrop);
+        int frame = 0;
+        int percent = 0;
 
         bool reading = true; // original offical sample is using isFinal, but reading is much fit to modified behavior
         while (reading) {
+            TRACE_SCOPE("block");
 
-            thisBlockSize = defBlockSize;
-            sther->ApplyFreqMap(sther->inputCount, &thisBlockSize);
-
-            // frame number is actual given rubberband stretcher input frames, 
-            // input count is read frames from input source
-            bool isFinal = sther->ProcessInputSound(&frame, &sther->inputCount);
-
-            // retrieve processed data to out buffer and result if clipping occurred as successful variable
-            successful = sther->RetrieveAvailableData(&sther->outputCount, isFinal);
+            // controls, frequency map, process and retrieve, result if clipping occurred as successful variable
+            successful = sther->ProcessBlock(&frame, nullptr);
 
             if (frame == 0 && !param->realtime && !param->quiet) {
                 cerr << "Pass 2: Processing..." << endl;
@@ -456,6 +450,19 @@ int main(int argc, char **argv)
     auto code = param.ParseOptions(argc, argv);
     if (code >= 0) return code;
 
+    // analysis pass only writes a map for a later render, no stretcher, GUI or device required
+    if (!param.analyzeMap.empty()) {
+        if (param.inAudioType != SourceType::AudioFile) {
+            cerr << "ERROR: Analysis requires an input audio file" << endl;
+            return 1;
+        }
+        PitchShifting::MapAnalyzer analyzer(&param, param.debug);
+        if (!analyzer.Analyze(param.inFilePath) || !analyzer.WriteFreqMap(param.analyzeMap)) {
+            return 1;
+        }
+        return 0;
+    }
+
     if (param.gui) {
         setGLWindow(&param);
         uiCreate(uiCallbackFnMap, &param);
@@ -464,26 +471,36 @@ int main(int argc, char **argv)
     }
     
     // start stretcher class initialization here
-    const int defBlockSize = 1024;
+    // device callbacks and process blocks are the same size, smaller for low latency profile
+    const int defBlockSize = (param.callbackFrames > 0) ? param.callbackFrames : 1024;
     PitchShifting::Stretcher *sther = new PitchShifting::Stretcher(&param, defBlockSize, 1);
 
     sther->LoadTimeMap(param.timeMapFile);
     bool pitchToFreq = param.freqMapFile.empty();
     sther->LoadFreqMap((pitchToFreq ? param.pitchMapFile : param.freqMapFile), pitchToFreq);
 
-    // so far use audio device frequently than files
+    // batch mode processes files by itself, no audio source and device required
+    if (!param.batchPath.empty()) {
+        int failed = sther->ProcessBatch();
+        delete sther;
+        return (failed == 0) ? 0 : 1;
+    }
+
+    // so far use audio device frequently than files, but only enumerate them if a device may be used,
+    // file and virtual sources never initialize portaudio
     std::vector<SourceDesc> devices;
-    int devCount = sther->ListAudioDevices(devices);
+    if (param.listdev || param.gui ||
+        param.inAudioType == SourceType::AudioDevice || param.outAudioType == SourceType::AudioDevice) {
+        sther->ListAudioDevices(devices);
+    }
     // list audio device only
     if (param.listdev) {
         delete sther;
         return 0;
     }
 
-    // only for gui combobox presents items
+    // only for gui combobox presents items, scanned in background once the form is ready
     std::vector<SourceDesc> files;
-    int fileCount = sther->ListLocalFiles(files);
-    cerr << "Local audio files: " << fileCount << endl;
 
     int sampleRate = 0;
     int channels = 0;
@@ -507,6 +524,7 @@ int main(int argc, char **argv)
         ctrlForm->SetAudioAdjustment(param.pitchshift, param.formantshift, param.inputgaindb);
         // for further refresh audio source list
         ctrlForm->SetStretcher(sther);
+        ctrlForm->RefreshSourceList();
     }
     
     if (checkAudio == false && param.gui == false) {
@@ -585,6 +603,11 @@ int main(int argc, char **argv)
 
     //DEBUG: section for GUI initialization before stretcher creation(after ctor, but before rubber band configuration)
     if (param.gui) {
+        // file overview from peak cache, rebuilt in background if stale
+        fileWaveform->SetPeakCache(sther->GetPeakCache());
+        if (param.inAudioType == SourceType::AudioFile) {
+            fileWaveform->LoadAudioFile(param.inFilePath);
+        }
         // set audio information to GUI plot, given inFrame must afterward sther->SetInputStream for buffer initialization
         inWaveform->SetAudioInfo(sampleRate, channels, sther->inFrame, defBlockSize * channels);
         outWaveform->SetAudioInfo(
@@ -592,8 +615,13 @@ int main(int argc, char **argv)
             sther->outSrcDesc.outputChannels,
             sther->outFrame,
             defBlockSize * sther->outSrcDesc.outputChannels);
+        // f0 tracked by stretcher on input and shifted output
+        inWaveform->SetPitchSeries(sther->GetPitchSeries(false));
+        outWaveform->SetPitchSeries(sther->GetPitchSeries(true));
     }
 
+    // frequency ratio from CLI without pitch semitones, for live pitch adjustment from GUI
+    const double baseFrequencyShift = param.frequencyshift;
     if (param.pitchshift != 0.0) {
         param.frequencyshift *= pow(2.0, param.pitchshift / 12.0);
         cerr << "Pitch shift semitones: " << param.pitchshift << endl;
@@ -638,6 +666,12 @@ int main(int argc, char **argv)
     //sther->Create();
     //mapDataPtrToGuiPlot(sther);
 
+    // trace from stream start, covers callbacks and stretcher thread
+    if (!param.traceFile.empty()) {
+        PitchShifting::Trace::Start(param.traceFile);
+        PitchShifting::Trace::SetThreadName("main");
+    }
+
     sther->StartInputStream();
     sther->StartOutputStream();
 
@@ -653,6 +687,25 @@ int main(int argc, char **argv)
 
 		// keep GUI rendering to display charts
 		while (uiPrepareFrame() == 0) {
+			// live adjustment, stretcher thread applies at next block without recreating rubberband stretcher
+			auto data = uiCtrlFormData.load();
+			if (data && uiSetAudioButton == GLUI::CtrlFormIds::SetAdjustmentButton) {
+				uiSetAudioButton = 0;
+				// NOTE: frequency shift and formant scale are owned by stretcher thread now, only post them
+				double frequencyShift = baseFrequencyShift * pow(2.0, data->PitchShift / 12.0);
+				sther->PostControl(PitchShifting::ControlChange::PitchScale, frequencyShift);
+				if (sther->IsFormantEnabled() || data->FormantShift != 0.0) {
+					double formantScale = (1.0 / frequencyShift) * pow(2.0, data->FormantShift / 12.0);
+					sther->PostControl(PitchShifting::ControlChange::FormantScale, formantScale);
+				}
+				if (data->InputGain != param.inputgaindb) {
+					sther->PostControl(PitchShifting::ControlChange::InputGain, pow(10.0, data->InputGain / 20.0));
+				}
+				param.pitchshift = data->PitchShift;
+				param.formantshift = data->FormantShift;
+				param.inputgaindb = data->InputGain;
+				cerr << "pitch/formant/gain adjusted by user " << param.pitchshift << ", " << param.formantshift << ", " << param.inputgaindb << endl;
+			}
 		}
 		uiTerminate(uiCallbackFnMap);
 		if (uiWindowState == FnWindowStates::DESTROYED) {
@@ -672,6 +725,7 @@ int main(int argc, char **argv)
     //sther->WaitStream(); // DEBUG: no need to wait stream for callback, use main loop instead
     sther->StopInputStream();
     sther->StopOutputStream();
+    PitchShifting::Trace::Stop();
 
     if (!param.quiet) {
         auto countIn = sther->inputCount;
@@ -696,6 +750,27 @@ int main(int argc, char **argv)
         cerr << "elapsed time: " << sec << " sec, in frames/sec: "
              << int64_t(countIn/sec) << ", out frames/sec: "
              << int64_t(countOut/sec) << endl;
+
+        // xruns only happen with audio device streams
+        auto xruns = sther->GetXrunCounters();
+        auto isDevice = [](SourceType type) { return type == SourceType::AudioDevice || type == SourceType::AudioVirtual; };
+        if (isDevice(sther->inSrcDesc.type) || isDevice(sther->outSrcDesc.type)) {
+            cerr << "xruns: input overruns " << xruns.inputOverruns << " (device overflows " << xruns.inputOverflows
+                 << "), output underruns " << xruns.outputUnderruns << " (device underflows " << xruns.outputUnderflows
+                 << "), output overruns " << xruns.outputOverruns << endl;
+        }
+        if (auto dev = sther->GetInputVirtual()) {
+            cerr << "virtual input callbacks " << dev->GetCallbackCount() << ", late " << dev->GetLateCount() << endl;
+        }
+        if (auto dev = sther->GetOutputVirtual()) {
+            cerr << "virtual output callbacks " << dev->GetCallbackCount() << ", late " << dev->GetLateCount()
+                 << ", captured frames " << dev->GetCaptured().size() / sther->outSrcDesc.outputChannels << endl;
+        }
+        if (param.measureLatency) {
+            auto probe = sther->GetLatencyProbeStats();
+            cerr << "loopback latency n:" << probe.count << " lost:" << probe.lost << " min:" << probe.minMs
+                 << "ms mean:" << probe.meanMs << "ms max:" << probe.maxMs << "ms" << endl;
+        }
     }
 
     //RubberBand::Profiler::dump();
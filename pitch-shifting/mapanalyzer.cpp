@@ -0,0 +1,257 @@
+#include "mapanalyzer.hpp"
+#include "envelope.hpp"
+#include "pitchtracker.hpp"
+#include "trace.hpp"
+#include "workerpool.hpp"
+#include <sndfile.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using std::cerr;
+using std::endl;
+
+namespace PitchShifting {
+
+// voice range of pitch tracker, yin window center is one period of min f0 before the newest sample
+static const double trackerMinF0 = 60.0;
+static const double trackerMaxF0 = 1000.0;
+// below it the frame is unvoiced, the same as autotune
+static const float minConfidence = 0.5f;
+// frames per second of f0 and envelope
+static const int framesPerSecond = 100;
+// read before each chunk so the trackers are warmed up at its first frame
+static const double prerollSeconds = 0.1;
+// envelope peaks searched in this range for F1 and F2, lifter is longer than plot default to resolve F1 and F2
+// ~500Hz apart, still shorter than periods of voice up to ~330Hz
+static const double formantCutoffMs = 3.0;
+static const double formantMinHz = 150.0;
+static const double formantMaxHz = 4000.0;
+// f0 median filter over neighbor voiced frames each side
+static const int smoothFrames = 2;
+// map key is written if the ratio moved this far from the last key
+static const double minKeyCents = 5.0;
+
+MapAnalyzer::MapAnalyzer(Parameters* parameters, int dbgLevel)
+    : debug(dbgLevel), param(parameters) {
+}
+
+// first two peaks of envelope magnitude, parabolic refined on log magnitude
+static void
+findFormants(EnvelopeAnalyzer& envelope, int sampleRate, float* formants) {
+    const double* env = envelope.GetEnvelope();
+    int bins = envelope.GetBinCount();
+    double binHz = (double)sampleRate / envelope.GetFftSize();
+    int from = std::max(1, (int)(formantMinHz / binHz));
+    int to = std::min(bins - 2, (int)(formantMaxHz / binHz));
+    int found = 0;
+    formants[0] = formants[1] = 0.f;
+    for (int k = from; k <= to && found < 2; ++k) {
+        if (!(env[k] > env[k - 1] && env[k] >= env[k + 1])) continue;
+        double x0 = log(env[k - 1]), x1 = log(env[k]), x2 = log(env[k + 1]);
+        double den = x0 - 2 * x1 + x2;
+        double refined = k + (den < 0.0 ? 0.5 * (x0 - x2) / den : 0.0);
+        formants[found++] = (float)(refined * binHz);
+    }
+}
+
+bool
+MapAnalyzer::analyzeChunk(const std::string& inFile, Chunk& chunk) {
+    TRACE_SCOPE("analyze chunk");
+    // own handle per chunk, sndfile handles are not thread safe
+    SF_INFO info;
+    memset(&info, 0, sizeof(SF_INFO));
+    SNDFILE* file = sf_open(inFile.c_str(), SFM_READ, &info);
+    if (!file) {
+        cerr << "ERROR: Failed to open input file \"" << inFile << "\" for chunk at " << chunk.begin << endl;
+        return false;
+    }
+    sf_seek(file, chunk.readBegin, SEEK_SET);
+
+    int channels = info.channels;
+    int hop = std::max(1, info.samplerate / framesPerSecond);
+    int64_t delay = (int64_t)(info.samplerate / trackerMinF0);
+    // frames centered up to chunk end need the input one delay after it
+    size_t readEnd = std::min((size_t)info.frames, chunk.end + (size_t)delay);
+
+    PitchTracker tracker;
+    tracker.Prepare(info.samplerate, trackerMinF0, trackerMaxF0);
+    EnvelopeAnalyzer envelope;
+    envelope.Prepare(info.samplerate, 2048, formantCutoffMs, (double)info.samplerate / hop);
+
+    std::vector<float> ibuf((size_t)hop * channels);
+    std::vector<std::vector<float>> cdata(channels, std::vector<float>(hop));
+    std::vector<float*> cbuf(channels);
+    for (int c = 0; c < channels; ++c) cbuf[c] = cdata[c].data();
+
+    chunk.frames.reserve((chunk.end - chunk.begin) / hop + 1);
+    AnalysisFrame current;
+    uint64_t envelopeFrames = 0;
+    size_t pos = chunk.readBegin;
+    while (pos < readEnd) {
+        sf_count_t count = sf_readf_float(file, ibuf.data(), std::min((size_t)hop, readEnd - pos));
+        if (count <= 0) break;
+        for (sf_count_t i = 0; i < count; ++i) {
+            for (int c = 0; c < channels; ++c) cdata[c][i] = ibuf[i * channels + c];
+        }
+        tracker.Process(cbuf.data(), channels, (size_t)count);
+        envelope.Process(cbuf.data(), channels, (size_t)count);
+        pos += (size_t)count;
+
+        if (envelope.GetFrameCount() != envelopeFrames) {
+            envelopeFrames = envelope.GetFrameCount();
+            findFormants(envelope, info.samplerate, current.formants);
+        }
+        PitchPoint point = tracker.GetLatest();
+        current.confidence = point.confidence;
+        current.f0 = (point.confidence >= minConfidence) ? point.f0 : 0.f;
+        current.frame = (int64_t)pos - delay;
+        if (current.frame >= (int64_t)chunk.begin && current.frame < (int64_t)chunk.end) {
+            chunk.frames.push_back(current);
+        }
+    }
+    sf_close(file);
+    return true;
+}
+
+bool
+MapAnalyzer::Analyze(const std::string& inFile) {
+    auto begin = std::chrono::steady_clock::now();
+    SF_INFO info;
+    memset(&info, 0, sizeof(SF_INFO));
+    SNDFILE* file = sf_open(inFile.c_str(), SFM_READ, &info);
+    if (!file) {
+        cerr << "ERROR: Failed to open input file \"" << inFile << "\": " << sf_strerror(file) << endl;
+        return false;
+    }
+    sf_close(file);
+    if (info.frames <= 0) {
+        cerr << "ERROR: Analysis requires frame count of input file" << endl;
+        return false;
+    }
+    input = inFile;
+    sampleRate = info.samplerate;
+    totalFrames = info.frames;
+
+    // chunk bounds on the hop grid, every chunk analyzes frames at the same positions as a single pass
+    size_t hop = std::max(1, info.samplerate / framesPerSecond);
+    size_t length = std::max((size_t)1, (size_t)(param->segmentSeconds * info.samplerate / hop)) * hop;
+    size_t preroll = (size_t)(prerollSeconds * info.samplerate / hop) * hop;
+    std::vector<Chunk> chunks;
+    for (size_t from = 0; from < (size_t)info.frames; from += length) {
+        Chunk chunk;
+        chunk.begin = from;
+        chunk.end = std::min((size_t)info.frames, from + length);
+        chunk.readBegin = from - std::min(preroll, from);
+        chunks.push_back(chunk);
+    }
+
+    int threads = 0;
+    {
+        WorkerPool pool(param->jobs);
+        threads = pool.GetThreadCount();
+        for (auto& chunk : chunks) {
+            Chunk* pchunk = &chunk;
+            pool.Submit([this, pchunk, &inFile]() {
+                Trace::SetThreadName("analysis worker");
+                pchunk->failed = !analyzeChunk(inFile, *pchunk);
+            });
+        }
+        pool.Wait();
+    }
+
+    frames.clear();
+    for (auto& chunk : chunks) {
+        if (chunk.failed) return false;
+        frames.insert(frames.end(), chunk.frames.begin(), chunk.frames.end());
+    }
+    planRatios();
+
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    if (!param->quiet) {
+        double seconds = (double)totalFrames / sampleRate;
+        size_t voiced = std::count_if(frames.begin(), frames.end(), [](const AnalysisFrame& f) { return f.f0 > 0.f; });
+        cerr << "Analyzed " << seconds << "s in " << chunks.size() << " chunk(s) on " << threads << " thread(s), "
+            << wall << "s (" << (wall > 0.0 ? seconds / wall : 0.0) << "x realtime)" << endl;
+        cerr << voiced << " of " << frames.size() << " frames voiced, median f0 " << medianF0
+            << "Hz, target " << targetF0 << "Hz, range " << param->analyzeRange << endl;
+    }
+    return true;
+}
+
+void
+MapAnalyzer::planRatios() {
+    std::vector<double> logF0;
+    for (auto& f : frames) {
+        if (f.f0 > 0.f) logF0.push_back(log(f.f0));
+    }
+    if (logF0.empty()) {
+        medianF0 = targetF0 = 0.0;
+        for (auto& f : frames) f.ratio = 1.0;
+        cerr << "WARNING: No voiced frames found, map keeps the pitch" << endl;
+        return;
+    }
+    std::nth_element(logF0.begin(), logF0.begin() + logF0.size() / 2, logF0.end());
+    double logMedian = logF0[logF0.size() / 2];
+    medianF0 = exp(logMedian);
+    targetF0 = (param->analyzeTarget > 0.0) ? param->analyzeTarget : medianF0;
+    double logTarget = log(targetF0);
+
+    // median of voiced neighbors drops single frame octave errors before they become pitch jumps
+    double window[smoothFrames * 2 + 1];
+    double lastRatio = 0.0;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        AnalysisFrame& f = frames[i];
+        if (f.f0 <= 0.f) {
+            f.ratio = lastRatio;
+            continue;
+        }
+        int n = 0;
+        size_t from = i - std::min(i, (size_t)smoothFrames);
+        size_t to = std::min(frames.size(), i + smoothFrames + 1);
+        for (size_t j = from; j < to; ++j) {
+            if (frames[j].f0 > 0.f) window[n++] = log(frames[j].f0);
+        }
+        std::nth_element(window, window + n / 2, window + n);
+        double logF = window[n / 2];
+        f.ratio = exp(logTarget + param->analyzeRange * (logF - logMedian) - logF);
+        lastRatio = f.ratio;
+    }
+    // leading unvoiced frames take the first voiced ratio
+    auto firstVoiced = std::find_if(frames.begin(), frames.end(), [](const AnalysisFrame& f) { return f.f0 > 0.f; });
+    for (auto it = frames.begin(); it != firstVoiced; ++it) {
+        it->ratio = firstVoiced->ratio;
+    }
+}
+
+bool
+MapAnalyzer::WriteFreqMap(const std::string& mapFile) {
+    std::ofstream out(mapFile.c_str(), std::ios::out | std::ios::trunc);
+    if (!out.is_open()) {
+        cerr << "ERROR: Failed to write map file \"" << mapFile << "\"" << endl;
+        return false;
+    }
+    out << "# frequency map of \"" << input << "\" by --analyze, " << sampleRate << "Hz " << totalFrames << " frames" << endl;
+    out << "# median f0 " << medianF0 << "Hz, target " << targetF0 << "Hz, range " << param->analyzeRange << endl;
+    out << "# <input frame> <pitch ratio>  # f0 F1 F2 (Hz, 0 if unvoiced or not found)" << endl;
+    size_t keys = 0;
+    double lastKey = 0.0;
+    for (auto& f : frames) {
+        if (keys > 0 && fabs(1200.0 * log2(f.ratio / lastKey)) < minKeyCents) continue;
+        // the first key applies from the very beginning
+        out << (keys == 0 ? 0 : f.frame) << " " << f.ratio << "  # "
+            << (int)lround(f.f0) << " " << (int)lround(f.formants[0]) << " " << (int)lround(f.formants[1]) << endl;
+        lastKey = f.ratio;
+        keys++;
+    }
+    out.close();
+    if (!param->quiet) {
+        cerr << "Wrote " << keys << " key(s) of " << frames.size() << " frames to map file \"" << mapFile << "\"" << endl;
+    }
+    return !out.fail();
+}
+
+} // namespace PitchShifting
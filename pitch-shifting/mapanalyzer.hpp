@@ -0,0 +1,66 @@
+#pragma once
+/*
+ * offline analysis of an input file to a frequency map for later render (--analyze), replaces hand-written maps
+ *   - input is split into chunks of --segment-seconds analyzed on --jobs threads, each chunk reads a short
+ *     preroll before its own range to warm up, frames of 10ms are joined in order afterwards
+ *   - every frame has f0 (yin, PitchTracker) and the first 2 formants (peaks of cepstral envelope, EnvelopeAnalyzer)
+ *   - pitch ratio of a voiced frame moves median f0 of the file to the target and scales the contour around it,
+ *       target * (f0 / median) ^ range / f0
+ *     range 1 keeps prosody at the new key, 0 flattens pitch to the target, unvoiced frames hold the last ratio
+ *   - map keys are written only if the ratio moves more than a few cents, the same format LoadFreqMap() reads,
+ *     f0 and formants of a key follow as '#' comment
+ * NOTE: analysis only, ApplyFreqMap() of render multiplies --pitch by the map ratio, keep it 0 for the map target
+ */
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "parameters.h"
+
+namespace PitchShifting {
+
+struct AnalysisFrame {
+    int64_t frame = 0; // input frame at center of analysis
+    float f0 = 0.f; // Hz, 0 if unvoiced
+    float confidence = 0.f;
+    float formants[2] = { 0.f, 0.f }; // F1 and F2 in Hz, 0 if not found
+    double ratio = 1.0; // planned pitch ratio
+};
+
+class MapAnalyzer {
+public:
+    MapAnalyzer(Parameters* parameters, int dbgLevel = 1);
+    virtual ~MapAnalyzer() {}
+
+    /* analyze whole input file on param->jobs threads, blocks until done, \return false if input failed */
+    bool Analyze(const std::string& inFile);
+    /* write keys of changed ratio to map file, \return false if not writable */
+    bool WriteFreqMap(const std::string& mapFile);
+
+    const std::vector<AnalysisFrame>& GetFrames() const { return frames; }
+    /* median f0 of voiced frames, 0 if none */
+    double GetMedianF0() const { return medianF0; }
+
+private:
+    struct Chunk {
+        size_t begin = 0; // owned input range
+        size_t end = 0;
+        size_t readBegin = 0; // with preroll
+        std::vector<AnalysisFrame> frames;
+        bool failed = false;
+    };
+    bool analyzeChunk(const std::string& inFile, Chunk& chunk);
+    // median f0, smoothed ratio per frame
+    void planRatios();
+
+    int debug;
+    Parameters* param;
+    std::string input;
+    int sampleRate = 0;
+    int64_t totalFrames = 0;
+    std::vector<AnalysisFrame> frames;
+    double medianF0 = 0.0;
+    double targetF0 = 0.0;
+};
+
+} // namespace PitchShifting
@@ -0,0 +1,246 @@
+#include "mappedfile.hpp"
+#include "kernels.hpp"
+#include <cmath>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace PitchShifting {
+
+static inline uint16_t readLe16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+static inline uint32_t readLe32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// samples are decoded in host byte order by the kernels
+static bool isLittleEndianHost() {
+    const uint16_t probe = 1;
+    uint8_t first;
+    memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+MappedAudioFile::~MappedAudioFile() {
+    Close();
+}
+
+bool
+MappedAudioFile::Open(const std::string& fileName) {
+    Close();
+    name = fileName;
+    if (!isLittleEndianHost()) return false;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mapHandle = mapping;
+    base = (const uint8_t*)view;
+    size = (size_t)fileSize.QuadPart;
+#else
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void* addr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // mapping holds its own reference to the file
+    close(fd);
+    if (addr == MAP_FAILED) return false;
+    base = (const uint8_t*)addr;
+    size = (size_t)st.st_size;
+#endif
+    if (!parse()) {
+        Close();
+        return false;
+    }
+#ifndef _WIN32
+    // sequential readahead of data range, header pages are already touched
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t offset = (size_t)(data - base) & ~(page - 1);
+    madvise((void*)(base + offset), size - offset, MADV_SEQUENTIAL);
+#endif
+    position = 0;
+    return true;
+}
+
+void
+MappedAudioFile::Close() {
+    if (base) {
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+        CloseHandle((HANDLE)mapHandle);
+        CloseHandle((HANDLE)fileHandle);
+        mapHandle = fileHandle = nullptr;
+#else
+        munmap((void*)base, size);
+#endif
+    }
+    base = nullptr;
+    size = 0;
+    data = nullptr;
+    sampleType = Unsupported;
+    frames = 0;
+    position = 0;
+}
+
+bool
+MappedAudioFile::parse() {
+    if (size < 12 || memcmp(base, "RIFF", 4) != 0 || memcmp(base + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+    int format = 0;
+    int bits = 0;
+    size_t dataSize = 0;
+    size_t pos = 12;
+    // chunks are word aligned, stop at data chunk which may be the last one or followed by metadata
+    while (pos + 8 <= size) {
+        const uint8_t* chunk = base + pos;
+        size_t chunkSize = readLe32(chunk + 4);
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16 && pos + 8 + 16 <= size) {
+            format = readLe16(chunk + 8);
+            channels = readLe16(chunk + 10);
+            sampleRate = (int)readLe32(chunk + 12);
+            bytesPerFrame = readLe16(chunk + 20);
+            bits = readLe16(chunk + 22);
+            // WAVE_FORMAT_EXTENSIBLE, sub format guid starts with the format tag
+            if (format == 0xFFFE && chunkSize >= 40 && pos + 8 + 40 <= size) {
+                format = readLe16(chunk + 8 + 24);
+            }
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            data = chunk + 8;
+            // truncated file or streaming writer left size unset, take the rest of file
+            dataSize = (chunkSize == 0 || chunkSize == 0xFFFFFFFF || pos + 8 + chunkSize > size) ? size - pos - 8 : chunkSize;
+            break;
+        }
+        pos += 8 + chunkSize + (chunkSize & 1);
+    }
+    if (!data || channels <= 0 || sampleRate <= 0 || bytesPerFrame <= 0) return false;
+
+    if (format == 1 && bits == 16 && bytesPerFrame == 2 * channels) sampleType = Int16;
+    else if (format == 1 && bits == 24 && bytesPerFrame == 3 * channels) sampleType = Int24;
+    else if (format == 3 && bits == 32 && bytesPerFrame == 4 * channels) sampleType = Float32;
+    else return false;
+
+    frames = (int64_t)(dataSize / bytesPerFrame);
+    return frames > 0;
+}
+
+int64_t
+MappedAudioFile::Read(const float** out, float* convertBuf, int64_t count) {
+    if (!base || position >= frames) return 0;
+    if (count > frames - position) count = frames - position;
+    const uint8_t* src = data + position * bytesPerFrame;
+    size_t samples = (size_t)count * channels;
+    switch (sampleType) {
+    case Float32:
+        // in place if aligned for float, data chunk normally starts at 4 bytes boundary
+        if (((uintptr_t)src & 3) == 0) {
+            *out = (const float*)src;
+        } else {
+            memcpy(convertBuf, src, samples * sizeof(float));
+            *out = convertBuf;
+        }
+        break;
+    case Int16:
+        if (((uintptr_t)src & 1) == 0) {
+            ConvertPcm16((const int16_t*)src, convertBuf, samples);
+        } else {
+            // odd data chunk offset, rare enough for per sample copy
+            for (size_t i = 0; i < samples; ++i, src += sizeof(int16_t)) {
+                int16_t v;
+                memcpy(&v, src, sizeof(int16_t));
+                convertBuf[i] = v * (1.f / 32768.f);
+            }
+        }
+        *out = convertBuf;
+        break;
+    case Int24:
+        ConvertPcm24(src, convertBuf, samples);
+        *out = convertBuf;
+        break;
+    default:
+        return 0;
+    }
+    position += count;
+    return count;
+}
+
+int64_t
+MappedAudioFile::ReadChannels(float* const* dst, int64_t count, float gain, float* peak) {
+    *peak = 0.f;
+    if (!base || position >= frames) return 0;
+    if (count > frames - position) count = frames - position;
+    const uint8_t* src = data + position * bytesPerFrame;
+    switch (sampleType) {
+    case Float32:
+        if (((uintptr_t)src & 3) == 0) {
+            *peak = DeinterleaveGainClamp((const float*)src, dst, channels, (int)count, gain);
+        } else {
+            // odd data chunk offset, rare enough for per sample copy
+            for (int64_t i = 0; i < count; ++i) {
+                for (int c = 0; c < channels; ++c, src += sizeof(float)) {
+                    float v;
+                    memcpy(&v, src, sizeof(float));
+                    *peak = fmaxf(*peak, fabsf(v));
+                    dst[c][i] = fminf(fmaxf(v * gain, -1.f), 1.f);
+                }
+            }
+        }
+        break;
+    case Int16:
+        if (((uintptr_t)src & 1) == 0) {
+            *peak = DeinterleavePcm16GainClamp((const int16_t*)src, dst, channels, (int)count, gain);
+        } else {
+            for (int64_t i = 0; i < count; ++i) {
+                for (int c = 0; c < channels; ++c, src += sizeof(int16_t)) {
+                    int16_t s;
+                    memcpy(&s, src, sizeof(int16_t));
+                    float v = s * (1.f / 32768.f);
+                    *peak = fmaxf(*peak, fabsf(v));
+                    dst[c][i] = fminf(fmaxf(v * gain, -1.f), 1.f);
+                }
+            }
+        }
+        break;
+    case Int24:
+        *peak = DeinterleavePcm24GainClamp(src, dst, channels, (int)count, gain);
+        break;
+    default:
+        return 0;
+    }
+    position += count;
+    return count;
+}
+
+} // namespace PitchShifting
@@ -0,0 +1,77 @@
+#pragma once
+/*
+ * memory mapped input of uncompressed wav file, bypasses sndfile decoding for the process path
+ *   - parses RIFF/WAVE chunks for "fmt " and "data", supports int16, packed int24 and float32 PCM,
+ *     WAVE_FORMAT_EXTENSIBLE is accepted with PCM or IEEE float sub format
+ *   - float32 blocks are handed out in place from mapped pages, int16/int24 are converted into caller buffer,
+ *     or every type is converted and deinterleaved straight into per channel buffers by ReadChannels()
+ *   - data range is advised sequential, so kernel reads ahead (madvise, or sequential scan flag on windows)
+ * NOTE: wav is little endian, only little endian hosts (x86/x64, arm64) are supported, Open() fails on big endian
+ *       hosts so caller falls back to sndfile, the same as the other formats (compressed, rf64, big endian aiff)
+ */
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace PitchShifting {
+
+class MappedAudioFile {
+public:
+    enum SampleType : int {
+        Unsupported,
+        Int16,
+        Int24,
+        Float32
+    };
+
+    MappedAudioFile() {}
+    virtual ~MappedAudioFile();
+    MappedAudioFile(const MappedAudioFile&) = delete;
+    MappedAudioFile& operator=(const MappedAudioFile&) = delete;
+
+    /* map the file and parse wav header, \return false if file can not be mapped or format is unsupported */
+    bool Open(const std::string& fileName);
+    void Close();
+    bool IsOpen() const { return base != nullptr; }
+
+    int GetChannels() const { return channels; }
+    int GetSampleRate() const { return sampleRate; }
+    int64_t GetFrames() const { return frames; }
+    SampleType GetSampleType() const { return sampleType; }
+    int64_t GetPosition() const { return position; }
+    void Seek(int64_t frame) { position = frame < 0 ? 0 : (frame > frames ? frames : frame); }
+
+    /*
+     * next block of interleaved float frames from current position, *data points into mapped pages for
+     * float32 (zero copy) or into convertBuf (frames * channels) after conversion
+     * \return frames of the block, 0 at end of data
+     */
+    int64_t Read(const float** data, float* convertBuf, int64_t frames);
+    /*
+     * next block from current position deinterleaved to dst[channel][frames] with gain and clamp, see
+     * DeinterleaveGainClamp(), no interleaved float block in between, *peak is absolute peak before gain
+     * \return frames of the block, 0 at end of data
+     */
+    int64_t ReadChannels(float* const* dst, int64_t frames, float gain, float* peak);
+
+private:
+    bool parse();
+
+    std::string name;
+    const uint8_t* base = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mapHandle = nullptr;
+#endif
+
+    const uint8_t* data = nullptr; // start of data chunk
+    int channels = 0;
+    int sampleRate = 0;
+    int64_t frames = 0;
+    int bytesPerFrame = 0;
+    SampleType sampleType = Unsupported;
+    int64_t position = 0;
+};
+
+} // namespace PitchShifting
@@ -0,0 +1,302 @@
+#include "parallelrender.hpp"
+#include "kernels.hpp"
+#include "renderloop.hpp"
+#include "trace.hpp"
+#include "workerpool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+
+using std::cerr;
+using std::endl;
+using RubberBand::RubberBandStretcher;
+
+namespace PitchShifting {
+
+static const double pi = 3.14159265358979323846;
+
+ParallelRenderer::ParallelRenderer(Parameters* parameters, RubberBandStretcher::Options opts,
+    const std::map<size_t, double>& map, int dbgLevel)
+    : debug(dbgLevel), param(parameters), freqMap(map) {
+    options = RenderLoop::SingleThreaded(opts);
+}
+
+size_t
+ParallelRenderer::quietestFrame(SNDFILE* file, const SF_INFO& info, size_t from, size_t to) {
+    // 10ms windows of summed energy over channels, boundary goes to the center of the quietest one
+    int window = std::max(1, info.samplerate / 100);
+    std::vector<float> buf((size_t)window * info.channels);
+    size_t best = (from + to) / 2;
+    double bestEnergy = -1.0;
+    sf_seek(file, from, SEEK_SET);
+    for (size_t pos = from; pos + window <= to; pos += window) {
+        sf_count_t count = sf_readf_float(file, buf.data(), window);
+        if (count <= 0) break;
+        double energy = 0.0;
+        for (size_t i = 0; i < (size_t)count * info.channels; ++i) {
+            energy += (double)buf[i] * buf[i];
+        }
+        if (bestEnergy < 0.0 || energy < bestEnergy) {
+            bestEnergy = energy;
+            best = pos + window / 2;
+        }
+    }
+    return best;
+}
+
+void
+ParallelRenderer::planSegments(SNDFILE* file, const SF_INFO& info, std::vector<Segment>& segments) {
+    size_t frames = (size_t)info.frames;
+    size_t length = std::max((size_t)1, (size_t)(param->segmentSeconds * info.samplerate));
+    size_t overlap = (size_t)(param->segmentOverlap * info.samplerate);
+    // overlap on both sides never reaches the middle of a segment
+    overlap = std::min(overlap, length / 2);
+
+    std::vector<size_t> bounds{ 0 };
+    while (frames - bounds.back() > length + length / 2) {
+        size_t nominal = bounds.back() + length;
+        if (param->splitSilence) {
+            // search a quarter segment around, at most 2 seconds each side
+            size_t range = std::min(length / 4, (size_t)info.samplerate * 2);
+            nominal = quietestFrame(file, info, nominal - range, nominal + range);
+        }
+        bounds.push_back(nominal);
+    }
+    bounds.push_back(frames);
+
+    segments.resize(bounds.size() - 1);
+    for (size_t i = 0; i < segments.size(); ++i) {
+        Segment& seg = segments[i];
+        seg.begin = bounds[i];
+        seg.end = bounds[i + 1];
+        seg.readBegin = seg.begin - std::min(overlap, seg.begin);
+        seg.readEnd = std::min(frames, seg.end + overlap);
+        // crossfade in the middle half of overlap, the outer quarters carry warm up and flush edges of stretchers
+        size_t boundary = outputFrame(seg.end);
+        size_t halfWidth = outputFrame(overlap) / 4;
+        seg.fadeBegin = boundary - std::min(halfWidth, boundary);
+        seg.fadeEnd = std::min(boundary + halfWidth, outputFrame(seg.readEnd));
+        if (i + 1 == segments.size()) {
+            seg.fadeBegin = seg.fadeEnd = outputFrame(frames);
+        }
+    }
+    sf_seek(file, 0, SEEK_SET);
+
+    if (debug > 0) {
+        cerr << "parallel render " << segments.size() << " segments of " << param->segmentSeconds
+            << "s, overlap " << overlap << " frames" << (param->splitSilence ? " split at silence" : "") << endl;
+    }
+    if (debug > 1) {
+        for (auto& seg : segments) {
+            cerr << "segment " << seg.begin << "-" << seg.end << " read " << seg.readBegin << "-" << seg.readEnd
+                << " fade " << seg.fadeBegin << "-" << seg.fadeEnd << endl;
+        }
+    }
+}
+
+bool
+ParallelRenderer::renderSegment(const std::string& inFile, Segment& seg, int outChannels) {
+    TRACE_SCOPE("segment");
+    // own handle per segment, sndfile handles are not thread safe
+    SF_INFO info;
+    memset(&info, 0, sizeof(SF_INFO));
+    SNDFILE* file = sf_open(inFile.c_str(), SFM_READ, &info);
+    if (!file) {
+        cerr << "ERROR: Failed to open input file \"" << inFile << "\" for segment at " << seg.begin << endl;
+        return false;
+    }
+    sf_seek(file, seg.readBegin, SEEK_SET);
+
+    int channels = info.channels;
+    bool realtime = (options & RubberBandStretcher::OptionProcessRealTime) != 0;
+
+    // pitch in effect at the first frame, the same as ApplyFreqMap() reached this frame
+    auto freqMapItr = freqMap.upper_bound(seg.readBegin);
+    double pitchScale = param->frequencyshift;
+    if (freqMapItr != freqMap.begin()) {
+        pitchScale *= std::prev(freqMapItr)->second;
+    }
+
+    RubberBandStretcher rb(info.samplerate, channels, options, param->timeratio, pitchScale);
+    if (param->formantscale > 0) {
+        rb.setFormantScale(param->formantscale);
+    }
+    size_t frames = seg.readEnd - seg.readBegin;
+    if (!realtime) {
+        rb.setExpectedInputDuration(frames);
+    }
+    rb.setMaxProcessSize(blockSize);
+
+    ChannelMap channelMap;
+    ChannelMap::Parse(param->channelMap, channels, outChannels, &channelMap);
+
+    // exact output length, so next segment lines up with absolute output frame
+    size_t ideal = outputFrame(seg.readEnd) - outputFrame(seg.readBegin);
+    seg.output.clear();
+    seg.output.reserve(ideal * outChannels);
+
+    RenderLoop loop;
+    loop.Begin(&rb, realtime, channelMap, blockSize, inGain, ideal,
+        [&seg, outChannels](const float* buf, size_t count) {
+            seg.output.insert(seg.output.end(), buf, buf + count * outChannels);
+        });
+
+    size_t countIn = 0;
+    bool isFinal = false;
+    while (!isFinal && !canceled) {
+        size_t at = seg.readBegin + countIn;
+        int thisBlockSize = (int)std::min((size_t)blockSize, frames - countIn);
+        // freq map keys are absolute input frames, split the block at next key like ApplyFreqMap()
+        while (freqMapItr != freqMap.end() && freqMapItr->first <= at) {
+            rb.setPitchScale(param->frequencyshift * freqMapItr->second);
+            ++freqMapItr;
+        }
+        if (freqMapItr != freqMap.end() && freqMapItr->first < at + thisBlockSize) {
+            thisBlockSize = (int)(freqMapItr->first - at);
+        }
+
+        sf_count_t count = sf_readf_float(file, loop.GetInputBuffer(), thisBlockSize);
+        if (count < 0) count = 0;
+        countIn += count;
+        isFinal = (countIn >= frames || count < thisBlockSize);
+        loop.Process((int)count, isFinal);
+    }
+    seg.clipped = loop.IsClipped();
+    sf_close(file);
+    if (canceled) return false;
+
+    // short of ideal only by rounding of stretcher, pad silence to keep alignment
+    if (seg.output.size() < ideal * outChannels) {
+        if (debug > 1) {
+            cerr << "segment at " << seg.begin << " padded " << ideal - seg.output.size() / outChannels << " frames" << endl;
+        }
+        seg.output.resize(ideal * outChannels, 0.f);
+    }
+    return true;
+}
+
+bool
+ParallelRenderer::Render(const std::string& inFile, int outChannels, WriteFn write, ProgressFn progress,
+    size_t *pCountIn, size_t *pCountOut) {
+
+    SF_INFO info;
+    memset(&info, 0, sizeof(SF_INFO));
+    SNDFILE* file = sf_open(inFile.c_str(), SFM_READ, &info);
+    if (!file) {
+        cerr << "ERROR: Failed to open input file \"" << inFile << "\": " << sf_strerror(file) << endl;
+        return false;
+    }
+    if (info.frames <= 0) {
+        cerr << "ERROR: Parallel render requires frame count of input file" << endl;
+        sf_close(file);
+        return false;
+    }
+    std::vector<Segment> segments;
+    planSegments(file, info, segments);
+    sf_close(file);
+
+    canceled = false;
+    std::mutex doneMutex;
+    std::condition_variable doneCond;
+    bool successful = true;
+    bool failed = false;
+    size_t submitted = 0;
+    size_t stitched = 0;
+    size_t written = 0; // absolute output frames
+    std::vector<float> tail; // previous segment samples in its fade range
+    size_t clippedSegments = 0;
+
+    {
+        WorkerPool pool(param->jobs);
+        size_t maxInFlight = (size_t)pool.GetThreadCount() * 2;
+
+        while (stitched < segments.size()) {
+            // keep workers busy but bound the memory of finished segments waiting to be stitched
+            while (submitted < segments.size() && submitted - stitched < maxInFlight) {
+                Segment* seg = &segments[submitted++];
+                pool.Submit([this, seg, &inFile, outChannels, &doneMutex, &doneCond]() {
+                    Trace::SetThreadName("segment worker");
+                    bool ok = renderSegment(inFile, *seg, outChannels);
+                    std::lock_guard<std::mutex> lock(doneMutex);
+                    seg->failed = !ok;
+                    seg->done = true;
+                    doneCond.notify_all();
+                });
+            }
+
+            Segment& seg = segments[stitched];
+            bool done = false;
+            while (!done && !canceled) {
+                {
+                    std::unique_lock<std::mutex> lock(doneMutex);
+                    done = doneCond.wait_for(lock, std::chrono::milliseconds(100), [&seg] { return seg.done; });
+                }
+                // progress callback may poll keyboard, never call it with the lock held
+                if (!done && progress && !progress(seg.begin)) {
+                    canceled = true;
+                }
+            }
+            if (canceled || seg.failed) {
+                failed = seg.failed;
+                canceled = true; // rest of queued segments return early
+                successful = false;
+                break;
+            }
+
+            TRACE_SCOPE("stitch");
+            size_t segStart = outputFrame(seg.readBegin);
+            const float* data = seg.output.data();
+            // crossfade previous tail and head of this segment, gains sum to 1 for correlated signals
+            if (!tail.empty()) {
+                size_t fadeFrames = tail.size() / outChannels;
+                for (size_t i = 0; i < fadeFrames; ++i) {
+                    float w = 0.5f - 0.5f * (float)cos(pi * (i + 0.5) / fadeFrames);
+                    const float* cur = data + (written + i - segStart) * outChannels;
+                    for (int c = 0; c < outChannels; ++c) {
+                        float& s = tail[i * outChannels + c];
+                        s = s * (1.f - w) + cur[c] * w;
+                    }
+                }
+                write(tail.data(), fadeFrames);
+                written += fadeFrames;
+                tail.clear();
+            }
+            if (seg.fadeBegin > written) {
+                write(data + (written - segStart) * outChannels, seg.fadeBegin - written);
+                written = seg.fadeBegin;
+            }
+            if (seg.fadeEnd > seg.fadeBegin) {
+                tail.assign(data + (seg.fadeBegin - segStart) * outChannels, data + (seg.fadeEnd - segStart) * outChannels);
+            }
+            if (seg.clipped) clippedSegments++;
+            // release memory before waiting next one
+            std::vector<float>().swap(seg.output);
+            stitched++;
+
+            if (pCountIn) *pCountIn = seg.end;
+            if (pCountOut) *pCountOut = written;
+            if (progress && !progress(seg.end)) {
+                canceled = true;
+                successful = false;
+                break;
+            }
+        }
+        // pool joins here, canceled segments return early
+    }
+
+    if (clippedSegments > 0) {
+        cerr << "NOTE: Clipping detected in " << clippedSegments << " of " << segments.size()
+            << " segments, clamped (reduce gain to avoid this)" << endl;
+    }
+    if (failed) {
+        cerr << "ERROR: Parallel render failed at segment " << stitched << " of " << segments.size() << endl;
+    }
+    return successful;
+}
+
+} // namespace PitchShifting
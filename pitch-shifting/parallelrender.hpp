@@ -0,0 +1,78 @@
+#pragma once
+/*
+ * offline file to file rendering on multiple cores, input is split into segments (fixed length or nudged to
+ * the quietest point nearby), each segment plus overlap on both sides goes to its own rubberband stretcher
+ * on a worker pool, results are stitched in order with raised cosine crossfades in the middle of the overlaps
+ *   - output position of input frame x is always x * time ratio, so segments never drift from each other
+ *   - frequency map keys are absolute input frames, each segment starts from the pitch in effect at its first frame
+ *   - at most 2 * jobs segments are in memory, finished segments wait for the ones before them
+ * NOTE: output gain can not restart from begin like single stretcher process, clipped samples are clamped
+ */
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#endif
+#include "rubberband/RubberBandStretcher.h"
+#include <sndfile.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "parameters.h"
+
+namespace PitchShifting {
+
+class ParallelRenderer {
+public:
+    /* options are the same as single stretcher, internal threading of rubberband is turned off */
+    ParallelRenderer(Parameters* parameters, RubberBand::RubberBandStretcher::Options options,
+        const std::map<size_t, double>& freqMap, int dbgLevel = 1);
+    virtual ~ParallelRenderer() {}
+
+    // input gain level applied before stretcher, default 1.f
+    void SetInputGain(float val) { inGain = val; }
+    void SetBlockSize(int frames) { blockSize = frames; }
+
+    /* write stitched output frames of outChannels, called in order from the caller thread */
+    typedef std::function<void(const float* buf, size_t frames)> WriteFn;
+    /* progress of stitched input frames, \return false to cancel rendering */
+    typedef std::function<bool(size_t countIn)> ProgressFn;
+    /*
+     * render whole input file with given jobs, blocks until done or cancelled
+     * \return false if input failed or cancelled, pCountIn/pCountOut are frames written so far
+     */
+    bool Render(const std::string& inFile, int outChannels, WriteFn write, ProgressFn progress,
+        size_t *pCountIn, size_t *pCountOut);
+
+private:
+    struct Segment {
+        size_t begin = 0; // owned input range
+        size_t end = 0;
+        size_t readBegin = 0; // input range with overlap
+        size_t readEnd = 0;
+        size_t fadeBegin = 0; // output range crossfaded with next segment
+        size_t fadeEnd = 0;
+        std::vector<float> output; // interleaved from output frame of readBegin
+        bool clipped = false;
+        bool done = false; // guarded by mutex in Render()
+        bool failed = false;
+    };
+
+    // output frame of input frame, the same truncation as realtime mode ideal output
+    size_t outputFrame(size_t inputFrame) const { return size_t(inputFrame * param->timeratio); }
+    void planSegments(SNDFILE* file, const SF_INFO& info, std::vector<Segment>& segments);
+    size_t quietestFrame(SNDFILE* file, const SF_INFO& info, size_t from, size_t to);
+    bool renderSegment(const std::string& inFile, Segment& seg, int outChannels);
+
+    int debug;
+    Parameters* param;
+    RubberBand::RubberBandStretcher::Options options;
+    const std::map<size_t, double>& freqMap;
+    float inGain = 1.f;
+    int blockSize = 1024;
+    std::atomic<bool> canceled{ false };
+};
+
+} // namespace PitchShifting
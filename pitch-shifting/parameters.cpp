@@ -10,6 +10,8 @@
 
 // for param check or print usage
 #include "helper.hpp"
+// to validate autotune scale and key
+#include "autotune.hpp"
 /* to show version */
 #include "rubberband/RubberBandStretcher.h"
 
@@ -84,6 +86,43 @@ int Parameters::ParseOptions(int c, char** v)
             { "list-device",   0, 0, 'l' },
             { "input-gain",    1, 0, 'g' },
             { "gui",           0, 0, 'U' },
+            { "channel-map",   1, 0, 'm' },
+            { "virtual-rate",  1, 0, 'v' },
+            { "virtual-jitter", 1, 0, 'j' },
+            { "virtual-seconds", 1, 0, 's' },
+            { "trace",         1, 0, 'e' },
+            { "jobs",          1, 0, 'J' },
+            { "segment-seconds", 1, 0, 'S' },
+            { "segment-overlap", 1, 0, 'O' },
+            { "split-silence", 0, 0, 'Z' },
+            { "batch",         1, 0, 'B' },
+            { "batch-out",     1, 0, 'b' },
+            { "read-ahead",    1, 0, 'A' },
+            { "write-behind",  1, 0, 'W' },
+            { "no-mmap",       0, 0, 'N' },
+            { "peak-cache",    1, 0, 'K' },
+            { "scan-dir",      1, 0, 'Y' },
+            { "scan-recursive", 0, 0, 'y' },
+            { "scan-ext",      1, 0, 'X' },
+            { "output-rate",   1, 0, 'r' },
+            { "resample-quality", 1, 0, 'k' },
+            { "low-latency",   0, 0, 'u' },
+            { "callback-frames", 1, 0, 'w' },
+            { "ring-blocks",   1, 0, 'x' },
+            { "preroll",       1, 0, 'z' },
+            { "measure-latency", 0, 0, 'E' },
+            { "psola",         0, 0, 'G' },
+            { "psola-min-f0",  1, 0, 'I' },
+            { "pitch-track",   0, 0, 'a' },
+            { "autotune",      1, 0, 'n' },
+            { "autotune-key",  1, 0, 'o' },
+            { "retune-speed",  1, 0, '4' },
+            { "envelope-csv",  1, 0, '$' },
+            { "envelope-cutoff", 1, 0, '^' },
+            { "envelope-rate", 1, 0, '&' },
+            { "analyze",       1, 0, '!' },
+            { "analyze-target", 1, 0, '#' },
+            { "analyze-range", 1, 0, '*' },
             { 0, 0, 0, 0 }
         };
 
@@ -140,6 +179,43 @@ int Parameters::ParseOptions(int c, char** v)
         case 'l': listdev = true; break;
         case 'g': inputgaindb = atof(optarg); break;
         case 'U': gui = true; break;
+        case 'm': channelMap = optarg; break;
+        case 'v': virtualRate = atof(optarg); break;
+        case 'j': virtualJitterMs = atof(optarg); break;
+        case 's': virtualSeconds = atof(optarg); break;
+        case 'e': traceFile = optarg; break;
+        case 'J': jobs = atoi(optarg); break;
+        case 'S': segmentSeconds = atof(optarg); break;
+        case 'O': segmentOverlap = atof(optarg); break;
+        case 'Z': splitSilence = true; break;
+        case 'B': batchPath = optarg; haveRatio = true; break; // manifest may give ratios per file
+        case 'b': batchOutDir = optarg; break;
+        case 'A': readAhead = atoi(optarg); break;
+        case 'W': writeBehind = atoi(optarg); break;
+        case 'N': mmapInput = false; break;
+        case 'K': peakCacheDir = optarg; break;
+        case 'Y': scanDir = optarg; break;
+        case 'y': scanRecursive = true; break;
+        case 'X': scanExtensions = optarg; break;
+        case 'r': outputRate = atoi(optarg); break;
+        case 'k': resampleQuality = optarg; break;
+        case 'u': lowLatency = true; break;
+        case 'w': callbackFrames = atoi(optarg); break;
+        case 'x': ringBlocks = atoi(optarg); break;
+        case 'z': prerollFrames = atoi(optarg); break;
+        case 'E': measureLatency = true; break;
+        case 'G': psola = true; break;
+        case 'I': psolaMinF0 = atof(optarg); break;
+        case 'a': pitchTrack = true; break;
+        case 'n': autotuneScale = optarg; haveRatio = true; break;
+        case 'o': autotuneKey = optarg; break;
+        case '4': retuneMs = atof(optarg); break;
+        case '$': envelopeCsv = optarg; break;
+        case '^': envelopeCutoffMs = atof(optarg); break;
+        case '&': envelopeRate = atof(optarg); break;
+        case '!': analyzeMap = optarg; haveRatio = true; break; // map is the result, no ratio required
+        case '#': analyzeTarget = atof(optarg); break;
+        case '*': analyzeRange = atof(optarg); break;
         default:  help = true; break;
         }
     }
@@ -154,6 +230,68 @@ int Parameters::ParseOptions(int c, char** v)
         return 0;
     }
 
+    // small callbacks only make sense if rubberband does not buffer the whole input
+    if (lowLatency) {
+        realtime = true;
+        if (callbackFrames <= 0) callbackFrames = 256;
+        if (ringBlocks <= 0) ringBlocks = 4;
+    }
+    if (callbackFrames < 0 || callbackFrames > 16384) {
+        cerr << "ERROR: Invalid callback frames " << callbackFrames << endl;
+        return 1;
+    }
+    if (psola && (psolaMinF0 < 40.0 || psolaMinF0 > 500.0)) {
+        cerr << "ERROR: Invalid psola min f0 " << psolaMinF0 << ", expected 40 to 500 Hz" << endl;
+        return 1;
+    }
+    if (envelopeCutoffMs <= 0.0 || envelopeCutoffMs > 20.0) {
+        cerr << "ERROR: Invalid envelope cutoff " << envelopeCutoffMs << ", expected 0 to 20 ms" << endl;
+        return 1;
+    }
+    if (envelopeRate < 1.0 || envelopeRate > 1000.0) {
+        cerr << "ERROR: Invalid envelope rate " << envelopeRate << ", expected 1 to 1000 frames per second" << endl;
+        return 1;
+    }
+    if (segmentSeconds <= 0.0) {
+        cerr << "ERROR: Invalid segment seconds " << segmentSeconds << ", expected greater than 0" << endl;
+        return 1;
+    }
+    if (segmentOverlap < 0.0 || segmentOverlap >= segmentSeconds) {
+        cerr << "ERROR: Invalid segment overlap " << segmentOverlap << ", expected 0 to less than segment seconds " << segmentSeconds << endl;
+        return 1;
+    }
+    if (!analyzeMap.empty()) {
+        if (analyzeTarget != 0.0 && (analyzeTarget < 40.0 || analyzeTarget > 2000.0)) {
+            cerr << "ERROR: Invalid analyze target " << analyzeTarget << ", expected 40 to 2000 Hz" << endl;
+            return 1;
+        }
+        if (analyzeRange < 0.0 || analyzeRange > 4.0) {
+            cerr << "ERROR: Invalid analyze range " << analyzeRange << ", expected 0 to 4" << endl;
+            return 1;
+        }
+    }
+    if (ringBlocks == 1) {
+        cerr << "WARNING: Ring buffers need at least 2 blocks, use 2" << endl;
+        ringBlocks = 2;
+    }
+
+    // pitch scale changes every block, which rubberband only accepts in realtime mode
+    if (!autotuneScale.empty()) {
+        if (freqOrPitchMapSpecified) {
+            cerr << "ERROR: Please specify either autotune or pitch/frequency map, not both" << endl;
+            return 1;
+        }
+        if (retuneMs < 0.0) {
+            cerr << "ERROR: Invalid retune speed " << retuneMs << endl;
+            return 1;
+        }
+        if (!AutoTune::ParseScale(autotuneScale, autotuneKey)) {
+            cerr << "ERROR: Unknown autotune scale \"" << autotuneScale << "\" or key \"" << autotuneKey << "\"" << endl;
+            return 1;
+        }
+        realtime = true;
+    }
+
     if (freqOrPitchMapSpecified) {
         if (freqMapFile != "" && pitchMapFile != "") {
             cerr << "ERROR: Please specify either pitch map or frequency map, not both" << endl;
@@ -226,7 +364,10 @@ int Parameters::ParseOptions(int c, char** v)
     typewin = (shortwin) ? 1 : (longwin) ? 2 : 0/*standard*/;
 
     if (!quiet) {
-        if (finer) {
+        if (psola) {
+            cerr << "Using TD-PSOLA engine, latency of " << (1000.0 / psolaMinF0) << "ms period at min f0" << endl;
+        }
+        else if (finer) {
             if (shortwin) {
                 cerr << "Using intermediate R3 (finer) single-windowed engine" << endl;
             }
@@ -255,7 +396,12 @@ int Parameters::ParseOptions(int c, char** v)
 
 int Parameters::ResolveArguments()
 {
-    if (checkNumuric(inAudioParam, &inDeviceIdx)) {
+    const std::string virtualPrefix = "virtual:";
+    if (virtualPrefix.compare(0, virtualPrefix.size(), inAudioParam, 0, virtualPrefix.size()) == 0) {
+        inVirtualSpec = std::string(inAudioParam + virtualPrefix.size());
+        inAudioType = 3;// SourceType::AudioVirtual
+    }
+    else if (checkNumuric(inAudioParam, &inDeviceIdx)) {
         inAudioType = 2;// SourceType::AudioDevice
     }
     else {
@@ -269,7 +415,11 @@ int Parameters::ResolveArguments()
             }
         }
     }
-    if (checkNumuric(outAudioParam, &outDeviceIdx)) {
+    if (virtualPrefix.compare(0, virtualPrefix.size(), outAudioParam, 0, virtualPrefix.size()) == 0) {
+        outVirtualSpec = std::string(outAudioParam + virtualPrefix.size());
+        outAudioType = 3;// SourceType::AudioVirtual
+    }
+    else if (checkNumuric(outAudioParam, &outDeviceIdx)) {
         outAudioType = 2;// SourceType::AudioDevice
     }
     else {
@@ -32,6 +32,9 @@ public:
     int crispness = -1;
     bool faster = false;
     bool finer = false;
+    // TD-PSOLA engine instead of rubberband, refer to PitchShifting::PsolaStretcher
+    bool psola = false;
+    double psolaMinF0 = 120.0; // lowest tracked pitch in Hz, sets the engine latency
     bool help = false;
     bool fullHelp = false;
     bool version = false;
@@ -50,6 +53,55 @@ public:
     int detector = 0;/*CompoundDetector*/
 
     bool ignoreClipping = false;
+    // output channel routing, refer to PitchShifting::ChannelMap, empty for default
+    std::string channelMap;
+    // chrome trace json output of process stages, empty for disabled
+    std::string traceFile;
+    // offline file to file segments rendered in parallel if more than 1 job, refer to PitchShifting::ParallelRenderer
+    int jobs = 1;
+    double segmentSeconds = 30.0;
+    double segmentOverlap = 1.0; // seconds on each side of segment boundary
+    bool splitSilence = false; // move boundary to the quietest point nearby
+    // batch mode of a directory or manifest file instead of single input/output, refer to PitchShifting::BatchProcessor
+    std::string batchPath;
+    std::string batchOutDir; // empty for name.out.ext next to input files
+    // blocks decoded ahead by input file reader thread, 0 reads on stretcher thread
+    int readAhead = 8;
+    // blocks queued for output file writer thread, 0 writes on stretcher thread
+    int writeBehind = 16;
+    // process int16/int24/float32 wav input from memory mapped file instead of sndfile
+    bool mmapInput = true;
+    // local library cache of file info and waveform peaks, empty to disable, refer to PitchShifting::PeakCache
+    std::string peakCacheDir = ".peakcache";
+    // local audio files for source list, refer to PitchShifting::FileScanner
+    std::string scanDir = ".";
+    bool scanRecursive = false;
+    std::string scanExtensions; // comma separated, empty for any file sndfile can read
+    // output file or device sample rate, 0 follows input for file and default rate for device,
+    // other rate than input is converted, refer to PitchShifting::Resampler
+    int outputRate = 0;
+    std::string resampleQuality = "medium"; // fast, medium or best
+    // device stream latency profile, low latency implies realtime and small callbacks/rings if not given
+    bool lowLatency = false;
+    int callbackFrames = 0; // frames per device callback and stretcher block, 0 for default 1024 (256 if low latency)
+    int ringBlocks = 0; // in/out ring buffers hold this many blocks, 0 for default reserve (4 if low latency)
+    int prerollFrames = -1; // output silence until this many frames are buffered, -1 sized from rubberband latency
+    // inject impulse at input and detect it at output, reports adc to dac time periodically
+    bool measureLatency = false;
+    // f0 tracking of input and output without GUI (GUI always tracks), printed with debug stats
+    bool pitchTrack = false;
+    // pitch correction to a scale from tracked f0, empty to disable, refer to PitchShifting::AutoTune
+    std::string autotuneScale;
+    std::string autotuneKey = "C";
+    double retuneMs = 50.0; // time constant of correction, 0 snaps instantly
+    // spectral envelope of input by cepstrum, refer to PitchShifting::EnvelopeAnalyzer, GUI always analyzes
+    std::string envelopeCsv; // export envelope frames if given
+    double envelopeCutoffMs = 1.5; // lifter quefrency, lower is smoother
+    double envelopeRate = 50.0; // frames per second
+    // analysis pass writes frequency map of input file instead of rendering, refer to PitchShifting::MapAnalyzer
+    std::string analyzeMap;
+    double analyzeTarget = 0.0; // Hz median f0 moves to, 0 keeps median
+    double analyzeRange = 1.0; // contour scale around median, 1 keeps prosody, 0 flattens
 
     std::string myName;
     bool isR3;
@@ -60,10 +112,19 @@ public:
     std::string outFilePath;
     std::string inFileExt;
     std::string outFileExt;
-    int inAudioType = 0;/*0=unknown, 1=file, 2=device, refer to PitchShifting::SourceType*/
+    int inAudioType = 0;/*0=unknown, 1=file, 2=device, 3=virtual device, refer to PitchShifting::SourceType*/
     int outAudioType = 0;
     int inDeviceIdx = -1;/*integer type of inAudioParam if CLI given port audio device index*/
     int outDeviceIdx = -1;
+    std::string inVirtualSpec;/*spec after "virtual:" prefix if CLI given virtual device*/
+    std::string outVirtualSpec;
+    // virtual device clock, 1.0 is wall clock, 0 is as fast as possible
+    double virtualRate = 1.0;
+    double virtualJitterMs = 0.0;
+    // synthetic input signal duration, 0 for infinite
+    double virtualSeconds = 10.0;
+    int virtualSampleRate = 48000;
+    int virtualChannels = 2;
 
     int typewin = 0;/*0=OptionWindowStandard*/
 
@@ -0,0 +1,212 @@
+#include "peakcache.hpp"
+#include "trace.hpp"
+#include <sndfile.h>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+using std::cerr;
+using std::endl;
+
+namespace PitchShifting {
+
+static const char* indexHeader = "# peak cache index v1";
+
+PeakCache::PeakCache(const std::string& cacheDir) : dir(cacheDir) {
+    if (dir.empty()) return;
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec) {
+        cerr << "WARNING: Can not create peak cache directory " << dir << ": " << ec.message() << endl;
+    }
+    indexFile = (fs::path(dir) / "index.txt").string();
+    load();
+}
+
+PeakCache::~PeakCache() {
+    {
+        std::lock_guard<std::mutex> guard(jobsLock);
+        quit = true;
+        // unfinished jobs are dropped, their peaks are rebuilt next time
+        pendingJobs -= (int)jobs.size();
+        jobs.clear();
+    }
+    jobsCond.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+    Save();
+}
+
+bool
+PeakCache::GetFileStamp(const std::string& path, uint64_t* size, int64_t* mtime) {
+    std::error_code ec;
+    auto fileSize = fs::file_size(path, ec);
+    if (ec) return false;
+    auto writeTime = fs::last_write_time(path, ec);
+    if (ec) return false;
+    if (size) *size = (uint64_t)fileSize;
+    if (mtime) *mtime = (int64_t)writeTime.time_since_epoch().count();
+    return true;
+}
+
+std::string
+PeakCache::makeKey(const std::string& path) {
+    std::error_code ec;
+    auto abs = fs::absolute(path, ec);
+    if (ec) return path;
+    return abs.lexically_normal().string();
+}
+
+void
+PeakCache::load() {
+    std::ifstream in(indexFile);
+    if (!in) return;
+    std::string line;
+    if (!std::getline(in, line) || line != indexHeader) {
+        cerr << "NOTE: Peak cache index " << indexFile << " is unknown version, rebuilding" << endl;
+        return;
+    }
+    std::lock_guard<std::mutex> guard(entriesLock);
+    while (std::getline(in, line)) {
+        // size mtime samplerate channels frames format path, tab separated, path may contain spaces
+        std::istringstream fields(line);
+        PeakCacheEntry entry;
+        std::string path;
+        if (!(fields >> entry.size >> entry.mtime >> entry.sampleRate >> entry.channels >> entry.frames >> entry.format)) {
+            continue;
+        }
+        if (fields.get() != '\t' || !std::getline(fields, path) || path.empty()) {
+            continue;
+        }
+        entries[path] = entry;
+    }
+}
+
+void
+PeakCache::Save() {
+    if (!IsEnabled()) return;
+    std::lock_guard<std::mutex> guard(entriesLock);
+    if (!dirty) return;
+    std::error_code ec;
+    // write aside and replace, a crash never leaves a truncated index
+    std::string tmpFile = indexFile + ".tmp";
+    {
+        std::ofstream out(tmpFile, std::ios::trunc);
+        if (!out) {
+            cerr << "WARNING: Can not write peak cache index " << indexFile << endl;
+            return;
+        }
+        out << indexHeader << "\n";
+        for (const auto& it : entries) {
+            const auto& e = it.second;
+            out << e.size << "\t" << e.mtime << "\t" << e.sampleRate << "\t" << e.channels << "\t"
+                << e.frames << "\t" << e.format << "\t" << it.first << "\n";
+        }
+    }
+    fs::rename(tmpFile, indexFile, ec);
+    if (ec) {
+        cerr << "WARNING: Can not replace peak cache index " << indexFile << ": " << ec.message() << endl;
+        return;
+    }
+    dirty = false;
+}
+
+bool
+PeakCache::Lookup(const std::string& path, PeakCacheEntry* entry) {
+    if (!IsEnabled()) return false;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    if (!GetFileStamp(path, &size, &mtime)) return false;
+    std::lock_guard<std::mutex> guard(entriesLock);
+    auto it = entries.find(makeKey(path));
+    if (it == entries.end() || it->second.size != size || it->second.mtime != mtime) {
+        return false;
+    }
+    if (entry) *entry = it->second;
+    return true;
+}
+
+bool
+PeakCache::Probe(const std::string& path, PeakCacheEntry* entry) {
+    PeakCacheEntry probed;
+    if (!GetFileStamp(path, &probed.size, &probed.mtime)) return false;
+    SF_INFO sfinfo;
+    memset(&sfinfo, 0, sizeof(SF_INFO));
+    auto sf = sf_open(path.c_str(), SFM_READ, &sfinfo);
+    if (sf) {
+        probed.sampleRate = sfinfo.samplerate;
+        probed.channels = sfinfo.channels;
+        probed.frames = sfinfo.frames;
+        probed.format = sfinfo.format;
+        sf_close(sf);
+    }
+    if (entry) *entry = probed;
+    if (IsEnabled()) {
+        std::lock_guard<std::mutex> guard(entriesLock);
+        entries[makeKey(path)] = probed;
+        dirty = true;
+    }
+    return true;
+}
+
+bool
+PeakCache::GetInfo(const std::string& path, PeakCacheEntry* entry) {
+    if (Lookup(path, entry)) return true;
+    return Probe(path, entry);
+}
+
+std::string
+PeakCache::GetPeakFile(const std::string& path) const {
+    if (!IsEnabled()) return std::string();
+    // FNV-1a of key names the sidecar, collisions are caught by the stamp stored in it
+    std::string key = makeKey(path);
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.peaks", (unsigned long long)hash);
+    return (fs::path(dir) / name).string();
+}
+
+void
+PeakCache::Enqueue(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> guard(jobsLock);
+        if (quit) return;
+        jobs.push_back(std::move(job));
+        pendingJobs++;
+        if (!thread.joinable()) {
+            thread = std::thread(&PeakCache::run, this);
+        }
+    }
+    jobsCond.notify_one();
+}
+
+void
+PeakCache::run() {
+    Trace::SetThreadName("peak cache");
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(jobsLock);
+            jobsCond.wait(lock, [this] { return quit || !jobs.empty(); });
+            if (quit) break;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        {
+            TRACE_SCOPE("peak cache job");
+            job();
+        }
+        pendingJobs--;
+    }
+}
+
+} // namespace PitchShifting
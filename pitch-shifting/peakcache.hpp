@@ -0,0 +1,84 @@
+#pragma once
+/*
+ * central cache of local audio library, lives in a directory (default .peakcache of working directory)
+ *   - index file keeps sound file info per path, entries are valid while file size and mtime are unchanged,
+ *     files sndfile can not read are remembered too, so a listing never opens them again
+ *   - sidecar files in cache directory keep waveform peaks per path, written and read by the waveform overview
+ *   - stale peaks are rebuilt by jobs on a single background thread, in order of requests
+ * NOTE: empty directory disables the cache, lookups always miss and nothing is written
+ */
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace PitchShifting {
+
+struct PeakCacheEntry {
+    // stamp of the file when the entry was probed
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    // 0 if sndfile can not read the file
+    int sampleRate = 0;
+    int channels = 0;
+    int64_t frames = 0;
+    int format = 0;
+};
+
+class PeakCache {
+public:
+    explicit PeakCache(const std::string& dir);
+    virtual ~PeakCache();
+    PeakCache(const PeakCache&) = delete;
+    PeakCache& operator=(const PeakCache&) = delete;
+
+    bool IsEnabled() const { return !dir.empty(); }
+    const std::string& GetDirectory() const { return dir; }
+
+    /* size and last write time of given file, \return false if file does not exist */
+    static bool GetFileStamp(const std::string& path, uint64_t* size, int64_t* mtime);
+
+    /* cached info if entry matches current file stamp, \return false for missing or stale entry */
+    bool Lookup(const std::string& path, PeakCacheEntry* entry);
+    /* read file header via sndfile and update entry, \return false if file does not exist */
+    bool Probe(const std::string& path, PeakCacheEntry* entry);
+    /* Lookup() or Probe() if entry is stale */
+    bool GetInfo(const std::string& path, PeakCacheEntry* entry);
+    /* write index file if entries were changed */
+    void Save();
+
+    /* sidecar file name for peaks of given path, empty if cache is disabled */
+    std::string GetPeakFile(const std::string& path) const;
+
+    /* run job on background thread after previous jobs, thread is started on first job */
+    void Enqueue(std::function<void()> job);
+    /* jobs queued or running */
+    int GetPendingJobs() const { return pendingJobs.load(); }
+
+private:
+    void load();
+    void run();
+    // absolute normalized path as key, the same file is one entry for any relative form
+    static std::string makeKey(const std::string& path);
+
+    std::string dir;
+    std::string indexFile;
+
+    std::mutex entriesLock;
+    std::map<std::string, PeakCacheEntry> entries;
+    bool dirty = false;
+
+    std::mutex jobsLock;
+    std::condition_variable jobsCond;
+    std::deque<std::function<void()>> jobs;
+    std::thread thread;
+    bool quit = false;
+    std::atomic<int> pendingJobs{ 0 };
+};
+
+} // namespace PitchShifting
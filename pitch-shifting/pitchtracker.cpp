@@ -0,0 +1,207 @@
+#include "pitchtracker.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace PitchShifting {
+
+// analysis rate, enough for voice pitch and small transforms
+static const double analysisRate = 12000.0;
+static const double hopSeconds = 0.01;
+// cumulative mean normalized difference below it is periodic
+static const float voicedThreshold = 0.15f;
+// hops analyzed per Process() call at most, the older ones of a large block are skipped
+static const int maxHopsPerCall = 16;
+
+PitchSeries::PitchSeries(size_t capacity) {
+    size_t storage = 1;
+    while (storage < capacity) storage <<= 1;
+    mask = storage - 1;
+    slots.reset(new Slot[storage]);
+}
+
+void
+PitchSeries::Push(const PitchPoint& point) {
+    uint64_t n = count.load(std::memory_order_relaxed);
+    Slot& slot = slots[n & mask];
+    // pairs with the fence of Read(), a reader seeing any store below also sees count of at least n
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.time.store(point.time, std::memory_order_relaxed);
+    slot.f0.store(point.f0, std::memory_order_relaxed);
+    slot.confidence.store(point.confidence, std::memory_order_relaxed);
+    count.store(n + 1, std::memory_order_release);
+}
+
+size_t
+PitchSeries::Read(uint64_t* cursor, PitchPoint* out, size_t max) const {
+    uint64_t end = count.load(std::memory_order_acquire);
+    uint64_t capacity = mask + 1;
+    uint64_t from = *cursor;
+    if (from > end) from = end;
+    if (end - from > capacity) from = end - capacity;
+    if (end - from > max) end = from + max;
+    for (uint64_t i = from; i < end; ++i) {
+        const Slot& slot = slots[i & mask];
+        PitchPoint& p = out[i - from];
+        p.time = slot.time.load(std::memory_order_relaxed);
+        p.f0 = slot.f0.load(std::memory_order_relaxed);
+        p.confidence = slot.confidence.load(std::memory_order_relaxed);
+    }
+    // producer may have lapped the oldest copied slots meanwhile, drop them,
+    // fence keeps the slot loads above before the count reload (seqlock style)
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t after = count.load(std::memory_order_relaxed);
+    size_t copied = (size_t)(end - from);
+    // slot of point `after` may be in the middle of a write, so point after - capacity is lost too
+    if (after >= from + capacity) {
+        size_t lost = (size_t)std::min<uint64_t>(after - capacity - from + 1, copied);
+        std::move(out + lost, out + copied, out);
+        copied -= lost;
+    }
+    *cursor = end;
+    return copied;
+}
+
+bool
+PitchSeries::GetLatest(PitchPoint* out) const {
+    uint64_t n = count.load(std::memory_order_acquire);
+    if (n == 0) return false;
+    uint64_t cursor = n - 1;
+    return Read(&cursor, out, 1) == 1;
+}
+
+PitchTracker::PitchTracker() {
+}
+
+bool
+PitchTracker::Prepare(int rate, double minF0, double maxF0) {
+    if (rate <= 0 || minF0 <= 0.0 || maxF0 <= minF0) return false;
+    sampleRate = rate;
+    decimation = std::max(1, (int)lround(rate / analysisRate));
+    double decimatedRate = (double)rate / decimation;
+    minLag = std::max(2, (int)(decimatedRate / maxF0));
+    maxLag = std::max(minLag + 2, (int)ceil(decimatedRate / minF0));
+    window = maxLag + 1;
+    hop = std::min(window, std::max(1, (int)lround(decimatedRate * hopSeconds)));
+
+    int size = Fft::NextPowerOfTwo(window * 2);
+    if (!fft || fft->GetSize() != size) {
+        fft.reset(new Fft(size));
+    }
+    specRe.assign(size, 0.f);
+    specIm.assign(size, 0.f);
+    winRe.assign(size, 0.f);
+    winIm.assign(size, 0.f);
+    cmnd.assign(window + 1, 1.f);
+    Reset();
+    return true;
+}
+
+void
+PitchTracker::Reset() {
+    history.assign((size_t)window * 2, 0.f);
+    decimateSum = 0.f;
+    decimateCount = 0;
+    sinceHop = 0;
+    framesIn = 0;
+}
+
+void
+PitchTracker::Process(const float* const* channels, int channelCount, size_t frames) {
+    if (sampleRate <= 0 || channelCount <= 0) return;
+    TRACE_SCOPE("pitch track");
+    float gain = 1.f / channelCount;
+    // hops before it would be overwritten by later hops of the same block
+    int64_t analyzeFrom = framesIn + (int64_t)frames - (int64_t)maxHopsPerCall * hop * decimation;
+    size_t length = history.size();
+    for (size_t i = 0; i < frames; ++i) {
+        float mono = 0.f;
+        for (int c = 0; c < channelCount; ++c) mono += channels[c][i];
+        decimateSum += mono * gain;
+        framesIn++;
+        if (++decimateCount < decimation) continue;
+        // history is shifted by hops, not by samples
+        history[length - hop + sinceHop] = decimateSum / decimation;
+        decimateSum = 0.f;
+        decimateCount = 0;
+        if (++sinceHop < hop) continue;
+        sinceHop = 0;
+        // skipped hops leave a gap in series rather than unvoiced points
+        if (framesIn >= analyzeFrom) {
+            analyze();
+        }
+        std::move(history.begin() + hop, history.end(), history.begin());
+    }
+}
+
+void
+PitchTracker::analyze() {
+    int size = fft->GetSize();
+    int w = window;
+    const float* a = history.data();
+    PitchPoint point;
+    point.time = (double)framesIn / sampleRate;
+
+    float energy = 0.f;
+    for (int j = 0; j < w; ++j) energy += a[j] * a[j];
+    if (energy < 1e-7f * w) {
+        series.Push(point);
+        return;
+    }
+
+    // whole window in real part, its first half in imaginary part, one transform for both
+    for (int j = 0; j < size; ++j) {
+        specRe[j] = j < w * 2 ? a[j] : 0.f;
+        specIm[j] = j < w ? a[j] : 0.f;
+    }
+    fft->Forward(specRe.data(), specIm.data());
+    for (int k = 0; k < size; ++k) {
+        int m = (size - k) & (size - 1);
+        float ar = 0.5f * (specRe[k] + specRe[m]);
+        float ai = 0.5f * (specIm[k] - specIm[m]);
+        float br = 0.5f * (specIm[k] + specIm[m]);
+        float bi = -0.5f * (specRe[k] - specRe[m]);
+        // conj(first half) * whole, cross-correlation r(lag) = sum a[j] * a[j + lag] for j < window
+        winRe[k] = br * ar + bi * ai;
+        winIm[k] = br * ai - bi * ar;
+    }
+    fft->Inverse(winRe.data(), winIm.data());
+
+    // d(lag) = energy of both halves - 2 r(lag), normalized by its cumulative mean
+    float shifted = energy;
+    double cumulative = 0.0;
+    int found = 0;
+    int best = minLag;
+    for (int lag = 1; lag <= maxLag; ++lag) {
+        shifted += a[lag + w - 1] * a[lag + w - 1] - a[lag - 1] * a[lag - 1];
+        float d = std::max(0.f, energy + shifted - 2.f * winRe[lag]);
+        cumulative += d;
+        cmnd[lag] = cumulative > 0.0 ? (float)(d * lag / cumulative) : 1.f;
+        if (lag < minLag || found) continue;
+        if (cmnd[lag] < cmnd[best]) best = lag;
+        if (cmnd[lag] < voicedThreshold) found = lag;
+    }
+    // walk to the bottom of the first dip
+    while (found && found < maxLag && cmnd[found + 1] < cmnd[found]) found++;
+    int lag = found ? found : best;
+    point.confidence = std::min(1.f, std::max(0.f, 1.f - cmnd[lag]));
+    if (found) {
+        double refined = lag;
+        if (lag > 1 && lag < maxLag) {
+            double x0 = cmnd[lag - 1], x1 = cmnd[lag], x2 = cmnd[lag + 1];
+            double den = x0 - 2 * x1 + x2;
+            if (den > 0.0) refined += 0.5 * (x0 - x2) / den;
+        }
+        point.f0 = (float)((double)sampleRate / decimation / refined);
+    }
+    series.Push(point);
+}
+
+PitchPoint
+PitchTracker::GetLatest() const {
+    PitchPoint point;
+    series.GetLatest(&point);
+    return point;
+}
+
+} // namespace PitchShifting
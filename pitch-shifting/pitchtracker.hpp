@@ -0,0 +1,106 @@
+#pragma once
+/*
+ * streaming fundamental frequency tracker (yin) on stretcher input or output blocks
+ *   - channels are mixed to mono and averaged down to ~12kHz analysis rate
+ *   - every hop (10ms) the difference function of the latest window comes from an fft cross-correlation,
+ *     cumulative mean normalized, the first dip below threshold is the period (parabolic refined)
+ *   - per Process() call at most a few hops are analyzed, a large block skips the older hops
+ *     so the cost per block stays bounded
+ *   - results go to PitchSeries, lock-free for GUI or any other reader thread
+ * NOTE: Process() and Reset() are called by one thread (stretcher thread)
+ */
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "fft.hpp"
+
+namespace PitchShifting {
+
+struct PitchPoint {
+    double time = 0.0; // seconds of stream at the end of analysis window
+    float f0 = 0.f; // Hz, 0 if unvoiced or silent
+    float confidence = 0.f; // 0 to 1, periodicity of the window
+};
+
+/*
+ * single producer ring of pitch points, readers copy without blocking the producer,
+ * points overwritten while a reader copies them are dropped for that reader
+ */
+class PitchSeries {
+public:
+    /* capacity is rounded up to power of 2 */
+    explicit PitchSeries(size_t capacity = 4096);
+    virtual ~PitchSeries() {}
+    PitchSeries(const PitchSeries&) = delete;
+    PitchSeries& operator=(const PitchSeries&) = delete;
+
+    /* producer only */
+    void Push(const PitchPoint& point);
+    /* total points pushed, index of the next one */
+    uint64_t GetCount() const { return count.load(std::memory_order_acquire); }
+    size_t GetCapacity() const { return mask + 1; }
+
+    /* copy up to max points from *cursor (0 for the oldest kept), cursor moves past copied points,
+     * \return points copied */
+    size_t Read(uint64_t* cursor, PitchPoint* out, size_t max) const;
+    /* latest point, \return false if none yet */
+    bool GetLatest(PitchPoint* out) const;
+
+private:
+    struct Slot {
+        std::atomic<double> time{ 0.0 };
+        std::atomic<float> f0{ 0.f };
+        std::atomic<float> confidence{ 0.f };
+    };
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    std::atomic<uint64_t> count{ 0 };
+};
+
+class PitchTracker {
+public:
+    PitchTracker();
+    virtual ~PitchTracker() {}
+    PitchTracker(const PitchTracker&) = delete;
+    PitchTracker& operator=(const PitchTracker&) = delete;
+
+    /* start a new stream, series keeps its points and counts on */
+    bool Prepare(int sampleRate, double minF0 = 60.0, double maxF0 = 1000.0);
+    void Reset();
+    bool IsPrepared() const { return sampleRate > 0; }
+
+    /* per channel blocks of frames, eg. stretcher cbuf */
+    void Process(const float* const* channels, int channelCount, size_t frames);
+
+    const PitchSeries* GetSeries() const { return &series; }
+    /* the latest estimate, f0 0 if unvoiced */
+    PitchPoint GetLatest() const;
+
+private:
+    // analyze the window ending at the newest decimated sample
+    void analyze();
+
+    int sampleRate = 0;
+    int decimation = 1;
+    int minLag = 2;
+    int maxLag = 2;
+    int window = 0; // correlation length in decimated samples, also the longest lag
+    int hop = 0; // decimated samples between analyses
+
+    // decimated mono history of 2 * window, newest at the end
+    std::vector<float> history;
+    float decimateSum = 0.f;
+    int decimateCount = 0;
+    int sinceHop = 0;
+    int64_t framesIn = 0;
+
+    std::unique_ptr<Fft> fft;
+    std::vector<float> specRe, specIm, winRe, winIm;
+    std::vector<float> cmnd;
+
+    PitchSeries series;
+};
+
+} // namespace PitchShifting
@@ -0,0 +1,344 @@
+#include "psola.hpp"
+#include "kernels.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace PitchShifting {
+
+static const double pi = 3.14159265358979323846;
+// highest pitch tracked, shortest lag of difference function
+static const double maxF0 = 1000.0;
+// analysis rate of period estimate, enough for voice pitch and cheap for the lag search
+static const double analysisRate = 12000.0;
+// cumulative mean normalized difference below it is periodic
+static const float voicedThreshold = 0.2f;
+// marks snap to waveform peak within this part of period around the expected position
+static const double snapRange = 0.125;
+static const int windowTableSize = 4096;
+// input frames dropped at once, keeps erase of history amortized
+static const int64_t compactFrames = 4096;
+
+PsolaStretcher::PsolaStretcher(size_t sampleRate, size_t channels, double timeRatio, double pitchScale, double minF0)
+    : sampleRate(sampleRate), channels(channels), timeRatio(timeRatio), pitchScale(pitchScale) {
+    if (minF0 < 40.0) minF0 = 40.0;
+    if (minF0 > maxF0 / 2) minF0 = maxF0 / 2;
+    maxPeriod = (double)sampleRate / minF0;
+    minPeriod = (double)sampleRate / maxF0;
+    unvoicedPeriod = maxPeriod / 2;
+    decimation = std::max(1, (int)lround(sampleRate / analysisRate));
+    lastPeriod = unvoicedPeriod;
+
+    // half of hann from center (1) to edge (0)
+    window.resize(windowTableSize + 1);
+    for (int i = 0; i <= windowTableSize; ++i) {
+        window[i] = (float)(0.5 * (1.0 + cos(pi * i / windowTableSize)));
+    }
+    input.resize(channels);
+    output.resize(channels);
+    reset();
+}
+
+void
+PsolaStretcher::reset() {
+    for (auto& in : input) in.clear();
+    for (auto& out : output) out.clear();
+    mono.clear();
+    marks.clear();
+    grains.clear();
+    inStart = 0;
+    inEnd = 0;
+    lastPeriod = unvoicedPeriod;
+    lastVoiced = false;
+    nextCenter = 0.0;
+    spacingPending = false;
+    anchorIn = 0.0;
+    anchorOut = 0.0;
+    outPos = 0;
+    outLimit = -1;
+    outRead = 0;
+    finished = false;
+}
+
+void
+PsolaStretcher::setTimeRatio(double ratio) {
+    if (ratio <= 0.0) return;
+    // new ratio applies from the next synthesis mark, output keeps going from where it is
+    anchorIn = inputTime(nextCenter);
+    anchorOut = nextCenter;
+    timeRatio = ratio;
+}
+
+void
+PsolaStretcher::setPitchScale(double scale) {
+    if (scale <= 0.0) return;
+    pitchScale = scale;
+}
+
+void
+PsolaStretcher::setFormantScale(double scale) {
+    if (scale < 0.0) return;
+    formantScale = scale;
+}
+
+size_t
+PsolaStretcher::getLatency() const {
+    // the newest mark is a period behind input head plus snapping range, the next output frame waits
+    // for grains reaching back from it
+    return (size_t)ceil(maxPeriod * (1.0 + snapRange)) + 1;
+}
+
+void
+PsolaStretcher::process(const float* const* in, size_t samples, bool final) {
+    TRACE_SCOPE("psola process");
+    if (finished) return;
+    for (size_t c = 0; c < channels; ++c) {
+        input[c].insert(input[c].end(), in[c], in[c] + samples);
+    }
+    size_t base = mono.size();
+    mono.resize(base + samples, 0.f);
+    float gain = 1.f / channels;
+    for (size_t c = 0; c < channels; ++c) {
+        for (size_t i = 0; i < samples; ++i) {
+            mono[base + i] += in[c][i] * gain;
+        }
+    }
+    inEnd += samples;
+
+    analyze(final);
+    synthesize(final);
+    compact();
+}
+
+double
+PsolaStretcher::estimatePeriod(int64_t end) {
+    int d = decimation;
+    int lags = (int)ceil(maxPeriod / d);
+    int minLag = std::max(2, (int)(minPeriod / d));
+    int64_t begin = end - (int64_t)lags * 2 * d;
+    if (begin < inStart || lags <= minLag) return 0.0;
+
+    decimated.resize((size_t)lags * 2);
+    const float* m = mono.data() + (begin - inStart);
+    for (int j = 0; j < lags * 2; ++j) {
+        float sum = 0.f;
+        for (int k = 0; k < d; ++k) sum += m[j * d + k];
+        decimated[j] = sum / d;
+    }
+
+    // d(lag) = sum over first half of (x[j] - x[j + lag])^2, energy terms run along the lag
+    const float* x = decimated.data();
+    float energy = DotProduct(x, x, lags);
+    if (energy < 1e-7f * lags) return 0.0;
+    float shifted = energy;
+    diff.assign((size_t)lags + 1, 1.f);
+    double cumulative = 0.0;
+    int found = 0;
+    for (int lag = 1; lag <= lags; ++lag) {
+        shifted += x[lag + lags - 1] * x[lag + lags - 1] - x[lag - 1] * x[lag - 1];
+        float d2 = energy + shifted - 2.f * DotProduct(x, x + lag, lags);
+        if (d2 < 0.f) d2 = 0.f;
+        cumulative += d2;
+        diff[lag] = cumulative > 0.0 ? (float)(d2 * lag / cumulative) : 1.f;
+        if (lag <= minLag) continue;
+        if (!found && diff[lag] < voicedThreshold) found = lag;
+        // first dip below threshold, walk to its bottom
+        if (found && diff[lag] >= diff[lag - 1]) {
+            found = lag - 1;
+            break;
+        }
+        if (found) found = lag;
+    }
+    if (!found) return 0.0;
+
+    // parabolic interpolation around the dip
+    double lag = found;
+    if (found > 1 && found < lags) {
+        double a = diff[found - 1], b = diff[found], c = diff[found + 1];
+        double den = a - 2 * b + c;
+        if (den > 0.0) lag += 0.5 * (a - c) / den;
+    }
+    return lag * d;
+}
+
+void
+PsolaStretcher::analyze(bool final) {
+    while (true) {
+        int64_t cand = marks.empty() ? 0 : marks.back().pos + (int64_t)lround(marks.back().period);
+        if (final) {
+            if (cand >= inEnd) break;
+        }
+        else if (cand + (int64_t)ceil(maxPeriod * snapRange) + 1 > inEnd) {
+            break;
+        }
+
+        Mark mark = { cand, unvoicedPeriod, false };
+        double period = estimatePeriod(cand);
+        if (period > 0.0) {
+            // align to the largest peak so grains of successive periods overlap in phase
+            int64_t range = (int64_t)(period * snapRange);
+            int64_t lo = std::max(cand - range, inStart);
+            if (!marks.empty()) lo = std::max(lo, marks.back().pos + nextMarkDistance());
+            int64_t hi = std::min(cand + range, inEnd - 1);
+            int64_t best = cand;
+            float peak = -1e30f;
+            for (int64_t i = lo; i <= hi; ++i) {
+                float v = mono[i - inStart];
+                if (v > peak) {
+                    peak = v;
+                    best = i;
+                }
+            }
+            mark = { best, period, true };
+        }
+        marks.push_back(mark);
+        lastPeriod = mark.period;
+        lastVoiced = mark.voiced;
+    }
+}
+
+float
+PsolaStretcher::inputAt(int channel, double pos) const {
+    double rel = pos - inStart;
+    if (rel < 0.0) return 0.f;
+    size_t i = (size_t)rel;
+    const auto& in = input[channel];
+    if (i + 1 >= in.size()) return i < in.size() ? in[i] : 0.f;
+    float frac = (float)(rel - i);
+    return in[i] + (in[i + 1] - in[i]) * frac;
+}
+
+void
+PsolaStretcher::synthesize(bool final) {
+    double step = formantScale > 0.0 ? formantScale * pitchScale : 1.0;
+
+    // synthesis marks while the analysis mark for their time is known
+    while (!marks.empty()) {
+        if (spacingPending) {
+            // follow actual spacing of marks rather than the estimate, synthesis marks stay locked to analysis
+            // marks at unity scales, unvoiced grains repeat at their own spacing since scaling it only buzzes
+            if (!final && marks.size() < 2) break;
+            const Mark& mark = marks.front();
+            double spacing = marks.size() > 1 ? (double)(marks[1].pos - mark.pos) : mark.period;
+            nextCenter += mark.voiced ? spacing / pitchScale : spacing;
+            spacingPending = false;
+        }
+        double at = inputTime(nextCenter);
+        if (final && at >= inEnd) break;
+        while (marks.size() > 1 && marks[1].pos <= at) marks.pop_front();
+        // the latest mark is taken before the next one is placed if that can not land before the time
+        if (!final && marks.size() < 2 && at >= marks.front().pos + nextMarkDistance()) break;
+        const Mark& mark = marks.front();
+        Grain grain;
+        grain.center = (int64_t)lround(nextCenter);
+        grain.source = mark.pos;
+        grain.step = step;
+        // a half never reads further than a period of its mark
+        double cap = mark.period / step;
+        grain.left = cap;
+        grain.right = cap;
+        if (!grains.empty()) {
+            // halves meet between neighbors, rising half of this one complements falling half of previous one
+            Grain& prev = grains.back();
+            double between = (double)(grain.center - prev.center);
+            prev.right = std::min(prev.right, between);
+            grain.left = std::min(cap, between);
+        }
+        grains.push_back(grain);
+        spacingPending = true;
+    }
+
+    int64_t limit;
+    if (final) {
+        outLimit = (int64_t)lround(anchorOut + (inEnd - anchorIn) * timeRatio);
+        limit = outLimit;
+    }
+    else {
+        // falling half of the latest grain waits for the next grain, and grains wait for their input
+        limit = grains.empty() ? outPos : grains.back().center;
+        for (const auto& g : grains) {
+            int64_t ready = g.center + (int64_t)floor((inEnd - 1 - g.source) / g.step);
+            limit = std::min(limit, ready);
+        }
+    }
+    if (limit <= outPos) {
+        if (final) finished = true;
+        return;
+    }
+
+    size_t count = (size_t)(limit - outPos);
+    size_t base = output[0].size();
+    for (auto& out : output) out.resize(base + count, 0.f);
+    for (const auto& g : grains) {
+        int64_t from = std::max(outPos, g.center - (int64_t)g.left);
+        int64_t to = std::min(limit, g.center + (int64_t)g.right + 1);
+        bool unit = (g.step == 1.0);
+        for (int64_t n = from; n < to; ++n) {
+            int64_t offset = n - g.center;
+            double t = offset < 0 ? -offset / g.left : offset / g.right;
+            if (t >= 1.0) continue;
+            float w = window[(int)(t * windowTableSize)];
+            size_t o = base + (size_t)(n - outPos);
+            if (unit) {
+                int64_t i = g.source + offset - inStart;
+                if (i < 0 || i >= (int64_t)mono.size()) continue;
+                for (size_t c = 0; c < channels; ++c) {
+                    output[c][o] += input[c][i] * w;
+                }
+            }
+            else {
+                double pos = g.source + offset * g.step;
+                for (size_t c = 0; c < channels; ++c) {
+                    output[c][o] += inputAt((int)c, pos) * w;
+                }
+            }
+        }
+    }
+    outPos = limit;
+    // keep the latest grain, its falling half is cut by the next one
+    while (grains.size() > 1 && grains.front().center + grains.front().right < outPos) grains.pop_front();
+    if (final) finished = true;
+}
+
+void
+PsolaStretcher::compact() {
+    // analysis window of next mark, next grains from the front mark, and live grains
+    int64_t keep = inEnd - (int64_t)ceil(maxPeriod * 3);
+    if (!marks.empty()) {
+        keep = std::min(keep, marks.front().pos - (int64_t)ceil(maxPeriod) - 1);
+        keep = std::min(keep, marks.back().pos - (int64_t)ceil(maxPeriod * 2) - decimation - 1);
+    }
+    for (const auto& g : grains) {
+        keep = std::min(keep, g.source - (int64_t)ceil(g.left * g.step) - 1);
+    }
+    if (keep - inStart < compactFrames) return;
+    size_t drop = (size_t)(keep - inStart);
+    for (auto& in : input) in.erase(in.begin(), in.begin() + drop);
+    mono.erase(mono.begin(), mono.begin() + drop);
+    inStart = keep;
+}
+
+int
+PsolaStretcher::available() const {
+    size_t frames = output.empty() ? 0 : output[0].size() - outRead;
+    if (frames == 0 && finished) return -1;
+    return (int)frames;
+}
+
+size_t
+PsolaStretcher::retrieve(float* const* out, size_t samples) {
+    if (output.empty()) return 0;
+    size_t frames = std::min(samples, output[0].size() - outRead);
+    for (size_t c = 0; c < channels; ++c) {
+        std::copy(output[c].begin() + outRead, output[c].begin() + outRead + frames, out[c]);
+    }
+    outRead += frames;
+    // drop retrieved output once it is most of the buffer
+    if (outRead > 0 && outRead * 2 >= output[0].size()) {
+        for (auto& o : output) o.erase(o.begin(), o.begin() + outRead);
+        outRead = 0;
+    }
+    return frames;
+}
+
+} // namespace PitchShifting
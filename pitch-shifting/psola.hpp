@@ -0,0 +1,129 @@
+#pragma once
+/*
+ * time domain pitch synchronous overlap-add (TD-PSOLA) pitch shifter for live voice, alternative to rubberband
+ *   - pitch marks are placed one period apart on mono mixdown, period from normalized difference function
+ *     (yin-like) on decimated signal with a backward window, marks snap to the waveform peak nearby,
+ *     unvoiced or silent frames get fixed marks of half of the longest period
+ *   - each synthesis mark takes the latest analysis mark at its time / time ratio, synthesis marks are spaced
+ *     by mark spacing / pitch scale, grains are hann halves reaching to the neighbor synthesis marks (at most
+ *     a period of their mark), so halves of neighbors complement each other
+ *   - output is summed up to the latest synthesis mark, grains never wait for the next one to be placed,
+ *     algorithmic latency is at most 1.125 periods of lowest pitch, eg. 120Hz gives ~9.4ms at any sample rate,
+ *     lowering pitch adds the wider spacing of synthesis marks
+ *   - formants stay where they are since grains are not resampled, a formant scale reads grains faster or slower
+ *   - all channels share the same marks, stereo image and phase between channels are kept
+ * NOTE: method names follow RubberBandStretcher for the stretcher process loop, not thread safe
+ */
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace PitchShifting {
+
+class PsolaStretcher {
+public:
+    /* minF0 is the lowest pitch tracked, it also sets the latency */
+    PsolaStretcher(size_t sampleRate, size_t channels, double timeRatio = 1.0, double pitchScale = 1.0, double minF0 = 120.0);
+    virtual ~PsolaStretcher() {}
+    PsolaStretcher(const PsolaStretcher&) = delete;
+    PsolaStretcher& operator=(const PsolaStretcher&) = delete;
+
+    /* drop all buffered input and output, keep ratios */
+    void reset();
+
+    void setTimeRatio(double ratio);
+    void setPitchScale(double scale);
+    /* formant envelope ratio in rubberband terms (1 / pitch scale preserves), 0 keeps formants of input */
+    void setFormantScale(double scale);
+    double getTimeRatio() const { return timeRatio; }
+    double getPitchScale() const { return pitchScale; }
+    double getFormantScale() const { return formantScale; }
+    size_t getChannelCount() const { return channels; }
+
+    /* worst case input frames needed beyond an output frame before it is available */
+    size_t getLatency() const;
+    /* output is aligned to input already, no padding or dropping required */
+    size_t getStartDelay() const { return 0; }
+    size_t getPreferredStartPad() const { return 0; }
+
+    /* feed samples per channel, final flushes the rest of output */
+    void process(const float* const* input, size_t samples, bool final);
+    /* frames ready to retrieve, -1 if final input was processed and all output is retrieved */
+    int available() const;
+    /* copy up to samples frames per channel, \return frames retrieved */
+    size_t retrieve(float* const* output, size_t samples);
+
+    /* period of latest analysis mark in frames, 0 if unvoiced, for debug output */
+    double getCurrentPeriod() const { return lastVoiced ? lastPeriod : 0.0; }
+
+private:
+    struct Mark {
+        int64_t pos; // absolute input frame
+        double period; // frames to next mark
+        bool voiced;
+    };
+    struct Grain {
+        int64_t center; // absolute output frame
+        int64_t source; // absolute input frame of analysis mark
+        // half lengths in output frames, falling half is shortened once the next grain is placed
+        double left;
+        double right;
+        double step; // input frames per output frame, formant scale
+    };
+
+    // place marks while the input covers the next one
+    void analyze(bool final);
+    // yin-like period estimate of decimated window ending at input frame end, \return 0 if unvoiced
+    double estimatePeriod(int64_t end);
+    // create grains and sum output frames while their input is available
+    void synthesize(bool final);
+    // marks are at least this far apart
+    int64_t nextMarkDistance() const { return (int64_t)(minPeriod / 2) + 1; }
+    double inputTime(double outFrame) const { return anchorIn + (outFrame - anchorOut) / timeRatio; }
+    float inputAt(int channel, double pos) const;
+    // drop input history not referenced by marks or grains any more
+    void compact();
+
+    size_t sampleRate;
+    size_t channels;
+    double timeRatio;
+    double pitchScale;
+    double formantScale = 0.0;
+
+    double maxPeriod; // frames, from minF0
+    double minPeriod; // frames, from highest pitch
+    double unvoicedPeriod;
+    int decimation;
+
+    // input history per channel and its mono mixdown, index 0 is absolute frame inStart
+    std::vector<std::vector<float>> input;
+    std::vector<float> mono;
+    std::vector<float> decimated; // analysis window of mono averaged by decimation
+    int64_t inStart = 0;
+    int64_t inEnd = 0; // absolute frames received
+    std::vector<float> diff; // cumulative mean normalized difference by lag
+
+    std::deque<Mark> marks;
+    double lastPeriod;
+    bool lastVoiced = false;
+
+    std::deque<Grain> grains;
+    double nextCenter = 0.0; // output frame of next synthesis mark
+    bool spacingPending = false; // latest grain is placed, next mark is needed for the spacing to next one
+    // output and input frame of the last time ratio change
+    double anchorIn = 0.0;
+    double anchorOut = 0.0;
+    int64_t outPos = 0; // absolute output frame to sum next
+    int64_t outLimit = -1; // total output frames once final, -1 before
+
+    // hann window table over [0, 1] of half grain
+    std::vector<float> window;
+
+    // output not yet retrieved per channel
+    std::vector<std::vector<float>> output;
+    size_t outRead = 0;
+    bool finished = false;
+};
+
+} // namespace PitchShifting
@@ -0,0 +1,79 @@
+#include "renderloop.hpp"
+#include <algorithm>
+
+using RubberBand::RubberBandStretcher;
+
+namespace PitchShifting {
+
+RubberBandStretcher::Options
+RenderLoop::SingleThreaded(RubberBandStretcher::Options options) {
+    return (options & ~RubberBandStretcher::OptionThreadingAlways) | RubberBandStretcher::OptionThreadingNever;
+}
+
+void
+RenderLoop::Begin(RubberBandStretcher* stretcher, bool realtime, const ChannelMap& map, int frames, float gain,
+    size_t maxOutput, WriteFn writeFn) {
+    pts = stretcher;
+    channelMap = map;
+    blockSize = frames;
+    inGain = gain;
+    limit = maxOutput;
+    write = std::move(writeFn);
+    toDrop = 0;
+    countOut = 0;
+    clipped = false;
+
+    int channels = map.inChannels;
+    if (ibuf.size() < (size_t)blockSize * channels) ibuf.resize((size_t)blockSize * channels);
+    if (obuf.size() < (size_t)blockSize * map.outChannels) obuf.resize((size_t)blockSize * map.outChannels);
+    if (cdata.size() < (size_t)channels) cdata.resize(channels);
+    cbuf.resize(channels);
+    for (int c = 0; c < channels; ++c) {
+        cdata[c].resize(blockSize);
+        std::fill(cdata[c].begin(), cdata[c].end(), 0.f);
+        cbuf[c] = cdata[c].data();
+    }
+
+    if (realtime) {
+        int toPad = (int)pts->getPreferredStartPad();
+        toDrop = (int)pts->getStartDelay();
+        while (toPad > 0) {
+            int p = std::min(toPad, blockSize);
+            pts->process(cbuf.data(), p, false);
+            toPad -= p;
+        }
+    }
+}
+
+void
+RenderLoop::Process(int frames, bool isFinal) {
+    DeinterleaveGainClamp(ibuf.data(), cbuf.data(), channelMap.inChannels, frames, inGain);
+    pts->process(cbuf.data(), (size_t)frames, isFinal);
+    retrieve();
+}
+
+void
+RenderLoop::retrieve() {
+    int avail;
+    // threading is off, nothing more arrives later if none available now
+    while ((avail = pts->available()) > 0) {
+        int count = std::min(avail, blockSize);
+        if (toDrop > 0) {
+            count = std::min(count, toDrop);
+            pts->retrieve(cbuf.data(), count);
+            toDrop -= count;
+            continue;
+        }
+        pts->retrieve(cbuf.data(), count);
+        if (countOut + count > limit) {
+            count = (int)(limit - countOut);
+        }
+        if (count <= 0) continue;
+        float peak = InterleaveChannelMap(cbuf.data(), obuf.data(), channelMap, count, 1.f, true);
+        if (peak >= 1.f) clipped = true;
+        write(obuf.data(), (size_t)count);
+        countOut += count;
+    }
+}
+
+} // namespace PitchShifting
@@ -0,0 +1,63 @@
+#pragma once
+/*
+ * process and retrieve loop of a single rubberband stretcher for offline jobs on a worker pool
+ * (parallel render segments, batch files), shared so both handle start delay and output length the same way
+ *   - realtime mode pads start manually and drops its start delay from output, the same as ProcessStartPad()
+ *   - output is retrieved right after each process call, routed through channel map and clamped
+ *   - output stops at given limit, realtime mode does not know the end by itself
+ * NOTE: buffers grow only, a worker can keep one loop across streams
+ */
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#endif
+#include "rubberband/RubberBandStretcher.h"
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include "kernels.hpp"
+
+namespace PitchShifting {
+
+class RenderLoop {
+public:
+    /* interleaved output frames of map.outChannels */
+    typedef std::function<void(const float* buf, size_t frames)> WriteFn;
+
+    /* options with internal threading of rubberband turned off, pool workers already occupy all cores */
+    static RubberBand::RubberBandStretcher::Options SingleThreaded(RubberBand::RubberBandStretcher::Options options);
+
+    /*
+     * start a new stream on stretcher created with map.inChannels and max process size of blockSize,
+     * pads start if realtime mode, limit is max output frames to write (eg. input frames * time ratio)
+     */
+    void Begin(RubberBand::RubberBandStretcher* stretcher, bool realtime, const ChannelMap& map, int blockSize,
+        float inGain, size_t limit, WriteFn write);
+    /* interleaved input block of at most block size frames, read directly into it by caller */
+    float* GetInputBuffer() { return ibuf.data(); }
+    /* deinterleave input buffer with gain and clamp, process and write all available output */
+    void Process(int frames, bool isFinal);
+
+    size_t GetOutputFrames() const { return countOut; }
+    bool IsClipped() const { return clipped; }
+
+private:
+    void retrieve();
+
+    RubberBand::RubberBandStretcher* pts = nullptr;
+    ChannelMap channelMap;
+    int blockSize = 0;
+    float inGain = 1.f;
+    size_t limit = 0;
+    WriteFn write;
+    int toDrop = 0;
+    size_t countOut = 0;
+    bool clipped = false;
+    std::vector<float> ibuf;
+    std::vector<float> obuf;
+    std::vector<std::vector<float>> cdata;
+    std::vector<float*> cbuf;
+};
+
+} // namespace PitchShifting
@@ -0,0 +1,204 @@
+#include "resampler.hpp"
+#include "kernels.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace PitchShifting {
+
+static const double pi = 3.14159265358979323846;
+
+struct QualitySpec {
+    const char* name;
+    int taps;
+    int maxPhases;
+    double beta; // kaiser window shape, higher is deeper stopband and wider transition
+    double rolloff; // cutoff relative to nyquist of lower rate
+};
+static const QualitySpec qualitySpecs[] = {
+    { "fast", 16, 64, 6.0, 0.85 },
+    { "medium", 32, 256, 8.0, 0.91 },
+    { "best", 64, 1024, 10.0, 0.95 },
+};
+
+// modified bessel function of the first kind, order 0, series converges fast for kaiser beta range
+static double besselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    double q = x * x / 4.0;
+    for (int k = 1; k < 64; ++k) {
+        term *= q / ((double)k * k);
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+bool
+Resampler::ParseQuality(const std::string& name, Quality* quality) {
+    for (int i = 0; i < (int)(sizeof(qualitySpecs) / sizeof(qualitySpecs[0])); ++i) {
+        if (name == qualitySpecs[i].name || name == std::to_string(i)) {
+            if (quality) *quality = (Quality)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char*
+Resampler::GetQualityName(Quality quality) {
+    if (quality < Fast || quality > Best) return "unknown";
+    return qualitySpecs[quality].name;
+}
+
+Resampler::Resampler(int channels, int inRate, int outRate, Quality quality, int maxBlock)
+    : channels(channels), inRate(inRate), outRate(outRate), quality(quality), maxBlock(maxBlock) {
+    if (this->quality < Fast || this->quality > Best) this->quality = Medium;
+    const QualitySpec& spec = qualitySpecs[this->quality];
+    if (inRate > 0 && outRate > 0) {
+        int64_t g = std::gcd((int64_t)inRate, (int64_t)outRate);
+        up = outRate / g;
+        down = inRate / g;
+    }
+    // downsampling cutoff is lower, stretch filter by the ratio so it spans the same zero crossings of output rate
+    taps = spec.taps;
+    if (down > up) {
+        taps = (int)((spec.taps * down + up - 1) / up + 7) & ~7;
+    }
+    phases = (int)std::min<int64_t>(up, spec.maxPhases);
+    buildFilter(spec.beta);
+    history.assign(channels, std::vector<float>(taps + maxBlock, 0.f));
+    Reset();
+}
+
+void
+Resampler::buildFilter(double beta) {
+    const QualitySpec& spec = qualitySpecs[quality];
+    // cutoff relative to input nyquist, band limited to output nyquist if downsampling
+    double cutoff = std::min(1.0, (double)up / down) * spec.rolloff;
+    double half = taps / 2;
+    double norm = besselI0(beta);
+    filter.assign((size_t)(phases + 1) * taps, 0.f);
+    for (int p = 0; p <= phases; ++p) {
+        double frac = (double)p / phases;
+        float* row = &filter[(size_t)p * taps];
+        double sum = 0.0;
+        for (int k = 0; k < taps; ++k) {
+            // distance from output time to input frame of tap k, taps run from base to base + taps - 1
+            double t = frac + (half - 1) - k;
+            double r = t / half;
+            double w = (r <= -1.0 || r >= 1.0) ? 0.0 : besselI0(beta * sqrt(1.0 - r * r)) / norm;
+            double x = pi * cutoff * t;
+            double sinc = (fabs(x) < 1e-9) ? 1.0 : sin(x) / x;
+            double h = cutoff * sinc * w;
+            row[k] = (float)h;
+            sum += h;
+        }
+        // unity gain at dc for every phase, otherwise dc ripples at the rate of phase stepping
+        if (sum != 0.0) {
+            for (int k = 0; k < taps; ++k) row[k] = (float)(row[k] / sum);
+        }
+    }
+}
+
+size_t
+Resampler::GetMaxOutput(size_t inFrames) const {
+    return (size_t)(((uint64_t)inFrames * up + down - 1) / down) + 1;
+}
+
+void
+Resampler::Reset() {
+    for (auto& h : history) {
+        std::fill(h.begin(), h.end(), 0.f);
+    }
+    // primed with silence before input frame 0, so the first output is centered on it
+    filled = taps / 2 - 1;
+    base = 0;
+    phase = 0;
+    inTotal = 0;
+    outTotal = 0;
+}
+
+size_t
+Resampler::Process(const float* in, size_t inFrames, float* out) {
+    TRACE_SCOPE("resample");
+    size_t produced = 0;
+    while (inFrames > 0) {
+        size_t n = std::min(inFrames, (size_t)maxBlock);
+        produced += processChunk(in, n, out + produced * channels);
+        in += n * channels;
+        inFrames -= n;
+    }
+    return produced;
+}
+
+size_t
+Resampler::processChunk(const float* in, size_t inFrames, float* out) {
+    inTotal += inFrames;
+    for (int c = 0; c < channels; ++c) {
+        float* h = history[c].data() + filled;
+        for (size_t i = 0; i < inFrames; ++i) {
+            h[i] = in[i * channels + c];
+        }
+    }
+    filled += (int)inFrames;
+
+    size_t produced = 0;
+    while (base + taps <= filled) {
+        int64_t pos = phase * phases;
+        int row = (int)(pos / up);
+        int64_t rem = pos % up;
+        const float* h0 = &filter[(size_t)row * taps];
+        float* o = out + produced * channels;
+        if (rem == 0) {
+            for (int c = 0; c < channels; ++c) {
+                o[c] = DotProduct(history[c].data() + base, h0, taps);
+            }
+        }
+        else {
+            // between 2 phases of the bank, linear interpolation of their outputs
+            const float* h1 = h0 + taps;
+            float w = (float)((double)rem / up);
+            for (int c = 0; c < channels; ++c) {
+                float a = DotProduct(history[c].data() + base, h0, taps);
+                float b = DotProduct(history[c].data() + base, h1, taps);
+                o[c] = a + (b - a) * w;
+            }
+        }
+        produced++;
+        phase += down;
+        base += (int)(phase / up);
+        phase %= up;
+    }
+    outTotal += produced;
+
+    // keep the frames of next output at the beginning of history, a step never passes filled frames
+    // since taps are longer than the ratio
+    if (base > 0) {
+        for (auto& h : history) {
+            memmove(h.data(), h.data() + base, (filled - base) * sizeof(float));
+        }
+        filled -= base;
+    }
+    base = 0;
+    return produced;
+}
+
+size_t
+Resampler::Flush(float* out) {
+    // push delayed frames out with silence, then trim to the exact length of converted stream
+    uint64_t expected = (inTotal * up + down / 2) / down;
+    std::vector<float> zeros((size_t)GetLatency() * channels, 0.f);
+    uint64_t inBefore = inTotal;
+    size_t produced = Process(zeros.data(), GetLatency(), out);
+    inTotal = inBefore;
+    if (outTotal > expected) {
+        size_t extra = (size_t)std::min<uint64_t>(outTotal - expected, produced);
+        produced -= extra;
+        outTotal -= extra;
+    }
+    return produced;
+}
+
+} // namespace PitchShifting
@@ -0,0 +1,82 @@
+#pragma once
+/*
+ * streaming sample rate conversion of interleaved blocks, between stretcher output and file or device sinks
+ *   - polyphase windowed-sinc (kaiser) fir, the ratio is reduced to out/in = L/M and stepped exactly in integers,
+ *     no drift for any length of stream
+ *   - filter bank keeps at most quality phases, a ratio with more phases (eg. 44100 -> 48000 is 160/147 in fast)
+ *     interpolates output of the 2 nearest phases
+ *   - cutoff follows the lower rate, downsampling is band limited before decimation
+ *   - zero phase, input is primed by half of taps so output frame 0 is aligned to input frame 0,
+ *     Flush() at the end of stream returns the delayed tail, total output is round(input * L / M) frames
+ *   - taps are dot products by simd kernel on per channel linear history, no allocation on Process()
+ * NOTE: not thread safe, one instance per stream
+ */
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace PitchShifting {
+
+class Resampler {
+public:
+    /* quality trades cpu per output sample (taps) against stopband and passband width,
+     * taps are multiplied by the ratio for downsampling */
+    enum Quality : int {
+        Fast, // 16 taps, 64 phases, ~70dB snr
+        Medium, // 32 taps, 256 phases, ~85dB snr
+        Best // 64 taps, 1024 phases, ~105dB snr
+    };
+    /* "fast", "medium", "best" or 0-2, \return false if unknown */
+    static bool ParseQuality(const std::string& name, Quality* quality);
+    static const char* GetQualityName(Quality quality);
+
+    /* frames of a single Process() call are unlimited, history is processed in chunks of maxBlock frames */
+    Resampler(int channels, int inRate, int outRate, Quality quality = Medium, int maxBlock = 1024);
+    virtual ~Resampler() {}
+    Resampler(const Resampler&) = delete;
+    Resampler& operator=(const Resampler&) = delete;
+
+    int GetChannels() const { return channels; }
+    int GetInputRate() const { return inRate; }
+    int GetOutputRate() const { return outRate; }
+    Quality GetQuality() const { return quality; }
+    /* input frames held back by filter, returned by Flush() */
+    int GetLatency() const { return taps / 2; }
+    /* upper bound of output frames for given input frames, for caller buffer */
+    size_t GetMaxOutput(size_t inFrames) const;
+
+    /* convert interleaved in[inFrames * channels] to out, \return output frames */
+    size_t Process(const float* in, size_t inFrames, float* out);
+    /* end of stream, output rest of frames, out must hold GetMaxOutput(GetLatency()) frames, \return output frames */
+    size_t Flush(float* out);
+    /* start a new stream, drop history */
+    void Reset();
+
+private:
+    void buildFilter(double beta);
+    // append input to history and produce outputs until history runs short
+    size_t processChunk(const float* in, size_t inFrames, float* out);
+
+    int channels;
+    int inRate;
+    int outRate;
+    Quality quality;
+    int maxBlock;
+    // reduced ratio, out/in = up/down
+    int64_t up = 1;
+    int64_t down = 1;
+    int taps = 0;
+    int phases = 0;
+    // filter bank [phases + 1][taps], reversed so output is a dot product with history from base
+    std::vector<float> filter;
+    // per channel linear history [channels][taps + maxBlock]
+    std::vector<std::vector<float>> history;
+    int filled = 0; // frames in history
+    int base = 0; // history index of first tap of next output
+    int64_t phase = 0; // fractional position of next output in units of 1/up input frames
+    uint64_t inTotal = 0;
+    uint64_t outTotal = 0;
+};
+
+} // namespace PitchShifting
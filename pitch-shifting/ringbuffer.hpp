@@ -0,0 +1,106 @@
+#pragma once
+/*
+ * single-producer/single-consumer ring buffer between portaudio callbacks and stretcher thread,
+ * the writer only moves writeIndex and the reader only moves readIndex, so neither side waits for the other
+ * NOTE: keeps the same function names as RubberBand::RingBuffer for the existing call sites
+ */
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+
+namespace PitchShifting {
+
+template <typename T>
+class SpscRingBuffer {
+public:
+    /* given size is the usable capacity, storage is rounded up to power of 2 for index masking */
+    explicit SpscRingBuffer(size_t size) : capacity(size) {
+        size_t storage = 1;
+        while (storage < size) storage <<= 1;
+        mask = storage - 1;
+        buffer = new T[storage];
+        writeIndex.store(0, std::memory_order_relaxed);
+        readIndex.store(0, std::memory_order_relaxed);
+    }
+    virtual ~SpscRingBuffer() {
+        delete[] buffer;
+    }
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+    SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+    size_t getSize() const { return capacity; }
+
+    /* consumer side, elements ready for read */
+    size_t getReadSpace() const {
+        size_t w = writeIndex.load(std::memory_order_acquire);
+        size_t r = readIndex.load(std::memory_order_relaxed);
+        return w - r;
+    }
+    /* producer side, elements can be written without overwriting unread data */
+    size_t getWriteSpace() const {
+        size_t w = writeIndex.load(std::memory_order_relaxed);
+        size_t r = readIndex.load(std::memory_order_acquire);
+        return capacity - (w - r);
+    }
+
+    /* producer only, \return number of elements written (may less than n if not enough space) */
+    size_t write(const T* src, size_t n) {
+        size_t w = writeIndex.load(std::memory_order_relaxed);
+        size_t r = readIndex.load(std::memory_order_acquire);
+        size_t space = capacity - (w - r);
+        if (n > space) n = space;
+        if (n == 0) return 0;
+        size_t pos = w & mask;
+        size_t first = mask + 1 - pos;
+        if (first > n) first = n;
+        memcpy(buffer + pos, src, first * sizeof(T));
+        if (n > first) {
+            memcpy(buffer, src + first, (n - first) * sizeof(T));
+        }
+        writeIndex.store(w + n, std::memory_order_release);
+        return n;
+    }
+
+    /* consumer only, \return number of elements read (may less than n if not enough data) */
+    size_t read(T* dst, size_t n) {
+        size_t r = readIndex.load(std::memory_order_relaxed);
+        size_t w = writeIndex.load(std::memory_order_acquire);
+        size_t avail = w - r;
+        if (n > avail) n = avail;
+        if (n == 0) return 0;
+        size_t pos = r & mask;
+        size_t first = mask + 1 - pos;
+        if (first > n) first = n;
+        memcpy(dst, buffer + pos, first * sizeof(T));
+        if (n > first) {
+            memcpy(dst + first, buffer, (n - first) * sizeof(T));
+        }
+        readIndex.store(r + n, std::memory_order_release);
+        return n;
+    }
+
+    /* consumer only, drop elements without copying */
+    size_t skip(size_t n) {
+        size_t r = readIndex.load(std::memory_order_relaxed);
+        size_t avail = writeIndex.load(std::memory_order_acquire) - r;
+        if (n > avail) n = avail;
+        readIndex.store(r + n, std::memory_order_release);
+        return n;
+    }
+
+    /* NOTE: only safe while neither producer nor consumer is running (eg. stream stopped) */
+    void reset() {
+        writeIndex.store(0, std::memory_order_relaxed);
+        readIndex.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    T* buffer;
+    size_t mask;
+    size_t capacity;
+    // separate cache lines, prevent false sharing between callback and stretcher thread
+    alignas(64) std::atomic<size_t> writeIndex;
+    alignas(64) std::atomic<size_t> readIndex;
+};
+
+} // namespace PitchShifting
@@ -0,0 +1,100 @@
+#include "semaphore.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__APPLE__)
+// unnamed posix semaphore is not supported on macOS, use dispatch semaphore instead
+#include <dispatch/dispatch.h>
+#else
+#include <semaphore.h>
+#include <time.h>
+#include <errno.h>
+#endif
+
+namespace PitchShifting {
+
+#ifdef _WIN32
+
+Semaphore::Semaphore() {
+    handle = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+}
+
+Semaphore::~Semaphore() {
+    if (handle) CloseHandle((HANDLE)handle);
+}
+
+void Semaphore::Signal() {
+    ReleaseSemaphore((HANDLE)handle, 1, NULL);
+}
+
+bool Semaphore::Wait(int timeoutMs) {
+    return WaitForSingleObject((HANDLE)handle, timeoutMs < 0 ? INFINITE : (DWORD)timeoutMs) == WAIT_OBJECT_0;
+}
+
+#elif defined(__APPLE__)
+
+Semaphore::Semaphore() {
+    handle = (void*)dispatch_semaphore_create(0);
+}
+
+Semaphore::~Semaphore() {
+    if (handle) dispatch_release((dispatch_semaphore_t)handle);
+}
+
+void Semaphore::Signal() {
+    dispatch_semaphore_signal((dispatch_semaphore_t)handle);
+}
+
+bool Semaphore::Wait(int timeoutMs) {
+    dispatch_time_t when = (timeoutMs < 0) ? DISPATCH_TIME_FOREVER :
+        dispatch_time(DISPATCH_TIME_NOW, (int64_t)timeoutMs * 1000000);
+    return dispatch_semaphore_wait((dispatch_semaphore_t)handle, when) == 0;
+}
+
+#else
+
+Semaphore::Semaphore() {
+    sem_t* sem = new sem_t;
+    sem_init(sem, 0, 0);
+    handle = sem;
+}
+
+Semaphore::~Semaphore() {
+    sem_t* sem = (sem_t*)handle;
+    sem_destroy(sem);
+    delete sem;
+}
+
+void Semaphore::Signal() {
+    // sem_post is async-signal-safe, ok for realtime callback
+    sem_post((sem_t*)handle);
+}
+
+bool Semaphore::Wait(int timeoutMs) {
+    sem_t* sem = (sem_t*)handle;
+    if (timeoutMs < 0) {
+        while (sem_wait(sem) != 0) {
+            if (errno != EINTR) return false;
+        }
+        return true;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeoutMs / 1000;
+    ts.tv_nsec += (long)(timeoutMs % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec += 1;
+        ts.tv_nsec -= 1000000000L;
+    }
+    while (sem_timedwait(sem, &ts) != 0) {
+        if (errno != EINTR) return false;
+    }
+    return true;
+}
+
+#endif
+
+} // namespace PitchShifting
@@ -0,0 +1,27 @@
+#pragma once
+/*
+ * counting semaphore for waking stretcher thread from portaudio callbacks,
+ * Signal() never blocks and only costs a syscall, it is safe to call in realtime audio callback
+ * NOTE: std::counting_semaphore is c++20, this project still uses c++17
+ */
+
+namespace PitchShifting {
+
+class Semaphore {
+public:
+    Semaphore();
+    virtual ~Semaphore();
+    Semaphore(const Semaphore&) = delete;
+    Semaphore& operator=(const Semaphore&) = delete;
+
+    /* increase the count and wake one waiting thread */
+    void Signal();
+    /* wait until signalled or timeout in milliseconds, \return false if timeout */
+    bool Wait(int timeoutMs);
+
+private:
+    // platform semaphore handle, HANDLE/dispatch_semaphore_t/sem_t*
+    void* handle;
+};
+
+} // namespace PitchShifting
@@ -1,4 +1,5 @@
 #include "stretcher.hpp"
+#include "batch.hpp"
 #ifdef _MSC_VER
 // for usleep from unistd
 #include <windows.h>
@@ -15,30 +16,29 @@ static void usleep(unsigned long usec) {
 #include <unistd.h>
 #endif
 
+// for parameter consistency checks
+#include <cassert>
 // for counting timeout
 #include <chrono>
 auto last = std::chrono::steady_clock::now();
 
-//DEBUG for channel data from rubber band
-#include <src/finer/R3Stretcher.h>
-
 using std::string;
 
 // for local directory files iteration
 #include <filesystem>
+#include <algorithm>
 namespace fs = std::filesystem;
 
 namespace PitchShifting {
 
 Stretcher::Stretcher(Parameters* parameters, int defBlockSize, int debugLevel) {
-    // for port audio initialization
-    Pa_Initialize();
+    // NOTE: port audio is initialized on demand by initAudioDevices(), file to file runs never probe host apis
     inStream = nullptr;
     outStream = nullptr;
 
     debug = debugLevel; //TODO: parameters->debug
     quiet = (debugLevel < 2 || parameters->quiet);
-    cerr << "Constructor default block size:" << defBlockSize << " debug:" << debugLevel << " quiet:" << quiet << endl;
+    cerr << "Constructor default block size:" << defBlockSize << " debug:" << debugLevel << " quiet:" << quiet << " simd:" << SimdKernelName() << endl;
 
     RubberBand::RubberBandStretcher::setDefaultDebugLevel(debugLevel);
     
@@ -84,110 +84,116 @@ Stretcher::~Stretcher() {
     dispose();
 }
 
-RubberBand::R3Stretcher::ChannelData* Stretcher::GetChannelData()
-{
-    auto data = pts->getChannelData(0);
-    if (data) {
-        auto cd = static_cast<std::shared_ptr<RubberBand::R3Stretcher::ChannelData>*>(data);
-        return cd->get();
-    }
-    return nullptr;
-}
-
 std::string Stretcher::GetLibraryVersion()
 {
+    if (!pts) return "psola";
     return std::string(pts->getLibraryVersion());
 }
 
 int Stretcher::GetFormantFFTSize()
 {
-    unsigned int sizes[3] = { 0 };
-    auto count = pts->getFftScaleSizes(sizes);
-    //DEBUG: count should be 3, so far only focus on classification size
-    if (count > 1) {
-        return sizes[1];
-    }
-    return 0;
+    return envelope.IsPrepared() ? envelope.GetFftSize() : 0;
 }
 
 void Stretcher::GetFormantData(FormantDataType type, int channel, int* fftSize, double** dataPtr, int* bufSize)
 {
+    // envelope is analyzed on mono mixdown, channel is ignored
+    *fftSize = envelope.GetFftSize();
+    if (!envelope.IsPrepared()) {
+        *dataPtr = nullptr;
+        *bufSize = 0;
+        return;
+    }
     switch (type) {
     case FormantDataType::Cepstra:
-        pts->getFormantData(channel, "cepstra", fftSize, dataPtr);
+        *dataPtr = envelope.GetCepstra();
         *bufSize = *fftSize;
         break;
     case FormantDataType::Envelope:
-        pts->getFormantData(channel, "envelope", fftSize, dataPtr);
-        *bufSize = *fftSize / 2 + 1;
+        *dataPtr = envelope.GetEnvelope();
+        *bufSize = envelope.GetBinCount();
         break;
     case FormantDataType::Spare:
-        pts->getFormantData(channel, "spare", fftSize, dataPtr);
-        *bufSize = *fftSize / 2 + 1;
+        // magnitude spectrum the envelope comes from
+        *dataPtr = envelope.GetSpectrum();
+        *bufSize = envelope.GetBinCount();
         break;
     }
 }
 
 int Stretcher::GetChannelScaleSizes(int channel, int* fftSizes)
 {
-    unsigned int sizes[3] = { 0 };
-    auto count = pts->getFftScaleSizes(sizes);
-    if (count > 0 && fftSizes) {
-        for (int i = 0; i < count; i++) {
-            *fftSizes = sizes[i];
-            fftSizes++;
-        }
-    }
-    return count;
+    // single scale of envelope analyzer spectrum, the same for psola and rubberband engines
+    if (!envelope.IsPrepared()) return 0;
+    if (fftSizes) *fftSizes = envelope.GetFftSize();
+    return 1;
 }
 
-void* Stretcher::GetChannelScaleData(ScaleDataType type, int channel, int fftSize, double** dataPtr, int* bufSize)
+bool Stretcher::GetChannelScaleData(ScaleDataType type, int channel, int fftSize, double** dataPtr, int* bufSize)
 {
-    auto data = pts->getScaleData(channel, fftSize);
-    if (data == nullptr) return nullptr;
-
-    //auto ptr = static_cast<std::shared_ptr<RubberBand::R3Stretcher::ChannelScaleData>*>(data);
-    //auto scale = ptr->get();
-    //auto ptr = (RubberBand::R3Stretcher::ChannelScaleData*)data;
-    auto scale = (RubberBand::R3Stretcher::ChannelScaleData*)data;
-    if (scale == nullptr) return nullptr;
-
-    *bufSize = scale->bufSize;
+    // envelope is analyzed on mono mixdown, channel is ignored
+    *dataPtr = nullptr;
+    *bufSize = 0;
+    if (!envelope.IsPrepared() || fftSize != envelope.GetFftSize()) return false;
     switch (type) {
-    case ScaleDataType::TimeDomain:
-        *bufSize = scale->fftSize; // time domain size is fft block size or windowed size
-        *dataPtr = scale->timeDomain.data();
-        break;
     case ScaleDataType::Real:
-        *dataPtr = scale->real.data();
+        *dataPtr = envelope.GetReal();
         break;
     case ScaleDataType::Imaginary:
-        *dataPtr = scale->imag.data();
+        *dataPtr = envelope.GetImaginary();
         break;
     case ScaleDataType::Magnitude:
-        *dataPtr = scale->mag.data();
-        break;
-    case ScaleDataType::Phase:
-        *dataPtr = scale->phase.data();
-        break;
-    case ScaleDataType::AdvancedPhase:
-        *dataPtr = scale->advancedPhase.data();
+        *dataPtr = envelope.GetSpectrum();
         break;
     case ScaleDataType::PreviousMagnitude:
-        *dataPtr = scale->prevMag.data();
-        break;
-    case ScaleDataType::PendingKick:
-        *dataPtr = scale->pendingKick.data();
-        break;
-    case ScaleDataType::Accumulator:
-        *dataPtr = scale->accumulator.data();
+        *dataPtr = envelope.GetPreviousSpectrum();
         break;
     }
-    return data;
+    *bufSize = envelope.GetBinCount();
+    return *dataPtr != nullptr;
 }
 
 void
 Stretcher::dispose() {
+    // virtual device threads must stop before buffers go away
+    closeInputVirtual();
+    closeOutputVirtual();
+    // scanner probes through peak cache
+    if (fileScanner) {
+        delete fileScanner;
+        fileScanner = nullptr;
+    }
+    // joins cache thread and writes index
+    if (peakCache) {
+        delete peakCache;
+        peakCache = nullptr;
+    }
+    // reader and writer threads must stop before sndfile and buffers go away
+    if (fileReader) {
+        delete fileReader;
+        fileReader = nullptr;
+    }
+    if (mappedIn) {
+        delete mappedIn;
+        mappedIn = nullptr;
+    }
+    if (fileWriter) {
+        delete fileWriter;
+        fileWriter = nullptr;
+    }
+    if (resampler) {
+        delete resampler;
+        resampler = nullptr;
+    }
+    if (psola) {
+        delete psola;
+        psola = nullptr;
+    }
+    if (autoTune) {
+        delete autoTune;
+        autoTune = nullptr;
+    }
+    envelope.CloseCsv();
     if (ibuf) {
         delete ibuf;
         ibuf = nullptr;
@@ -211,7 +217,10 @@ Stretcher::dispose() {
         delete outBuffer;
         outBuffer = nullptr;
     }
-    Pa_Terminate();
+    if (paInitialized) {
+        Pa_Terminate();
+        paInitialized = false;
+    }
 }
 
 int
@@ -251,10 +260,10 @@ Stretcher::SetOptions(bool finer, bool realtime, int typewin, bool smoothing, bo
     if (formant)     options |= RubberBandStretcher::OptionFormantPreserved;
     if (together)    options |= RubberBandStretcher::OptionChannelsTogether;
 
-    if (freqMap.size() > 0) {
+    if (freqMap.size() > 0 || !param->autotuneScale.empty()) {
         options |= RubberBandStretcher::OptionPitchHighConsistency;
         if (hqpitch) {
-            cerr << "WARNING: High-quality pitch mode selected, but frequency or pitch map file is" << endl;
+            cerr << "WARNING: High-quality pitch mode selected, but frequency or pitch map file or autotune is" << endl;
             cerr << "         provided -- pitch mode will be overridden by high-consistency mode" << endl;
             hqpitch = false;
         }
@@ -367,9 +376,17 @@ Stretcher::LoadFreqMap(std::string mapFile, bool pitchToFreq) {
     int lineno = 0;
     while (!ifile.eof()) {
         std::getline(ifile, line);
+        // '#' starts a comment to the end of line, eg. f0 and formants of --analyze
+        std::string::size_type comment = line.find('#');
+        if (comment != std::string::npos) {
+            line = line.substr(0, comment);
+        }
         while (line.length() > 0 && line[0] == ' ') {
             line = line.substr(1);
         }
+        while (line.length() > 0 && (line.back() == ' ' || line.back() == '\r')) {
+            line.pop_back();
+        }
         if (line == "") {
             ++lineno;
             continue;
@@ -437,44 +454,72 @@ int
 Stretcher::ListLocalFiles(std::vector<SourceDesc>& files) {
     files.clear();
 
-    SF_INFO sfinfo;
-    int index = 0;
-    //TODO: force using working directory
-    for (const auto& entry : fs::directory_iterator(".")) {
-        // ignore none files
-        if (entry.is_regular_file() == false)
-            continue;
-        
-        memset(&sfinfo, 0, sizeof(SF_INFO));
-        // TODO: check unicode file names, use sf_wchar_open
-        try {
-            auto path = entry.path().string();
-        }
-        catch (std::exception& e) {
-            // TODO: exception occurred if path contains unicode, use entry.path().wstring() instead, so far just ignore it
-            continue;
-        }
-        auto sf = sf_open(entry.path().string().c_str(), SFM_READ, &sfinfo);
-        if (!sf) continue;
-        if (sfinfo.samplerate == 0) {
-            sf_close(sf);
-            continue;
-        }
-
+    std::mutex lock;
+    std::vector<ScannedFile> found;
+    // only new or changed files are opened by sndfile, the others come from cache index
+    FileScanner scanner(GetPeakCache());
+    bool started = scanner.Start(param->scanDir, param->scanRecursive, FileScanner::ParseExtensions(param->scanExtensions),
+        [&lock, &found](const ScannedFile& file) {
+            std::lock_guard<std::mutex> guard(lock);
+            found.push_back(file);
+        });
+    if (!started) {
+        cerr << "WARNING: Local files directory \"" << param->scanDir << "\" does not exist" << endl;
+        return 0;
+    }
+    scanner.Wait();
+    peakCache->Save();
+    // workers report in any order, keep the list stable
+    std::sort(found.begin(), found.end(), [](const ScannedFile& a, const ScannedFile& b) { return a.path < b.path; });
+
+    for (const auto& item : found) {
         SourceDesc file;
         file.type = SourceType::AudioFile;
-        file.index = index;
-        file.inputChannels = file.outputChannels = sfinfo.channels;
-        file.sampleRate = sfinfo.samplerate;
-        file.desc = entry.path().string();
+        file.index = (int)files.size();
+        file.inputChannels = file.outputChannels = item.channels;
+        file.sampleRate = item.sampleRate;
+        file.desc = item.path;
         files.push_back(file);
-        index++;
-        sf_close(sf);
     }
     
     return files.size();
 }
 
+bool
+Stretcher::ScanLocalFiles(std::function<void(const SourceDesc&)> onFound) {
+    if (!fileScanner) {
+        fileScanner = new FileScanner(GetPeakCache());
+    }
+    return fileScanner->Start(param->scanDir, param->scanRecursive, FileScanner::ParseExtensions(param->scanExtensions),
+        [onFound](const ScannedFile& item) {
+            SourceDesc file;
+            file.type = SourceType::AudioFile;
+            file.inputChannels = file.outputChannels = item.channels;
+            file.sampleRate = item.sampleRate;
+            file.desc = item.path;
+            onFound(file);
+        });
+}
+
+void
+Stretcher::CancelLocalScan() {
+    if (fileScanner) {
+        fileScanner->Cancel();
+    }
+    if (peakCache) {
+        peakCache->Save();
+    }
+}
+
+PeakCache*
+Stretcher::GetPeakCache() {
+    // created on first use, file to file, batch and analysis runs never touch the cache directory
+    if (!peakCache) {
+        peakCache = new PeakCache(param->peakCacheDir);
+    }
+    return peakCache;
+}
+
 bool
 Stretcher::LoadInputFile(std::string fileName,
     int *pSampleRate, int *pChannels, int *pFormat, int64_t *pFramesCount,
@@ -517,6 +562,24 @@ Stretcher::LoadInputFile(std::string fileName,
         sfinfoIn.samplerate
     };
 
+    // uncompressed wav is processed from mapped pages, sndfile handle stays for header info and study pass
+    if (param->mmapInput && (sfinfoIn.format & SF_FORMAT_TYPEMASK) == SF_FORMAT_WAV) {
+        mappedIn = new MappedAudioFile();
+        if (!mappedIn->Open(fileName) ||
+            mappedIn->GetChannels() != sfinfoIn.channels || mappedIn->GetFrames() != sfinfoIn.frames) {
+            // compressed or unusual layout, fall back to sndfile
+            delete mappedIn;
+            mappedIn = nullptr;
+        } else if (debug > 0) {
+            const char* types[] = { "unsupported", "int16", "int24", "float32" };
+            cerr << "Input file mapped, " << types[mappedIn->GetSampleType()] << " samples" << endl;
+        }
+    }
+    // reader thread starts at first processed block, study pass still reads file directly
+    if (!mappedIn && param->readAhead > 0) {
+        fileReader = new FileReader(sfinfoIn.channels, defBlockSize, param->readAhead);
+    }
+
     if (pSampleRate) *pSampleRate = sfinfoIn.samplerate;
     if (pChannels) *pChannels = sfinfoIn.channels;
     if (pFormat) *pFormat = sfinfoIn.format;
@@ -532,16 +595,11 @@ Stretcher::SetOutputFile(std::string fileName,
     CloseOutputFile();
     memset(&sfinfoOut, 0, sizeof(SF_INFO));
     
-    // TODO: the input sample rate also affact rubberband stretcher,
-    //       force align from input for ease of calculation to output frames and duration.
-    if (/*sampleRate == 0 && */sfinfoIn.samplerate == 0) {
+    // NOTE: rubberband runs at input sample rate, other output rate is converted by resampler in RetrieveAvailableData()
+    if (sampleRate == 0 && sfinfoIn.samplerate == 0) {
         cerr << "ERROR: Missing sample rate assignment or none of reference from input" << endl;
         return false;
     }
-    if (sampleRate != sfinfoIn.samplerate) {
-        cerr << "WARNING: Force align sample rate from input " << sfinfoIn.samplerate << " because required ideal solution so far" << endl;
-        sampleRate = sfinfoIn.samplerate;
-    }
 
     if (channels == 0 && sfinfoIn.channels == 0) {
         cerr << "ERROR: Missing channels assignment or none of reference from input" << endl;
@@ -563,7 +621,7 @@ Stretcher::SetOutputFile(std::string fileName,
 
     sfinfoOut.channels = (channels) ? channels : sfinfoIn.channels;
     sfinfoOut.samplerate = (sampleRate) ? sampleRate : sfinfoIn.samplerate;
-    sfinfoOut.frames = int(sfinfoIn.frames * param->timeratio + 0.1);
+    sfinfoOut.frames = int(sfinfoIn.frames * param->timeratio * sfinfoOut.samplerate / sfinfoIn.samplerate + 0.1);
     sfinfoOut.format = (format) ? format : sfinfoIn.format;
     sfinfoOut.sections = sfinfoIn.sections;
     sfinfoOut.seekable = sfinfoIn.seekable;
@@ -575,8 +633,13 @@ Stretcher::SetOutputFile(std::string fileName,
         return false;
     }
 
-    if (sfinfoOut.channels != outSrcDesc.outputChannels) {
-        PrepareOutputBuffer(sfinfoOut.channels, defBlockSize, reserveBuffer);
+    if (sfinfoOut.channels != outSrcDesc.outputChannels || sfinfoOut.samplerate != outSrcDesc.sampleRate) {
+        PrepareOutputBuffer(sfinfoOut.channels, defBlockSize, reserveBuffer, sfinfoOut.samplerate);
+    }
+    // retrieved blocks go to writer thread, flushed by CloseOutputFile()
+    if (param->writeBehind > 0) {
+        fileWriter = new FileWriter(sfinfoOut.channels, defBlockSize, param->writeBehind);
+        fileWriter->Start(sndfileOut);
     }
     outSrcDesc = {
         SourceType::AudioFile,
@@ -594,17 +657,62 @@ void
 Stretcher::Create() {
     if (pts) {
         delete pts;
+        pts = nullptr;
+    }
+    if (psola) {
+        delete psola;
+        psola = nullptr;
+    }
+
+    // restart keeps live adjustments applied so far
+    if (!controlsLoaded) {
+        pitchScale = param->frequencyshift;
+        formantScale = param->formantscale;
+        formantEnabled = param->formant;
+        controlsLoaded = true;
     }
 
     // caller no longer care about SetOptions()
-    SetOptions(param->finer, param->realtime, param->typewin, param->smoothing, param->formant, param->together,
+    SetOptions(param->finer, param->realtime, param->typewin, param->smoothing, formantEnabled.load(), param->together,
         param->hqpitch, param->lamination, param->threading, param->transients, param->detector, param->crispness);
 
     size_t sampleRate = inSrcDesc.sampleRate;
     int channels = inSrcDesc.inputChannels;
     double timeRatio = param->timeratio;
-    double pitchScale = param->frequencyshift;
-    pts = new RubberBand::RubberBandStretcher(sampleRate, channels, options, timeRatio, pitchScale);
+    double scale = pitchScale.load();
+    if (param->psola) {
+        psola = new PsolaStretcher(sampleRate, channels, timeRatio, scale, param->psolaMinF0);
+        // grains keep formants by themselves, scale only applies if formant option is given
+        if (formantEnabled.load() && formantScale.load() > 0) {
+            psola->setFormantScale(formantScale.load());
+        }
+    } else {
+        pts = new RubberBand::RubberBandStretcher(sampleRate, channels, options, timeRatio, scale);
+    }
+    // restart of process is a new stream for output rate conversion as well
+    if (resampler) {
+        resampler->Reset();
+    }
+    // scale and key are validated by Parameters::ParseOptions()
+    if (!param->autotuneScale.empty() && !autoTune) {
+        autoTune = new AutoTune(param->autotuneScale, param->autotuneKey, param->retuneMs);
+    }
+    if (autoTune) {
+        autoTune->Reset();
+        autoTuneScale = scale;
+    }
+    if (param->gui || param->pitchTrack || autoTune) {
+        inPitch.Prepare((int)sampleRate);
+        outPitch.Prepare((int)sampleRate);
+    }
+    if (param->gui || !param->envelopeCsv.empty()) {
+        envelope.Prepare((int)sampleRate, 2048, param->envelopeCutoffMs, param->envelopeRate);
+        // restart keeps writing to the same file
+        if (!param->envelopeCsv.empty() && !envelope.IsCsvOpen() && !envelope.OpenCsv(param->envelopeCsv)) {
+            cerr << "WARNING: Can not write envelope csv " << param->envelopeCsv << endl;
+            param->envelopeCsv.clear();
+        }
+    }
     //assert(param->timeratio == timeRatio); // given from parameter should be equal to its pointer
     //assert(param->frequencyshift == pitchScale);
 }
@@ -626,15 +734,101 @@ Stretcher::MaxProcessSize(size_t samples) {
 
 double
 Stretcher::FormantScale(double scale) {
+    // 0 applies the scale in effect
+    if (scale <= 0) scale = formantScale.load();
+    if (psola) {
+        if (formantEnabled.load() && scale > 0) psola->setFormantScale(scale);
+        return psola->getFormantScale();
+    }
     if (!pts) return 0;
 
-    assert(scale == param->formantscale);
     if (scale > 0) {
         pts->setFormantScale(scale);
     }
     return pts->getFormantScale();
 }
 
+void
+Stretcher::PostControl(ControlChange::Type type, double value) {
+    std::lock_guard<std::mutex> lock(controlMutex);
+    // GUI slider can post many times between 2 blocks, only the latest value matters
+    for (auto& change : controlQueue) {
+        if (change.type == type) {
+            change.value = value;
+            return;
+        }
+    }
+    controlQueue.push_back({ type, value });
+}
+
+int
+Stretcher::ApplyControls() {
+    // try again next block if GUI thread is posting
+    std::unique_lock<std::mutex> lock(controlMutex, std::try_to_lock);
+    if (!lock.owns_lock() || controlQueue.empty()) return 0;
+
+    int applied = 0;
+    while (!controlQueue.empty()) {
+        ControlChange change = controlQueue.front();
+        controlQueue.pop_front();
+        switch (change.type) {
+        case ControlChange::PitchScale:
+            // NOTE: offline mode rubberband does not accept pitch scale changes once study or process has begun
+            if (change.value <= 0 || (pts && !param->realtime)) {
+                cerr << "WARNING: pitch scale " << change.value << " ignored, only changeable in realtime mode" << endl;
+                break;
+            }
+            // freqMap offsets are relative to this value
+            pitchScale = change.value;
+            if (pts) pts->setPitchScale(change.value);
+            if (psola) psola->setPitchScale(change.value);
+            applied++;
+            break;
+        case ControlChange::FormantScale:
+            if (change.value <= 0 || (pts && !param->realtime)) {
+                cerr << "WARNING: formant scale " << change.value << " ignored, only changeable in realtime mode" << endl;
+                break;
+            }
+            formantScale = change.value;
+            if (pts) {
+                // formant option can be changed after construction, no need to recreate
+                if (!formantEnabled.load()) {
+                    options |= RubberBandStretcher::OptionFormantPreserved;
+                    pts->setFormantOption(RubberBandStretcher::OptionFormantPreserved);
+                }
+                pts->setFormantScale(change.value);
+            }
+            if (psola) psola->setFormantScale(change.value);
+            formantEnabled = true;
+            applied++;
+            break;
+        case ControlChange::TimeRatio:
+            // NOTE: offline mode stretcher does not accept time ratio changes once study or process has begun
+            if (change.value <= 0 || !param->realtime) {
+                cerr << "WARNING: time ratio " << change.value << " ignored, only changeable in realtime mode" << endl;
+                break;
+            }
+            param->timeratio = change.value;
+            if (pts) pts->setTimeRatio(change.value);
+            if (psola) psola->setTimeRatio(change.value);
+            applied++;
+            break;
+        case ControlChange::InputGain:
+            inGain = (float)change.value;
+            applied++;
+            break;
+        case ControlChange::OutputGain:
+            outGain = (float)change.value;
+            applied++;
+            break;
+        }
+        if (debug > 0) {
+            cerr << "control change type " << change.type << " value " << change.value << " applied" << endl;
+        }
+    }
+    return applied;
+}
+
 void
 Stretcher::PrepareInputBuffer(int channels, int blocks, size_t reserves, int prevChannels) {
     // cleanup exists allocation
@@ -651,6 +845,7 @@ Stretcher::PrepareInputBuffer(int channels, int blocks, size_t reserves, int pre
     }
 
     ibuf = new float[channels * blocks];
+    probeBlock.assign((size_t)channels * blocks, 0.f);
     cbuf = new float *[channels];
     for (int c = 0; c < channels; ++c) {
         cbuf[c] = new float[blocks];
@@ -660,7 +855,11 @@ Stretcher::PrepareInputBuffer(int channels, int blocks, size_t reserves, int pre
         delete inBuffer;
         inBuffer = nullptr;
     }
-    inBuffer = new RingBuffer<float>(channels * blocks + reserves);
+    // ring depth in blocks replaces reserve, a shallow ring drops input instead of piling up latency
+    if (param->ringBlocks > 0) {
+        reserves = (size_t)channels * blocks * (param->ringBlocks - 1);
+    }
+    inBuffer = new SpscRingBuffer<float>(channels * blocks + reserves);
     // DEBUG: im sleepy and have no idea good to it
     if (inFrame) {
         delete inFrame;
@@ -670,7 +869,7 @@ Stretcher::PrepareInputBuffer(int channels, int blocks, size_t reserves, int pre
 }
 
 void
-Stretcher::PrepareOutputBuffer(int channels, int blocks, size_t reserves) {
+Stretcher::PrepareOutputBuffer(int channels, int blocks, size_t reserves, int sampleRate) {
     // cleanup exists allocation
     if (obuf) {
         delete obuf;
@@ -682,8 +881,14 @@ Stretcher::PrepareOutputBuffer(int channels, int blocks, size_t reserves) {
         delete outBuffer;
         outBuffer = nullptr;
     }
-    outBuffer = new RingBuffer<float>(channels * blocks + reserves);
-    outFrame = new float[channels * blocks + reserves];
+    // ring holds blocks at output rate, a converted block is longer than input block if output rate is higher
+    updateResampler(channels, inSrcDesc.sampleRate, sampleRate);
+    int outBlocks = resampler ? (int)resampler->GetMaxOutput(blocks) : blocks;
+    if (param->ringBlocks > 0) {
+        reserves = (size_t)channels * outBlocks * (param->ringBlocks - 1);
+    }
+    outBuffer = new SpscRingBuffer<float>(channels * outBlocks + reserves);
+    outFrame = new float[channels * outBlocks + reserves];
 }
 
 void
@@ -699,6 +904,10 @@ Stretcher::StudyInputSound(/*int blockSize*/) {
         cerr << "ERROR: Load input sound file before calls to study it" << endl;
         return;
     }
+    // reader thread must not share the file position, it starts again at next processed block
+    if (fileReader) {
+        fileReader->Stop();
+    }
     // reset file position
     sf_seek(sndfileIn, 0, SEEK_SET);
     int channels = sfinfoIn.channels;
@@ -749,8 +958,64 @@ Stretcher::StudyInputSound(/*int blockSize*/) {
     sf_seek(sndfileIn, 0, SEEK_SET);
 }
 
+int
+Stretcher::PrepareStreamStart() {
+    if (!pts && !psola) return 0;
+    int channels = inSrcDesc.inputChannels;
+    int outChannels = outSrcDesc.outputChannels;
+    int blockSize = defBlockSize;
+    // psola output is aligned to input, its latency is the delay of engine
+    int startDelay = pts ? (int)pts->getStartDelay() : (int)psola->getLatency();
+    int latency = pts ? (int)pts->getLatency() : (int)psola->getLatency();
+
+    int preroll = param->prerollFrames;
+    if (preroll < 0) {
+        if (param->lowLatency) {
+            // a block lands per input callback and one more absorbs bursts of rubberband output,
+            // plus rubberband latency which is not compensated by dropping start delay
+            preroll = 2 * blockSize + std::max(0, latency - startDelay);
+        } else {
+            preroll = 2000;
+        }
+    }
+    // pre-roll never starts if it does not fit in output ring besides the block being written
+    if (outBuffer && outChannels > 0) {
+        int capacity = (int)(outBuffer->getSize() / outChannels) - blockSize;
+        if (preroll > capacity) {
+            cerr << "WARNING: Pre-roll " << preroll << " frames exceeds output ring, use " << std::max(0, capacity) << endl;
+            preroll = std::max(0, capacity);
+        }
+    }
+    // input queued while rubberband stretcher was created would stay as latency for the whole session
+    if ((inStream || inVirtual) && inBuffer && channels > 0) {
+        inBuffer->skip(inBuffer->getReadSpace() / channels * channels);
+    }
+    outDelayFrames.store(preroll);
+
+    if (!(inStream || inVirtual) || !(outStream || outVirtual)) {
+        return preroll;
+    }
+    if (!quiet || param->lowLatency) {
+        // expected input to output delay of each stage, device latencies are reported by portaudio
+        double inRate = inSrcDesc.sampleRate > 0 ? inSrcDesc.sampleRate : 48000.0;
+        double outRate = outSrcDesc.sampleRate > 0 ? outSrcDesc.sampleRate : inRate;
+        double inDevice = (inStream && Pa_GetStreamInfo(inStream)) ? Pa_GetStreamInfo(inStream)->inputLatency * 1000.0 : 0.0;
+        double outDevice = (outStream && Pa_GetStreamInfo(outStream)) ? Pa_GetStreamInfo(outStream)->outputLatency * 1000.0 : 0.0;
+        double block = blockSize / inRate * 1000.0;
+        double stretcher = startDelay / inRate * 1000.0;
+        double conversion = (resampler ? resampler->GetLatency() : 0) / inRate * 1000.0;
+        double buffered = preroll / outRate * 1000.0;
+        cerr << "latency estimate: input device " << inDevice << "ms, block " << block << "ms, "
+            << (psola ? "psola " : "rubberband ")
+            << stretcher << "ms, resampler " << conversion << "ms, pre-roll " << buffered << "ms, output device "
+            << outDevice << "ms, total " << (inDevice + block + stretcher + conversion + buffered + outDevice) << "ms" << endl;
+    }
+    return preroll;
+}
+
 int
 Stretcher::ProcessStartPad() {
+    // psola needs neither padding nor dropping
     if (!pts) return 0;
     int toDrop = pts->getStartDelay();
     if (!param->realtime) return toDrop;
@@ -784,21 +1049,22 @@ void
 Stretcher::ApplyFreqMap(size_t countIn,/* int blockSize,*/ int *pAdjustedBlockSize) {
     // useless if no freqMap
     if (freqMap.size() == 0) return;
-    if (!pts) return;
+    if (!pts && !psola) return;
 
     int blockSize = Stretcher::defBlockSize; // only for original code design
     while (freqMapItr != freqMap.end()) {
         size_t nextFreqFrame = freqMapItr->first;
         // iterate key frame to counted input frame and apply the target pitch
         if (nextFreqFrame <= countIn) {
-            double s = param->frequencyshift * freqMapItr->second;
+            double s = pitchScale.load() * freqMapItr->second;
             if (debug > 0) {
                 cerr << "at frame " << countIn
                     << " (requested at " << freqMapItr->first
-                    << " [NOT] plus latency " << pts->getLatency()
+                    << " [NOT] plus latency " << (pts ? pts->getLatency() : psola->getLatency())
                     << ") updating frequency ratio to " << s << endl;
             }
-            pts->setPitchScale(s);
+            if (pts) pts->setPitchScale(s);
+            if (psola) psola->setPitchScale(s);
             ++freqMapItr;
         } else {
             // based on next key frame, effect to the next block size of next reading frame,
@@ -815,52 +1081,99 @@ Stretcher::ApplyFreqMap(size_t countIn,/* int blockSize,*/ int *pAdjustedBlockSi
 bool
 Stretcher::ProcessInputSound(/*int blockSize, */int *pFrame, size_t *pCountIn) {
     // simply check for function refactoring
-    if (!pts) return false;
+    if (!pts && !psola) return false;
 
     // for original code design, also be reused for retrieve data behavior
     int blockSize = Stretcher::defBlockSize;
     int channels = inSrcDesc.inputChannels;
     int count = -1;
     // separate by file or by stream
-    if (sndfileIn) {
+    // interleaved input of this block, file reader hands over its queued block without copy
+    const float* in = ibuf;
+    // mapped input without gui goes to cbuf directly, the others deinterleave `in` below
+    bool deinterleaved = false;
+    float peak = 0.f;
+    if (sndfileIn && mappedIn && !param->gui) {
+        // converted and deinterleaved straight from mapped pages
+        TRACE_SCOPE("mapped read");
+        count = (int)mappedIn->ReadChannels(cbuf, blockSize, inGain, &peak);
+        deinterleaved = true;
+    } else if (sndfileIn && mappedIn) {
+        // gui displays interleaved input, int16/int24 are converted into inFrame, float32 stays in mapped pages
+        TRACE_SCOPE("mapped read");
+        count = (int)mappedIn->Read(&in, inFrame, blockSize);
+    } else if (sndfileIn && fileReader) {
+        if (!fileReader->IsRunning()) {
+            fileReader->Start(sndfileIn);
+        }
+        TRACE_SCOPE("reader pop");
+        count = (int)fileReader->Front(&in);
+    } else if (sndfileIn) {
+        TRACE_SCOPE("sf_readf_float");
         if ((count = sf_readf_float(sndfileIn, ibuf, blockSize)) < 0) {
             return false;
         }
+    }
+    if (sndfileIn && param->gui && in != inFrame && count > 0) {
         // copy frame data to sther->inFrame likes input audio device callback does for GUI display
-        std::copy(ibuf, ibuf + channels * count, inFrame);
+        TRACE_SCOPE("inFrame copy");
+        std::copy(in, in + channels * count, inFrame);
     }
-    if (inStream) {
-        std::lock_guard<std::mutex> lock(inMutex);
-
+    if (inStream || inVirtual) {
         count = blockSize;
-        if (channels * count > inBuffer->getReadSpace()) {
-            return false; // buffer not enough for process
+        // sleep until input callback signals a whole block is available
+        auto waitBegin = std::chrono::steady_clock::now();
+        {
+            TRACE_SCOPE("wait input");
+            while ((size_t)channels * count > inBuffer->getReadSpace()) {
+                if (stop || !inSignal.Wait(signalTimeoutMs)) {
+                    return false; // buffer not enough for process, caller checks stop flag then comes back
+                }
+            }
         }
-        else {
+        waitHistogram.Add(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - waitBegin).count());
+        {
+            TRACE_SCOPE("inBuffer read");
             inBuffer->read(ibuf, channels * count);
         }
         // debug
         if (debugBuffer && time(nullptr) - debugTimestampIn >= 2) {
             debugTimestampIn = time(nullptr);
-            cerr << "input buffer usage " << (int)(((float)inBuffer->getReadSpace() / inBuffer->getSize()) * 100.f) << "%" << endl;
+            cerr << "input buffer usage " << (int)(((float)inBuffer->getReadSpace() / inBuffer->getSize()) * 100.f) << "%"
+                << " overruns:" << inOverruns.load() << " overflows:" << inOverflows.load() << endl;
         }
     }
 
-    bool debugMax = false;
-    float value;
-    for (int c = 0; c < channels; ++c) {
-        for (int i = 0; i < count; ++i) {
-            value = inGain * ibuf[i * channels + c];
-            if (value > 1.f) value = 1.f;
-            if (value < -1.f) value = -1.f;
-            cbuf[c][i] = value;
-            if (debugBuffer && debugInMaxVal < ibuf[i * channels + c]) {
-                debugInMaxVal = ibuf[i * channels + c];
-                debugMax = true;
-            }
+    auto processBegin = std::chrono::steady_clock::now();
+    // deinterleave with input gain and clamping, peak comes along as side result for metering
+    if (!deinterleaved) {
+        TRACE_SCOPE("deinterleave");
+        peak = DeinterleaveGainClamp(in, cbuf, channels, count, inGain);
+    }
+    if (inPitch.IsPrepared() && count > 0) {
+        inPitch.Process(cbuf, channels, count);
+    }
+    if (envelope.IsPrepared() && count > 0) {
+        envelope.Process(cbuf, channels, count);
+    }
+    // correction from f0 of this block is applied before processing it, user pitch scale stays the base
+    if (autoTune && count > 0) {
+        double base = pitchScale.load();
+        double correction = autoTune->Update(inPitch.GetLatest(), base, (double)count / inSrcDesc.sampleRate);
+        double s = base * correction;
+        if (fabs(s - autoTuneScale) > s * 1e-4) {
+            TRACE_SCOPE("autotune");
+            if (pts) pts->setPitchScale(s);
+            if (psola) psola->setPitchScale(s);
+            autoTuneScale = s;
         }
     }
-    if (debugMax) {
+    // block is consumed, reader may fill it again
+    if (sndfileIn && fileReader && count > 0) {
+        fileReader->Pop();
+    }
+    if (debugBuffer && debugInMaxVal < peak) {
+        debugInMaxVal = peak;
         cerr << "=== Input max value " << debugInMaxVal << ", gained " << debugInMaxVal * inGain << endl;
     }
 
@@ -884,7 +1197,19 @@ Stretcher::ProcessInputSound(/*int blockSize, */int *pFrame, size_t *pCountIn) {
         }
     }
 
-    pts->process(cbuf, count, isFinal);
+    {
+        TRACE_SCOPE("process");
+        if (psola) {
+            psola->process(cbuf, count, isFinal);
+        } else {
+            pts->process(cbuf, count, isFinal);
+        }
+    }
+    processHistogram.Add(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - processBegin).count());
+    if (debugBuffer && time(nullptr) - debugTimestampStats >= 2) {
+        debugTimestampStats = time(nullptr);
+        printDebugStats();
+    }
     // increase frame number to caller
     *pFrame += count;
     // DEBUG: only process input, return isFinal as result
@@ -902,8 +1227,8 @@ Stretcher::RetrieveAvailableData(size_t *pCountOut, bool isFinal) {
     bool clipping = false;
     int channels = inSrcDesc.inputChannels;
     int outChannels = outSrcDesc.outputChannels;
-    int outSamplerate = outSrcDesc.sampleRate;
-    while ((avail = pts->available()) >= 0) {
+    updateResampler(outChannels, inSrcDesc.sampleRate, outSrcDesc.sampleRate);
+    while ((avail = (psola ? psola->available() : pts->available())) >= 0) {
         if (debug > 1) {
             if (isFinal) {
                 cerr << "(completing) ";
@@ -916,7 +1241,7 @@ Stretcher::RetrieveAvailableData(size_t *pCountOut, bool isFinal) {
             break;
         }
         if (avail == 0 && isFinal) {
-            if (param->realtime ||
+            if (param->realtime || psola ||
                 (options & RubberBandStretcher::OptionThreadingNever)) {
                 break;
             } else {
@@ -940,7 +1265,11 @@ Stretcher::RetrieveAvailableData(size_t *pCountOut, bool isFinal) {
                 cerr << "toDrop = " << dropFrames << ", dropping "
                         << dropHere << " of " << avail << endl;
             }
-            pts->retrieve(cbuf, dropHere);
+            if (psola) {
+                psola->retrieve(cbuf, dropHere);
+            } else {
+                pts->retrieve(cbuf, dropHere);
+            }
             dropFrames -= dropHere;
             avail -= dropHere;
             // to next available processed block
@@ -950,7 +1279,14 @@ Stretcher::RetrieveAvailableData(size_t *pCountOut, bool isFinal) {
         if (debug > 2) {
             cerr << "retrieving block of " << blockSize << ", out = " << *pCountOut << endl;
         }
-        pts->retrieve(cbuf, blockSize);
+        {
+            TRACE_SCOPE("retrieve");
+            if (psola) {
+                psola->retrieve(cbuf, blockSize);
+            } else {
+                pts->retrieve(cbuf, blockSize);
+            }
+        }
 
         // process frames count alignment between input and output file in realtime mode,
         // NOTE: but it may not necessary for my real purpose w/o input and output files
@@ -972,63 +1308,102 @@ Stretcher::RetrieveAvailableData(size_t *pCountOut, bool isFinal) {
         }
 
         *pCountOut += blockSize;
+        if (outPitch.IsPrepared() && blockSize > 0) {
+            outPitch.Process(cbuf, channels, blockSize);
+        }
 
-        float value;
-        for (size_t c = 0; c < channels; ++c) {
-            for (int i = 0; i < blockSize; ++i) {
-                value = outGain * cbuf[c][i];
-                if (ignoreClipping) { // i.e. just clamp, don't bail out
-                    if (value > 1.f) value = 1.f;
-                    if (value < -1.f) value = -1.f;
-                } else {
-                    if (value >= 1.f || value < -1.f) {
-                        clipping = true;
-                        outGain = (0.999f / fabsf(cbuf[c][i]));
-                    }
-                }
-                cbuf[c][i] = value;
-                if (c < outChannels) {
-                    obuf[i * outChannels + c] = value;
-                }
-            }
+        // routing, gain and clip detection in one pass, ignoring clipping just clamps, don't bail out
+        if (channelMap.inChannels != channels || channelMap.outChannels != outChannels) {
+            updateChannelMap(channels, outChannels);
         }
-        // rest of channels if output has more than input
-        for (int c = channels; c < outChannels; ++c) {
-            for (int i = 0; i < blockSize; ++i) {
-                obuf[i * outChannels + c] = cbuf[0][i];
-            }
+        // interleave straight into a free block of file writer, handed over after device buffer copy,
+        // converted blocks have other length than writer blocks and are copied by writer instead
+        float* out = obuf;
+        if (fileWriter && !resampler) {
+            TRACE_SCOPE("writer acquire");
+            out = fileWriter->Acquire();
+        }
+        float peak;
+        {
+            TRACE_SCOPE("interleave");
+            peak = InterleaveChannelMap(cbuf, out, channelMap, blockSize, outGain, ignoreClipping);
+        }
+        if (!ignoreClipping && peak * outGain >= 1.f) {
+            clipping = true;
+            outGain = (0.999f / peak);
+        }
+        // frames at output rate from here
+        int outFrames = blockSize;
+        if (resampler) {
+            outFrames = (int)resampler->Process(out, blockSize, resampleBuffer.data());
+            out = resampleBuffer.data();
         }
 
-        int writable = outBuffer->getWriteSpace();
-        int outBufSize = outChannels * defBlockSize + reserveBuffer; // NOTE: same with PrepareOutputBuffer
+        size_t writable = outBuffer->getWriteSpace();
+        int outBufSize = (int)outBuffer->getSize();
         // NOTE: output buffer usage is low when input process in heavy work,
         //        correspondly, usage is high from lightweight input signals or output device rendering too slow.
-        // DEBUG: wait a latency until outStream consumed buffer before goes to next loop process incoming inputs,
-        //        this behavior IS NOT ideal if using audio device retrieves input signals realtime.
-        if (sndfileIn && writable < outBufSize / 2) {
-            // if available buffer less than 50%, wait a latency = 1000(ms) * ch * frame / sample rate
-            usleep(1000000.f * outChannels * defBlockSize / outSamplerate);
-        }
-        {
-            std::lock_guard<std::mutex> lock(outMutex);
-
-            writable = outBuffer->getWriteSpace();
-            if (outChannels * blockSize < writable) {
-                outBuffer->write(obuf, outChannels * blockSize);
-            }
-            if (debugBuffer && time(nullptr) - debugTimestampOut >= 2) { // print out internal n seconds
-                debugTimestampOut = time(nullptr);
-                cerr << "output buffer usage " << (int)((1.f - (float)writable / outBufSize) * 100.f) << "%" << endl;
+        // file input is faster than output device rendering, sleep until output callback consumed enough space
+        // for this block, this behavior IS NOT applied if using audio device retrieves input signals realtime.
+        size_t outSamples = (size_t)outChannels * outFrames;
+        // a block larger than the whole ring never fits, don't wait for it
+        if (sndfileIn && (outStream || outVirtual) && outSamples < outBuffer->getSize()) {
+            auto waitBegin = std::chrono::steady_clock::now();
+            TRACE_SCOPE("wait output");
+            while (outBuffer->getWriteSpace() <= outSamples && !stop) {
+                outSignal.Wait(signalTimeoutMs);
             }
+            waitHistogram.Add(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - waitBegin).count());
+        }
+        writable = outBuffer->getWriteSpace();
+        if (outSamples < writable) {
+            TRACE_SCOPE("outBuffer write");
+            outBuffer->write(out, outSamples);
+        } else if (outStream || outVirtual) {
+            outOverruns.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (debugBuffer && time(nullptr) - debugTimestampOut >= 2) { // print out internal n seconds
+            debugTimestampOut = time(nullptr);
+            cerr << "output buffer usage " << (int)((1.f - (float)writable / outBufSize) * 100.f) << "%"
+                << " underruns:" << outUnderruns.load() << " underflows:" << outUnderflows.load()
+                << " overruns:" << outOverruns.load() << endl;
+        }
+        if (param->measureLatency && probeCount.load() != probePrinted) {
+            auto probe = GetLatencyProbeStats();
+            probePrinted = probe.count;
+            cerr << "loopback latency " << probe.lastMs << "ms, min:" << probe.minMs << "ms mean:" << probe.meanMs
+                << "ms max:" << probe.maxMs << "ms n:" << probe.count << " lost:" << probe.lost << endl;
         }
 
         // output file before later variable changes for chunks
-        if (sndfileOut) {
-            sf_writef_float(sndfileOut, obuf, blockSize);
+        if (fileWriter && resampler) {
+            fileWriter->Write(out, outFrames);
+        } else if (fileWriter) {
+            fileWriter->Submit(out, blockSize);
+        } else if (sndfileOut) {
+            TRACE_SCOPE("sf_writef_float");
+            sf_writef_float(sndfileOut, out, outFrames);
         }
 
     } // while (avail)
 
+    // tail of converted stream held back by resampler filter
+    if (isFinal && resampler) {
+        int outFrames = (int)resampler->Flush(resampleBuffer.data());
+        size_t outSamples = (size_t)outChannels * outFrames;
+        if (outFrames > 0 && outSamples < outBuffer->getWriteSpace()) {
+            outBuffer->write(resampleBuffer.data(), outSamples);
+        } else if (outFrames > 0 && (outStream || outVirtual)) {
+            outOverruns.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (fileWriter) {
+            fileWriter->Write(resampleBuffer.data(), outFrames);
+        } else if (sndfileOut) {
+            sf_writef_float(sndfileOut, resampleBuffer.data(), outFrames);
+        }
+        resampler->Reset();
+    }
+
     if (clipping) {
         if (outGain < minGain) {
             cerr << "NOTE: Clipping detected at output sample "
@@ -1052,8 +1427,211 @@ Stretcher::RetrieveAvailableData(size_t *pCountOut, bool isFinal) {
     return true;
 }
 
+void
+Stretcher::BeginProcess(int64_t inputFrames) {
+    Create();
+    if (inSrcDesc.type == SourceType::AudioFile) {
+        ExpectedInputDuration(inputFrames); // estimate from input file
+    }
+    MaxProcessSize(defBlockSize);
+    FormantScale(); // may changed by live adjustment before restart
+    SetIgnoreClipping(param->ignoreClipping);
+    inputCount = 0;
+    outputCount = 0;
+    // The stretcher only pads the start in offline mode; to avoid
+    // a fade in at the start, we pad it manually in RT mode. Both
+    // of these functions are defined to return zero in offline mode
+    SetDropFrames(ProcessStartPad());
+    PrepareStreamStart();
+}
+
+bool
+Stretcher::ProcessBlock(int *pFrame, bool *pFinal) {
+    // adjustments from GUI, before freqMap which is relative to current frequency shift
+    ApplyControls();
+    int thisBlockSize = defBlockSize;
+    ApplyFreqMap(inputCount, &thisBlockSize);
+    // frame number is actual given rubberband stretcher input frames,
+    // input count is read frames from input source
+    bool isFinal = ProcessInputSound(pFrame, &inputCount);
+    if (pFinal) *pFinal = isFinal;
+    // retrieve processed data to out buffer and result if clipping occurred
+    return RetrieveAvailableData(&outputCount, isFinal);
+}
+
+bool
+Stretcher::IsParallelRender() const {
+    return param->jobs != 1 && !param->gui && !param->psola && param->autotuneScale.empty() && param->envelopeCsv.empty() &&
+        inSrcDesc.type == SourceType::AudioFile && outSrcDesc.type == SourceType::AudioFile;
+}
+
+bool
+Stretcher::RenderParallel(size_t *pCountIn, size_t *pCountOut, ParallelRenderer::ProgressFn progress) {
+    if (!sndfileIn || !sndfileOut) {
+        cerr << "ERROR: Parallel render requires both input and output files" << endl;
+        return false;
+    }
+    // the same options as Create(), renderer turns off rubberband threading by itself
+    SetOptions(param->finer, param->realtime, param->typewin, param->smoothing, param->formant, param->together,
+        param->hqpitch, param->lamination, param->threading, param->transients, param->detector, param->crispness);
+
+    ParallelRenderer renderer(param, options, freqMap, debug);
+    renderer.SetInputGain(inGain);
+    renderer.SetBlockSize(defBlockSize);
+    int outChannels = outSrcDesc.outputChannels;
+    auto write = [this](const float* buf, size_t frames) {
+        if (fileWriter) {
+            fileWriter->Write(buf, frames);
+        } else {
+            TRACE_SCOPE("sf_writef_float");
+            sf_writef_float(sndfileOut, buf, frames);
+        }
+    };
+    updateResampler(outChannels, inSrcDesc.sampleRate, outSrcDesc.sampleRate);
+    if (resampler) {
+        resampler->Reset();
+    }
+    bool result = renderer.Render(inSrcDesc.desc, outChannels,
+        [this, &write, outChannels](const float* buf, size_t frames) {
+            if (!resampler) {
+                write(buf, frames);
+                return;
+            }
+            // stitched segments arrive in order, convert in blocks fit to resample buffer
+            for (size_t done = 0; done < frames; ) {
+                size_t n = std::min(frames - done, (size_t)defBlockSize);
+                size_t converted = resampler->Process(buf + done * outChannels, n, resampleBuffer.data());
+                write(resampleBuffer.data(), converted);
+                done += n;
+            }
+        },
+        progress, pCountIn, pCountOut);
+    if (result && resampler) {
+        write(resampleBuffer.data(), resampler->Flush(resampleBuffer.data()));
+    }
+    return result;
+}
+
+int
+Stretcher::ProcessBatch() {
+    // the same options as Create(), batch processor turns off rubberband threading by itself
+    SetOptions(param->finer, param->realtime, param->typewin, param->smoothing, param->formant, param->together,
+        param->hqpitch, param->lamination, param->threading, param->transients, param->detector, param->crispness);
+    if (freqMap.size() > 0) {
+        cerr << "WARNING: Frequency or pitch map is not applied to batch files" << endl;
+    }
+    if (param->psola) {
+        cerr << "WARNING: TD-PSOLA engine is not available for batch files, use rubberband" << endl;
+    }
+    if (!param->autotuneScale.empty()) {
+        cerr << "WARNING: Autotune is not applied to batch files" << endl;
+    }
+    if (!param->envelopeCsv.empty()) {
+        cerr << "WARNING: Envelope is not exported for batch files" << endl;
+    }
+    if (param->outputRate > 0) {
+        cerr << "WARNING: Output rate is not applied to batch files, output keeps input rate" << endl;
+    }
+
+    BatchProcessor batch(param, options, debug);
+    batch.SetBlockSize(defBlockSize);
+    bool loaded = fs::is_directory(param->batchPath) ?
+        batch.LoadDirectory(param->batchPath, param->batchOutDir) :
+        batch.LoadManifest(param->batchPath);
+    if (!loaded) return -1;
+    return batch.Run();
+}
+
+void
+Stretcher::updateChannelMap(int inChannels, int outChannels) {
+    if (!ChannelMap::Parse(param->channelMap, inChannels, outChannels, &channelMap)) {
+        cerr << "WARNING: invalid channel map \"" << param->channelMap << "\" for " << inChannels
+            << " to " << outChannels << " channels, use default" << endl;
+    }
+    if (debug > 0) {
+        cerr << "channel map " << inChannels << " to " << outChannels << ":";
+        for (int o = 0; o < outChannels; ++o) {
+            int source = channelMap.Source(o);
+            cerr << " " << (source >= 0 ? std::to_string(source) : (source == -1 ? "-" : "mix"));
+        }
+        cerr << endl;
+    }
+}
+
+void
+Stretcher::updateResampler(int channels, int inRate, int outRate) {
+    if (inRate <= 0 || outRate <= 0 || inRate == outRate) {
+        if (resampler) {
+            delete resampler;
+            resampler = nullptr;
+        }
+        return;
+    }
+    if (resampler && resampler->GetChannels() == channels &&
+        resampler->GetInputRate() == inRate && resampler->GetOutputRate() == outRate) {
+        return;
+    }
+    Resampler::Quality quality = Resampler::Medium;
+    if (!Resampler::ParseQuality(param->resampleQuality, &quality)) {
+        cerr << "WARNING: unknown resample quality \"" << param->resampleQuality << "\", use "
+            << Resampler::GetQualityName(quality) << endl;
+    }
+    if (resampler) {
+        delete resampler;
+    }
+    resampler = new Resampler(channels, inRate, outRate, quality, defBlockSize);
+    // a block or the flushed tail, whichever is longer
+    size_t frames = std::max((size_t)defBlockSize, (size_t)resampler->GetLatency());
+    resampleBuffer.assign(resampler->GetMaxOutput(frames) * channels, 0.f);
+    if (!quiet) {
+        cerr << "NOTE: Converting sample rate " << inRate << " to " << outRate << " for output, quality "
+            << Resampler::GetQualityName(quality) << ", latency " << resampler->GetLatency() << " frames" << endl;
+    }
+}
+
+void
+Stretcher::printDebugStats() {
+    auto wall = std::chrono::steady_clock::now();
+    std::clock_t cpu = std::clock();
+    double wallSec = std::chrono::duration<double>(wall - debugStatsWall).count();
+    double cpuSec = double(cpu - debugStatsCpu) / CLOCKS_PER_SEC;
+    // NOTE: clock() is process cpu time, it includes GUI and rubberband threads
+    cerr << "cpu usage " << (wallSec > 0.0 ? (int)(cpuSec / wallSec * 100.0) : 0) << "% of a core, ";
+    waitHistogram.Print(cerr, "wait");
+    cerr << ", ";
+    processHistogram.Print(cerr, "process");
+    if (fileReader) {
+        cerr << ", reader queued " << fileReader->GetQueued() << "/" << fileReader->GetDepth()
+            << " starvations " << fileReader->GetStarvations();
+    }
+    if (autoTune) {
+        cerr << ", autotune note " << autoTune->GetTargetNote() << " correction " << (int)autoTune->GetCorrectionCents() << " cents";
+    }
+    if (param->pitchTrack) {
+        PitchPoint in = inPitch.GetLatest(), out = outPitch.GetLatest();
+        cerr << ", f0 in " << in.f0 << "Hz (" << in.confidence << ") out " << out.f0 << "Hz (" << out.confidence << ")";
+    }
+    cerr << endl;
+    waitHistogram.Reset();
+    processHistogram.Reset();
+    debugStatsWall = wall;
+    debugStatsCpu = cpu;
+}
+
 void
 Stretcher::CloseInputFile() {
+    if (fileReader) {
+        if (!quiet) {
+            cerr << "file reader blocks " << fileReader->GetBlocksRead() << ", starvations " << fileReader->GetStarvations()
+                << " (" << fileReader->GetStarvedMicros() / 1000.0 << "ms)" << endl;
+        }
+        delete fileReader;
+        fileReader = nullptr;
+    }
+    if (mappedIn) {
+        delete mappedIn;
+        mappedIn = nullptr;
+    }
     if (sndfileIn) {
         sf_close(sndfileIn);
         sndfileIn = nullptr;
@@ -1062,6 +1640,19 @@ Stretcher::CloseInputFile() {
 
 void
 Stretcher::CloseOutputFile() {
+    if (fileWriter) {
+        // writes the rest of queued blocks before file is closed
+        fileWriter->Close();
+        if (!quiet) {
+            cerr << "file writer frames " << fileWriter->GetFramesWritten() << " in " << fileWriter->GetWriteCalls()
+                << " writes, stalls " << fileWriter->GetStalls() << endl;
+        }
+        if (fileWriter->GetErrors() > 0) {
+            cerr << "ERROR: Failed " << fileWriter->GetErrors() << " writes to output file \"" << outSrcDesc.desc << "\"" << endl;
+        }
+        delete fileWriter;
+        fileWriter = nullptr;
+    }
     if (sndfileOut) {
         sf_close(sndfileOut);
         sndfileOut = nullptr;
@@ -1069,9 +1660,42 @@ Stretcher::CloseOutputFile() {
 }
 
 
+bool
+Stretcher::initAudioDevices() {
+    if (paInitialized) return true;
+    PaError err = Pa_Initialize();
+    if (err != paNoError) {
+        cerr << "ERROR: Pa_Initialize returned " << Pa_GetErrorText(err) << endl;
+        return false;
+    }
+    paInitialized = true;
+    return true;
+}
+
+int
+Stretcher::RefreshAudioDevices(std::vector<SourceDesc>& devices) {
+    // portaudio only enumerates devices at initialization
+    if (paInitialized) {
+        if (inStream || outStream) {
+            cerr << "WARNING: Close audio streams before refreshing device list" << endl;
+            devices = deviceList;
+            return (int)devices.size();
+        }
+        Pa_Terminate();
+        paInitialized = false;
+    }
+    deviceListValid = false;
+    return ListAudioDevices(devices);
+}
+
 int
 Stretcher::ListAudioDevices(std::vector<SourceDesc>& devices) {
+    if (deviceListValid) {
+        devices = deviceList;
+        return (int)devices.size();
+    }
     devices.clear();
+    if (!initAudioDevices()) return -1;
     // list host apis
     int num_apis = 0;
     num_apis = Pa_GetHostApiCount();
@@ -1107,6 +1731,8 @@ Stretcher::ListAudioDevices(std::vector<SourceDesc>& devices) {
             static_cast<int>(dev_info->defaultSampleRate)
             });
     }
+    deviceList = devices;
+    deviceListValid = true;
     return num_devices;
 }
 
@@ -1119,27 +1745,27 @@ Stretcher::inputAudioCallback(
     void *data
     ) {
     Stretcher *pst = (Stretcher *)data;
+    Trace::SetThreadName("input callback");
+    TRACE_SCOPE("input callback");
 
     float *in = (float*)inBuffer;
     int channels = pst->inSrcDesc.inputChannels;
-    // TODO: may quick check levels to drop frames prevent too many input can't process immediately
-    {
-        std::lock_guard<std::mutex> lock(pst->inMutex); // automatically unlock when exit the code scope
-
-        int writable = pst->inBuffer->getWriteSpace();
-        if (channels * frames > writable) {
-            /*if (pst->debugBuffer) {
-                cerr << "input buffer is full" << endl;
-            }*/
-        } else {
-            // move to process function
-            /*if (pst->debugBuffer) {
-                cerr << "input buffer usage " << (int)((1.f - (float)writable / pst->inBuffer->getSize()) * 100.f) << "%" << endl;
-            }*/
-            pst->inBuffer->write(in, channels * frames);
-        }
+    if (flags & paInputOverflow) {
+        pst->inOverflows.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (pst->param->measureLatency) {
+        in = pst->probeInput(in, frames, timeInfo);
     }
+    // NOTE: never block in realtime callback, the whole block is dropped if stretcher thread can't catch up
+    size_t writable = pst->inBuffer->getWriteSpace();
+    if (channels * frames > writable) {
+        pst->inOverruns.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        pst->inBuffer->write(in, channels * frames);
+    }
+    pst->inSignal.Signal();
     //DEBUG: write to frame buffer for GUI rendering, i decide to ignore anything if buffer is full
+    TRACE_SCOPE("inFrame copy");
     std::copy(in, in + channels * frames, pst->inFrame);
     //memcpy_s(pst->inFrame, pst->inputChannels * frames, in, pst->inputChannels * frames);
 
@@ -1155,37 +1781,153 @@ Stretcher::outputAudioCallback(
         void *data
     ){
     Stretcher *pst = (Stretcher *)data;
+    Trace::SetThreadName("output callback");
+    TRACE_SCOPE("output callback");
 
     //float *in = (float*)inBuffer;
     float *out = (float*)outBuffer;
     int channels = pst->outSrcDesc.outputChannels;
-    {
-        std::lock_guard<std::mutex> lock(pst->outMutex); // automatically unlock when exit the code scope
-
-        if (pst->outDelayFrames > 0) {
-            pst->outDelayFrames -= frames;
-            if (pst->outDelayFrames < 0) {
-                cerr << "=== Start reading outputs ====" << endl;
-            }
+    if (flags & paOutputUnderflow) {
+        pst->outUnderflows.fetch_add(1, std::memory_order_relaxed);
+    }
+    int preroll = pst->outDelayFrames.load(std::memory_order_acquire);
+    if (preroll > 0) {
+        // pre-roll silence until enough processed frames are buffered
+        if (pst->outBuffer->getReadSpace() < (size_t)channels * preroll) {
+            memset(out, 0, sizeof(float) * channels * frames);
             return paContinue;
         }
-        if (channels * frames > pst->outBuffer->getReadSpace()) {
-            /*if (pst->debugBuffer) {
-                cerr << "output buffer is not enough" << endl;
-            }*/
-        } else {
-            pst->outBuffer->read(out, channels * frames);
-        }
+        pst->outDelayFrames.store(0, std::memory_order_release);
+        cerr << "=== Start reading outputs ====" << endl;
+    }
+    if (channels * frames > pst->outBuffer->getReadSpace()) {
+        // not enough processed frames, render silence instead of stale device buffer
+        pst->outUnderruns.fetch_add(1, std::memory_order_relaxed);
+        memset(out, 0, sizeof(float) * channels * frames);
+    } else {
+        pst->outBuffer->read(out, channels * frames);
     }
+    if (pst->probePending.load(std::memory_order_acquire)) {
+        pst->probeOutput(out, frames, timeInfo);
+    }
+    pst->outSignal.Signal();
     //DEBUG: write to frame buffer for GUI rendering, i decide to ignore anything if buffer is full
+    TRACE_SCOPE("outFrame copy");
     std::copy(out, out + channels * frames, pst->outFrame);
     //memcpy_s(pst->outFrame, pst->outputChannels * frames, out, pst->outputChannels * frames);
 
     return paContinue;
 }
 
+XrunCounters
+Stretcher::GetXrunCounters() const {
+    XrunCounters counters;
+    counters.inputOverruns = inOverruns.load(std::memory_order_relaxed);
+    counters.inputOverflows = inOverflows.load(std::memory_order_relaxed);
+    counters.outputUnderruns = outUnderruns.load(std::memory_order_relaxed);
+    counters.outputUnderflows = outUnderflows.load(std::memory_order_relaxed);
+    counters.outputOverruns = outOverruns.load(std::memory_order_relaxed);
+    return counters;
+}
+
+// muted window around impulse, the detector never triggers on the signal itself
+static const double probeQuietSeconds = 0.25;
+static const double probeIntervalSeconds = 2.0;
+// rubberband spreads the impulse over its window, the peak is searched for a while after first crossing
+static const double probeSearchSeconds = 0.05;
+static const double probeTimeoutSeconds = 1.0;
+static const float probeThreshold = 0.05f;
+
+float*
+Stretcher::probeInput(float* in, unsigned long frames, const PaStreamCallbackTimeInfo* timeInfo) {
+    int channels = inSrcDesc.inputChannels;
+    // never allocate in callback, skip measurement if callback is larger than prepared block
+    if (probeBlock.size() < (size_t)channels * frames || inSrcDesc.sampleRate <= 0) return in;
+    // some host apis report 0 for adc time, current time still shares the clock with output stream
+    double adc = timeInfo ? (timeInfo->inputBufferAdcTime > 0.0 ? timeInfo->inputBufferAdcTime : timeInfo->currentTime) : 0.0;
+    double rate = inSrcDesc.sampleRate;
+    if (probeMuted <= 0) {
+        if (probePending.load(std::memory_order_acquire) || adc < probeNextTime) return in;
+        int quietFrames = (int)(rate * probeQuietSeconds);
+        probeMuted = 2 * quietFrames;
+        probeImpulseIn = quietFrames;
+    }
+    memset(probeBlock.data(), 0, sizeof(float) * channels * frames);
+    if (probeImpulseIn >= 0 && probeImpulseIn < (int)frames) {
+        for (int c = 0; c < channels; ++c) {
+            probeBlock[(size_t)probeImpulseIn * channels + c] = 1.f;
+        }
+        probePeak = 0.0;
+        probeSearchEnd = 0.0;
+        probeAdcTime.store(adc + probeImpulseIn / rate);
+        probePending.store(true, std::memory_order_release);
+        probeNextTime = adc + probeIntervalSeconds;
+        probeImpulseIn = -1;
+    } else if (probeImpulseIn >= 0) {
+        probeImpulseIn -= (int)frames;
+    }
+    probeMuted -= (int)frames;
+    return probeBlock.data();
+}
+
+void
+Stretcher::probeOutput(const float* out, unsigned long frames, const PaStreamCallbackTimeInfo* timeInfo) {
+    int channels = outSrcDesc.outputChannels;
+    if (outSrcDesc.sampleRate <= 0) return;
+    double dac = timeInfo ? (timeInfo->outputBufferDacTime > 0.0 ? timeInfo->outputBufferDacTime : timeInfo->currentTime) : 0.0;
+    double rate = outSrcDesc.sampleRate;
+    double adc = probeAdcTime.load();
+    for (unsigned long i = 0; i < frames; ++i) {
+        for (int c = 0; c < channels; ++c) {
+            double v = fabs(out[i * channels + c]);
+            if (v > probeThreshold && v > probePeak) {
+                probePeak = v;
+                probePeakTime = dac + i / rate;
+                if (probeSearchEnd == 0.0) {
+                    probeSearchEnd = probePeakTime + probeSearchSeconds;
+                }
+            }
+        }
+    }
+    if (probeSearchEnd > 0.0 && dac + frames / rate >= probeSearchEnd) {
+        double ms = (probePeakTime - adc) * 1000.0;
+        uint64_t n = probeCount.load(std::memory_order_relaxed);
+        if (n == 0 || ms < probeMinMs.load()) probeMinMs.store(ms);
+        if (n == 0 || ms > probeMaxMs.load()) probeMaxMs.store(ms);
+        probeSumMs.store(probeSumMs.load() + ms);
+        probeLastMs.store(ms);
+        probeCount.store(n + 1, std::memory_order_release);
+        probePending.store(false, std::memory_order_release);
+    } else if (probeSearchEnd == 0.0 && dac - adc > probeTimeoutSeconds) {
+        probeLost.fetch_add(1, std::memory_order_relaxed);
+        probePending.store(false, std::memory_order_release);
+    }
+}
+
+LatencyProbeStats
+Stretcher::GetLatencyProbeStats() const {
+    LatencyProbeStats stats;
+    stats.count = probeCount.load(std::memory_order_acquire);
+    stats.lost = probeLost.load(std::memory_order_relaxed);
+    stats.lastMs = probeLastMs.load();
+    stats.minMs = probeMinMs.load();
+    stats.maxMs = probeMaxMs.load();
+    stats.meanMs = stats.count ? probeSumMs.load() / stats.count : 0.0;
+    return stats;
+}
+
+void
+Stretcher::ResetXrunCounters() {
+    inOverruns = 0;
+    inOverflows = 0;
+    outUnderruns = 0;
+    outUnderflows = 0;
+    outOverruns = 0;
+}
+
 bool
 Stretcher::SetInputStream(int index, int *pSampleRate, int *pChannels) {
+    if (!initAudioDevices()) return false;
     // move to member pa dev ptr
     inInfo = Pa_GetDeviceInfo(index);
     if (!inInfo) {
@@ -1241,6 +1983,7 @@ Stretcher::SetInputStream(int index, int *pSampleRate, int *pChannels) {
 
 bool
 Stretcher::SetOutputStream(int index) {
+    if (!initAudioDevices()) return false;
 
     outInfo = Pa_GetDeviceInfo(index);
     if (!outInfo) {
@@ -1264,11 +2007,22 @@ Stretcher::SetOutputStream(int index) {
     outParam.suggestedLatency = outInfo->defaultLowOutputLatency;
     outParam.hostApiSpecificStreamInfo = NULL;
 
+    // device runs at its own rate, stretcher output is converted if it differs from input rate
+    double sampleRate = outInfo->defaultSampleRate;
+    if (param->outputRate > 0) {
+        if (Pa_IsFormatSupported(nullptr, &outParam, param->outputRate) == paFormatIsSupported) {
+            sampleRate = param->outputRate;
+        } else {
+            cerr << "WARNING: Output device does not support sample rate " << param->outputRate
+                << ", use default " << sampleRate << endl;
+        }
+    }
+
     PaError er = Pa_OpenStream(
         &outStream,
         nullptr,
         &outParam,
-        outInfo->defaultSampleRate,
+        sampleRate,
         Stretcher::defBlockSize,
         paNoFlag,
         outputAudioCallback,
@@ -1276,8 +2030,8 @@ Stretcher::SetOutputStream(int index) {
     );
     cerr << "Open output stream result " << er << endl;
 
-    if (outInfo->maxOutputChannels != outSrcDesc.outputChannels) {
-        PrepareOutputBuffer(outInfo->maxOutputChannels, defBlockSize, reserveBuffer);
+    if (outInfo->maxOutputChannels != outSrcDesc.outputChannels || (int)sampleRate != outSrcDesc.sampleRate) {
+        PrepareOutputBuffer(outInfo->maxOutputChannels, defBlockSize, reserveBuffer, (int)sampleRate);
     }
     outSrcDesc = {
         SourceType::AudioDevice,
@@ -1285,11 +2039,101 @@ Stretcher::SetOutputStream(int index) {
         std::string(outInfo->name),
         outInfo->maxInputChannels,
         outInfo->maxOutputChannels,
-        static_cast<int>(outInfo->defaultSampleRate)
+        static_cast<int>(sampleRate)
     };
 
     return er == paNoError;
 }
 
+bool
+Stretcher::SetInputVirtual(std::string spec, int *pSampleRate, int *pChannels, int64_t *pFramesCount) {
+    closeInputVirtual();
+    if (inStream) {
+        Pa_CloseStream(inStream);
+        inStream = nullptr;
+    }
+
+    inVirtual = new VirtualDevice(VirtualDevice::Direction::Input, spec);
+    inVirtual->SetRate(param->virtualRate);
+    inVirtual->SetJitter(param->virtualJitterMs);
+    // synthetic signal length, file source overrides by its frames
+    inVirtual->SetLength((int64_t)(param->virtualSeconds * param->virtualSampleRate));
+    if (!inVirtual->Open(param->virtualSampleRate, param->virtualChannels, defBlockSize, inputAudioCallback, (void *)this)) {
+        closeInputVirtual();
+        return false;
+    }
+    int sampleRate = inVirtual->GetSampleRate();
+    int channels = inVirtual->GetChannels();
+    cerr << "IN " << inVirtual->GetName() << " ich:" << channels << " samplerate:" << sampleRate
+        << " rate:" << param->virtualRate << " jitter:" << param->virtualJitterMs << "ms"
+        << " frames:" << inVirtual->GetLength() << endl;
+
+    if (channels != inSrcDesc.inputChannels) {
+        PrepareInputBuffer(channels, defBlockSize, reserveBuffer, inSrcDesc.inputChannels);
+    }
+    inSrcDesc = {
+        SourceType::AudioVirtual,
+        -1,
+        inVirtual->GetName(),
+        channels,
+        0,
+        sampleRate
+    };
+
+    if (pSampleRate) *pSampleRate = sampleRate;
+    if (pChannels) *pChannels = channels;
+    if (pFramesCount) *pFramesCount = inVirtual->GetLength();
+
+    return true;
+}
+
+bool
+Stretcher::SetOutputVirtual(std::string spec, int sampleRate, int channels) {
+    closeOutputVirtual();
+    if (outStream) {
+        Pa_CloseStream(outStream);
+        outStream = nullptr;
+    }
+
+    outVirtual = new VirtualDevice(VirtualDevice::Direction::Output, spec);
+    outVirtual->SetRate(param->virtualRate);
+    outVirtual->SetJitter(param->virtualJitterMs);
+    if (!outVirtual->Open(sampleRate, channels, defBlockSize, outputAudioCallback, (void *)this)) {
+        closeOutputVirtual();
+        return false;
+    }
+    cerr << "OUT " << outVirtual->GetName() << " och:" << channels << " samplerate:" << sampleRate
+        << " rate:" << param->virtualRate << " jitter:" << param->virtualJitterMs << "ms" << endl;
+
+    if (channels != outSrcDesc.outputChannels || sampleRate != outSrcDesc.sampleRate) {
+        PrepareOutputBuffer(channels, defBlockSize, reserveBuffer, sampleRate);
+    }
+    outSrcDesc = {
+        SourceType::AudioVirtual,
+        -1,
+        outVirtual->GetName(),
+        0,
+        channels,
+        sampleRate
+    };
+
+    return true;
+}
+
+void
+Stretcher::closeInputVirtual() {
+    if (inVirtual) {
+        delete inVirtual;
+        inVirtual = nullptr;
+    }
+}
+
+void
+Stretcher::closeOutputVirtual() {
+    if (outVirtual) {
+        delete outVirtual;
+        outVirtual = nullptr;
+    }
+}
 
 } //namespace PitchShifting
\ No newline at end of file
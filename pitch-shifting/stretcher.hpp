@@ -40,16 +40,46 @@
 #include <mutex>
 #include <condition_variable>
 #include <deque>
-#include "src/common/RingBuffer.h"
-// for ChannelData struct
-#include <src/finer/R3Stretcher.h>
+#include <atomic>
+#include "ringbuffer.hpp"
+// for waking stretcher thread from audio callbacks and timing statistics
+#include <chrono>
+#include "semaphore.hpp"
+#include "histogram.hpp"
+// vectorized sample kernels on process path
+#include "kernels.hpp"
+// headless device drives the same stream callbacks without sound card
+#include "virtualdevice.hpp"
+// scoped trace points on process stages
+#include "trace.hpp"
+// offline file to file segments on worker pool
+#include "parallelrender.hpp"
+// prefetch input file blocks on reader thread
+#include "filereader.hpp"
+// write-behind output file blocks on writer thread
+#include "filewriter.hpp"
+// low latency pitch shift engine instead of rubberband
+#include "psola.hpp"
+// fundamental frequency of input and output blocks for GUI and API
+#include "pitchtracker.hpp"
+// pitch correction to a scale driven by input f0
+#include "autotune.hpp"
+// spectral envelope of input for formant plot and export
+#include "envelope.hpp"
+// zero-copy input of uncompressed wav
+#include "mappedfile.hpp"
+// cached local file info and waveform peaks
+#include "peakcache.hpp"
+// background scan of local files on worker pool
+#include "filescanner.hpp"
+// sample rate conversion to output file or device rate
+#include "resampler.hpp"
 // for all options to replace partial local variables
 #include "parameters.h"
 
 using std::cerr;
 using std::endl;
 using RubberBand::RubberBandStretcher;
-using RubberBand::RingBuffer;
 using std::string;
 
 namespace PitchShifting {
@@ -58,6 +88,7 @@ enum SourceType {
     Unknown,
     AudioFile,
     AudioDevice,
+    AudioVirtual, // headless device clocked by its own thread, see virtualdevice.hpp
 };
 struct SourceDesc {
     SourceType type = SourceType::Unknown;
@@ -71,6 +102,37 @@ struct SourceDesc {
     inline bool operator!() const { return type == SourceType::Unknown || index == -1; }
 };
 
+/* xrun counters for audio device streams, snapshot from atomic counters in stretcher */
+struct XrunCounters {
+    uint64_t inputOverruns = 0; // input block dropped, ring buffer has no space
+    uint64_t inputOverflows = 0; // reported by portaudio callback flags
+    uint64_t outputUnderruns = 0; // output block filled by silence, ring buffer has not enough data
+    uint64_t outputUnderflows = 0; // reported by portaudio callback flags
+    uint64_t outputOverruns = 0; // processed block dropped, output ring buffer has no space
+};
+
+/* loopback measurement of injected impulse from input adc time to output dac time, refer to --measure-latency */
+struct LatencyProbeStats {
+    uint64_t count = 0; // impulses detected at output
+    uint64_t lost = 0; // impulses not detected within timeout
+    double lastMs = 0.0;
+    double minMs = 0.0;
+    double maxMs = 0.0;
+    double meanMs = 0.0;
+};
+
+/* live adjustment posted by GUI or API caller, applied by stretcher thread at block boundary */
+struct ControlChange {
+    enum Type : int {
+        PitchScale, // frequency ratio
+        FormantScale, // formant envelope ratio, enables formant preserved
+        TimeRatio, // only works in realtime mode
+        InputGain, // level, not db
+        OutputGain // level, not db
+    } type;
+    double value;
+};
+
 class Stretcher {
 public:
     Stretcher(Parameters* parameters, int defBlockSize = 1024, int dbgLevel = 1);
@@ -90,14 +152,22 @@ public:
     void SetIgnoreClipping(bool ignore) { ignoreClipping = ignore; };
 
     // helper function to get SF_FORMAT_XXXX from file extension, \return 0 if not found
-    int GetFileFormat(std::string extName);
-    // list the local audio files to a list
+    static int GetFileFormat(std::string extName);
+    // list the local audio files to a list, file info comes from peak cache if unchanged, blocks until scanned
     int ListLocalFiles(std::vector<SourceDesc>& files);
+    // scan local audio files in background, onFound is called from worker threads in any order with index -1,
+    // \return false if scan directory does not exist
+    bool ScanLocalFiles(std::function<void(const SourceDesc&)> onFound);
+    // stop background scan, no more onFound calls after return
+    void CancelLocalScan();
+    bool IsScanningLocalFiles() const { return fileScanner && fileScanner->IsRunning(); }
+    // local library cache shared with GUI waveform and file scanner, created by the first call (main thread)
+    PeakCache* GetPeakCache();
     // load input before create stretcher for time ratio and frames duration given to rubberband
     bool LoadInputFile(std::string fileName,
         int *pSampleRate, int *pChannels, int *pFormat, int64_t *pFramesCount,
         double ratio = 1.0, double duration = 0.0);
-    // assign output wav file with given parameters
+    // assign output wav file with given parameters, other sample rate than input is converted on retrieving
     bool SetOutputFile(std::string fileName,
         int sampleRate, int channels, int format);
 
@@ -110,7 +180,7 @@ public:
 
     // compare to stretcher::channels and block size for buffer allocation/reallocation
     void PrepareInputBuffer(int channels, int blocks, size_t reserves, int prevChannels);
-    void PrepareOutputBuffer(int channels, int blocks, size_t reserves);
+    void PrepareOutputBuffer(int channels, int blocks, size_t reserves, int sampleRate);
 
     // study loaded input file for stretcher (to pitch analyzing?), ignore in realtime mode 
     void StudyInputSound(/*int blockSize*/);
@@ -118,6 +188,9 @@ public:
     int ProcessStartPad();
     // set dropping sample count for output which realtime mode has padding at begin
     void SetDropFrames(int frames) { dropFrames = frames; };
+    // after ProcessStartPad() with device streams, drop input queued while creating rubberband stretcher and
+    // arm output pre-roll sized from rubberband latency (or param), \return pre-roll frames
+    int PrepareStreamStart();
     // adjust rubberband pitch scale per process block, countIn will align to freqMap key and increase freqMap iterator
     void ApplyFreqMap(size_t countIn,/* int blockSize,*/ int *pAdjustedBlockSize = nullptr);
     
@@ -125,30 +198,68 @@ public:
     void SetInputGain(float val) { inGain = val; };
     // set output gain for clipping manipulation, default 1.f
     void SetOutputGain(float val) { outGain = val; };
+    // queue adjustment from any thread without recreating rubberband stretcher, replaces pending change of the same type
+    void PostControl(ControlChange::Type type, double value);
+    // stretcher thread only, apply queued adjustments between process blocks, \return number of applied changes
+    int ApplyControls();
     // process given block of sound file, NOTE: high relavent to sndfile seeking position
     // return input frames have done for reading
     // TODO: w/o file input, we may not able to check isFinal or not for rubberband stretcher
     bool ProcessInputSound(/*int blockSize, */int *pFrame, size_t *pCountIn);
     // only care about available data on rubberband stretcher
     bool RetrieveAvailableData(size_t *pCountOut, bool isfinal = false);
+    // block loop of processAudio() in main, shared with benchmark so both measure the same steps:
+    // (re)create, expected duration of file input, max process size, formant scale, start pad and stream start
+    void BeginProcess(int64_t inputFrames);
+    // live controls and frequency map, then process and retrieve one block, \return false if clipping occurred
+    bool ProcessBlock(int *pFrame, bool *pFinal);
+    // file to file with param->jobs != 1 and nothing that needs a single pass (gui, psola, autotune, envelope csv)
+    bool IsParallelRender() const;
+    // instead of block loop above, render loaded input file to output file in parallel segments (param->jobs),
+    // blocks until done, progress gets stitched input frames and returns false to cancel
+    bool RenderParallel(size_t *pCountIn, size_t *pCountOut, ParallelRenderer::ProgressFn progress = nullptr);
+    // batch mode of param->batchPath directory or manifest with the same options on param->jobs threads,
+    // no input/output source required, \return number of failed files, -1 if batch path is invalid
+    int ProcessBatch();
 
     // helper function if using input/output sndfiles
     void CloseInputFile();
     void CloseOutputFile();
 
-    // list audio devices via portaudio
+    // list audio devices via portaudio, enumerated once and cached, portaudio is initialized on first call
     int ListAudioDevices(std::vector<SourceDesc>& devices);
+    // enumerate devices again (re-initialize portaudio for hot plugged devices), fails if any stream is open
+    int RefreshAudioDevices(std::vector<SourceDesc>& devices);
 
     bool SetInputStream(int index, int *pSampleRate = nullptr, int *pChannels = nullptr);
-    void StartInputStream() { if (inStream) Pa_StartStream(inStream); }
-    void StopInputStream() { if (inStream) Pa_StopStream(inStream); }
-    void CloseInputStream() { if (inStream) Pa_CloseStream(inStream); inStream = nullptr; }
+    void StartInputStream() { if (inStream) Pa_StartStream(inStream); if (inVirtual) inVirtual->Start(); }
+    void StopInputStream() { if (inStream) Pa_StopStream(inStream); if (inVirtual) inVirtual->Stop(); }
+    void CloseInputStream() { if (inStream) Pa_CloseStream(inStream); inStream = nullptr; closeInputVirtual(); }
     bool SetOutputStream(int index);
-    void StartOutputStream() { if (outStream) Pa_StartStream(outStream); };
-    void StopOutputStream() { if (outStream) Pa_StopStream(outStream); };
-    void CloseOutputStream() { if (outStream) Pa_CloseStream(outStream); outStream = nullptr; };
+    void StartOutputStream() { if (outStream) Pa_StartStream(outStream); if (outVirtual) outVirtual->Start(); };
+    void StopOutputStream() { if (outStream) Pa_StopStream(outStream); if (outVirtual) outVirtual->Stop(); };
+    void CloseOutputStream() { if (outStream) Pa_CloseStream(outStream); outStream = nullptr; closeOutputVirtual(); };
+    // virtual device spec refer to VirtualDevice ctor, clock rate and jitter from parameters, pFramesCount is 0 if infinite
+    bool SetInputVirtual(std::string spec, int *pSampleRate = nullptr, int *pChannels = nullptr, int64_t *pFramesCount = nullptr);
+    bool SetOutputVirtual(std::string spec, int sampleRate, int channels);
+    VirtualDevice* GetInputVirtual() { return inVirtual; }
+    VirtualDevice* GetOutputVirtual() { return outVirtual; }
     // DEBUG: original design for waiting audio stream to receive/send audio frames in portaudio callback, now use main loop instead
     void WaitStream(int timeout = 2000) { if (inStream || outStream) Pa_Sleep(timeout); };
+    // xrun counters are increased in portaudio callbacks, readable from any thread
+    XrunCounters GetXrunCounters() const;
+    void ResetXrunCounters();
+    // loopback measurement results, updated by output callback
+    LatencyProbeStats GetLatencyProbeStats() const;
+    // f0 series of input or output (before rate conversion), tracked if GUI or --pitch-track,
+    // series outlives restarts of process so readers can keep the pointer
+    const PitchSeries* GetPitchSeries(bool output) const { return output ? outPitch.GetSeries() : inPitch.GetSeries(); }
+    PitchPoint GetLatestPitch(bool output) const { return output ? outPitch.GetLatest() : inPitch.GetLatest(); }
+    // pitch and formant in effect, loaded from parameters by first Create() then owned by stretcher thread,
+    // changed by posted controls, readable from any thread
+    double GetPitchScale() const { return pitchScale.load(); }
+    double GetFormantScale() const { return formantScale.load(); }
+    bool IsFormantEnabled() const { return formantEnabled.load(); }
     
     /* choosen source by set input stream/load input file */
     SourceDesc inSrcDesc;
@@ -167,13 +278,10 @@ public:
     float* inFrame;
     float* outFrame;
 
-    //DEBUG: try pointer of std::shared_ptr<R3Stretcher::ChannelData>
-    RubberBand::R3Stretcher::ChannelData* GetChannelData();
-
     //DEBUG: ensure rubberband library is compiled correctly
     std::string GetLibraryVersion();
 
-    /* for getting formant data */
+    /* for getting formant data, from our envelope analyzer of input rather than rubberband internals */
     enum FormantDataType : int {
         Cepstra, // fft size
         Envelope, // buf size
@@ -182,22 +290,17 @@ public:
     int GetFormantFFTSize();
     void GetFormantData(FormantDataType type, int channel, int* fftSize, double** dataPtr, int* bufSize);
     
-    /* for getting scale data */
+    /* for getting scale data, windowed input spectrum of our envelope analyzer, bin count each */
     enum ScaleDataType : int {
-        TimeDomain, // size will be fft size
-        Real, // or amplitude
+        Real,
         Imaginary,
         Magnitude,
-        Phase,
-        AdvancedPhase,
-        PreviousMagnitude,
-        PendingKick,
-        Accumulator
+        PreviousMagnitude
     };
     /* get numbers of FFT sizes for channel data scaling, given allocated fftSizes to get all size value */
     int GetChannelScaleSizes(int channel, int* fftSizes = nullptr);
-    /* get each scales data ptr */
-    void* GetChannelScaleData(ScaleDataType type, int channel, int fftSize, double** dataPtr, int* bufSize);
+    /* get each scales data ptr, \return false if fft size has no scale data */
+    bool GetChannelScaleData(ScaleDataType type, int channel, int fftSize, double** dataPtr, int* bufSize);
 
 protected:
     // make sure deconstruction will be done
@@ -210,6 +313,17 @@ protected:
 
     PaStream* inStream;
     PaStream* outStream;
+    // portaudio host api probing is slow, only initialized once a device is requested
+    bool paInitialized = false;
+    bool initAudioDevices();
+    // cached ListAudioDevices() result
+    std::vector<SourceDesc> deviceList;
+    bool deviceListValid = false;
+    // use the same callbacks as portaudio streams
+    VirtualDevice* inVirtual = nullptr;
+    VirtualDevice* outVirtual = nullptr;
+    void closeInputVirtual();
+    void closeOutputVirtual();
 
     static int inputAudioCallback(
         const void* inBuffer, void* outBuffer,
@@ -230,6 +344,21 @@ private:
 
     RubberBandStretcher *pts;
     RubberBandStretcher::Options options;
+    // created instead of pts if --psola, same process and retrieve loop
+    PsolaStretcher *psola = nullptr;
+    // prepared by Create() if tracking, fed by process and retrieve
+    PitchTracker inPitch;
+    PitchTracker outPitch;
+    // created by Create() if --autotune, pitch scale of engine is updated per block
+    AutoTune *autoTune = nullptr;
+    double autoTuneScale = 0.0; // last applied, skips unchanged updates
+    // refer to GetPitchScale(), parameters keep the startup values and are never written by stretcher thread
+    std::atomic<double> pitchScale{ 1.0 };
+    std::atomic<double> formantScale{ 0.0 };
+    std::atomic<bool> formantEnabled{ false };
+    bool controlsLoaded = false;
+    // prepared by Create() for GUI or --envelope-csv, fed by process, data pointers stay for GUI plots
+    EnvelopeAnalyzer envelope;
     
     // options from CLI or GUI from ctor to rubber band stretcher creation
     Parameters* param;
@@ -254,16 +383,26 @@ private:
 
     // sound file for input wav
     SNDFILE *sndfileIn;
+    // decodes sndfileIn ahead for ProcessInputSound(), started at first block, null if read ahead disabled
+    FileReader *fileReader = nullptr;
+    // mapped data chunk of uncompressed wav input, replaces file reader if the format is supported
+    MappedAudioFile *mappedIn = nullptr;
     // input sound info
     SF_INFO sfinfoIn;
     // sound file for output wav
     SNDFILE *sndfileOut;
+    // encodes retrieved blocks to sndfileOut on its own thread, null if write-behind disabled
+    FileWriter *fileWriter = nullptr;
     // output sound info
     SF_INFO sfinfoOut;
+    // file info of ListLocalFiles() and waveform peaks, disabled if directory parameter is empty, null until GetPeakCache()
+    PeakCache *peakCache = nullptr;
+    // ScanLocalFiles() in background, created on first scan
+    FileScanner *fileScanner = nullptr;
 
     int defBlockSize = 1024;
 
-    // for own input device, i need to check input amplitude
+    // for own input device, i need to check input amplitude (absolute peak before gain)
     float debugInMaxVal;
     // gain <-> ratio, http://www.sengpielaudio.com/calculator-FactorRatioLevelDecibel.htm
     // input power factor, default 1.f, (seems) use voltage ratio for audio float signal, pow(10.f, db / 20.f)?
@@ -278,8 +417,9 @@ private:
 
     // NOTE: due to use portaudio stream callback, buffer will be 1-dim within multi channels
     //       likes buffer[channels * block size]
-    RingBuffer<float> *inBuffer;
-    RingBuffer<float> *outBuffer;
+    // NOTE: single producer/consumer, callbacks and stretcher thread never lock each other
+    SpscRingBuffer<float> *inBuffer;
+    SpscRingBuffer<float> *outBuffer;
     // addtional buffer size, almost 1s or assign by sample rate
     size_t reserveBuffer = 32768;
     // just want to see the buffer usage
@@ -289,11 +429,62 @@ private:
     //int debugBufTimerIn = 0;
     //int debugBufTimerOut = 0;
 
-    // mutex for in/out ring buffer
-    std::mutex inMutex;
-    std::mutex outMutex;
-
-	int outDelayFrames = 2000;
+    // signalled by input callback when a block lands, and by output callback when a block is consumed
+    Semaphore inSignal;
+    Semaphore outSignal;
+    // stretcher thread never waits forever, still checks stop flag periodically
+    int signalTimeoutMs = 100;
+    // timing statistics print with buffer usage debug output
+    LatencyHistogram waitHistogram; // waiting for input block or output space
+    LatencyHistogram processHistogram; // one block from ready to processed by stretcher
+    time_t debugTimestampStats = time(nullptr);
+    std::chrono::steady_clock::time_point debugStatsWall = std::chrono::steady_clock::now();
+    std::clock_t debugStatsCpu = std::clock();
+    void printDebugStats();
+
+    // pending adjustments, stretcher thread only try_lock so never blocks on GUI thread
+    std::mutex controlMutex;
+    std::deque<ControlChange> controlQueue;
+
+    // xrun counters from in/out audio callbacks
+    std::atomic<uint64_t> inOverruns{ 0 };
+    std::atomic<uint64_t> inOverflows{ 0 };
+    std::atomic<uint64_t> outUnderruns{ 0 };
+    std::atomic<uint64_t> outUnderflows{ 0 };
+    // processed blocks dropped by stretcher thread, output ring buffer has no space
+    std::atomic<uint64_t> outOverruns{ 0 };
+
+    // output callback renders silence until this many frames are buffered, armed by PrepareStreamStart()
+    std::atomic<int> outDelayFrames{ 2000 };
+
+    // loopback latency probe, input callback mutes input around an impulse, output callback finds its peak
+    float* probeInput(float* in, unsigned long frames, const PaStreamCallbackTimeInfo* timeInfo);
+    void probeOutput(const float* out, unsigned long frames, const PaStreamCallbackTimeInfo* timeInfo);
+    std::vector<float> probeBlock; // input callback only, sized by PrepareInputBuffer
+    int probeMuted = 0; // frames of muted window left
+    int probeImpulseIn = -1; // frames until impulse in muted window, -1 if passed
+    double probeNextTime = 0.0; // adc time of next muted window
+    std::atomic<bool> probePending{ false }; // impulse injected and not yet detected
+    std::atomic<double> probeAdcTime{ 0.0 };
+    double probePeak = 0.0; // output callback peak search after first crossing, reset before probePending is set
+    double probePeakTime = 0.0;
+    double probeSearchEnd = 0.0;
+    std::atomic<uint64_t> probeCount{ 0 };
+    std::atomic<uint64_t> probeLost{ 0 };
+    std::atomic<double> probeLastMs{ 0.0 };
+    std::atomic<double> probeMinMs{ 0.0 };
+    std::atomic<double> probeMaxMs{ 0.0 };
+    std::atomic<double> probeSumMs{ 0.0 };
+    uint64_t probePrinted = 0; // stretcher thread, measurements already printed
+
+    // output channel routing for interleave kernel, rebuilt when in/out channels changed
+    ChannelMap channelMap;
+    void updateChannelMap(int inChannels, int outChannels);
+
+    // converts retrieved blocks from input rate to output file or device rate, null if both are the same
+    Resampler *resampler = nullptr;
+    std::vector<float> resampleBuffer;
+    void updateResampler(int channels, int inRate, int outRate);
 
     int dropFrames;
     bool ignoreClipping;
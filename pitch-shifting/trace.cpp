@@ -0,0 +1,197 @@
+#include "trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+using std::cerr;
+using std::endl;
+
+namespace PitchShifting {
+namespace Trace {
+
+std::atomic<bool> enabled{ false };
+
+struct Event {
+    const char* name;
+    uint64_t begin;
+    uint64_t end;
+    int tid; // of the thread that held the buffer
+};
+
+/* single writer (owner thread), the dump only reads events below count */
+struct ThreadBuffer {
+    Event* events = nullptr;
+    size_t capacity = 0;
+    std::atomic<size_t> count{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<bool> inUse{ false };
+};
+
+// buffers are allocated and registered by Start() before recording, a thread claims a free one on its first event
+// by an atomic flag, so the first event of audio callback threads never allocates or locks,
+// a thread returns its buffer when it exits and the next thread appends after the recorded events under its own tid,
+// buffers live until process exit because threads may outlive the dump
+static const int maxThreads = 32;
+// names of tids, later threads are unnamed in the dump
+static const int maxNames = 1024;
+static std::mutex registryMutex;
+static ThreadBuffer* pool[maxThreads] = { nullptr };
+static std::atomic<int> poolSize{ 0 }; // published after buffers are ready
+static std::atomic<int> nextTid{ 1 };
+static char names[maxNames][32] = { { 0 } };
+static std::atomic<uint64_t> unclaimedDropped{ 0 }; // events while all buffers are held by running threads
+static std::string traceFile;
+static uint64_t origin = 0;
+
+/* buffer of calling thread, returned to pool by thread exit */
+struct LocalClaim {
+    ThreadBuffer* buffer = nullptr;
+    int tid = 0;
+    ~LocalClaim() {
+        if (buffer) buffer->inUse.store(false, std::memory_order_release);
+    }
+};
+static thread_local LocalClaim local;
+
+static ThreadBuffer* threadBuffer() {
+    if (local.buffer) return local.buffer;
+    int size = poolSize.load(std::memory_order_acquire);
+    // not started yet or all buffers held, try again on a later event
+    while (!local.buffer) {
+        // the free buffer with most room, short lived threads spread over the pool instead of filling the first one
+        ThreadBuffer* best = nullptr;
+        for (int i = 0; i < size; ++i) {
+            ThreadBuffer* buf = pool[i];
+            if (buf->inUse.load(std::memory_order_relaxed)) continue;
+            if (!best || buf->count.load(std::memory_order_relaxed) < best->count.load(std::memory_order_relaxed)) best = buf;
+        }
+        if (!best) break;
+        bool expected = false;
+        if (best->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            local.buffer = best;
+            local.tid = nextTid.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    return local.buffer;
+}
+
+uint64_t Now() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Record(const char* name, uint64_t begin, uint64_t end) {
+    ThreadBuffer* buf = threadBuffer();
+    if (!buf) {
+        unclaimedDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    size_t n = buf->count.load(std::memory_order_relaxed);
+    if (n >= buf->capacity) {
+        buf->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buf->events[n] = { name, begin, end, local.tid };
+    buf->count.store(n + 1, std::memory_order_release);
+}
+
+void SetThreadName(const char* name) {
+    if (!enabled.load(std::memory_order_relaxed)) return;
+    if (!threadBuffer() || local.tid > maxNames) return;
+    char* slot = names[local.tid - 1];
+    if (slot[0] == '\0') {
+        size_t len = strlen(name);
+        if (len >= sizeof(names[0])) len = sizeof(names[0]) - 1;
+        memcpy(slot, name, len);
+    }
+}
+
+bool Start(const std::string& file, size_t eventsPerThread) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    traceFile = file;
+    // the pool is allocated by the first start, later starts reuse it with its capacity
+    if (poolSize.load(std::memory_order_relaxed) == 0) {
+        for (int i = 0; i < maxThreads; ++i) {
+            ThreadBuffer* buf = new ThreadBuffer();
+            buf->events = new Event[eventsPerThread];
+            buf->capacity = eventsPerThread;
+            pool[i] = buf;
+        }
+        poolSize.store(maxThreads, std::memory_order_release);
+    }
+    for (int i = 0; i < maxThreads; ++i) {
+        pool[i]->count.store(0, std::memory_order_relaxed);
+        pool[i]->dropped.store(0, std::memory_order_relaxed);
+    }
+    unclaimedDropped.store(0, std::memory_order_relaxed);
+    origin = Now();
+    enabled.store(true);
+    cerr << "Trace recording to " << file << endl;
+    return true;
+}
+
+/* escape for json string, names are literals so only quote and backslash matter */
+static void writeName(std::ofstream& out, const char* name) {
+    out << '"';
+    for (const char* p = name; *p; ++p) {
+        if (*p == '"' || *p == '\\') out << '\\';
+        out << *p;
+    }
+    out << '"';
+}
+
+bool Stop() {
+    if (!enabled.exchange(false)) return false;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::ofstream out(traceFile);
+    if (!out) {
+        cerr << "ERROR: Failed to write trace file \"" << traceFile << "\"" << endl;
+        return false;
+    }
+    // avoid scientific notation of large timestamps
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    size_t total = 0;
+    uint64_t dropped = 0;
+    bool first = true;
+    int buffers = poolSize.load(std::memory_order_acquire);
+    int tids = std::min(nextTid.load(std::memory_order_relaxed) - 1, maxNames);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (int t = 0; t < tids; ++t) {
+        if (names[t][0] == '\0') continue;
+        out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t + 1 << ",\"args\":{\"name\":";
+        writeName(out, names[t]);
+        out << "}}";
+        first = false;
+    }
+    for (int b = 0; b < buffers; ++b) {
+        ThreadBuffer* buf = pool[b];
+        // events below count are complete, writer may still append while dumping
+        size_t n = buf->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < n; ++i) {
+            const Event& e = buf->events[i];
+            if (e.begin < origin) continue;
+            out << (first ? "\n" : ",\n") << "{\"name\":";
+            writeName(out, e.name);
+            // chrome trace timestamps are microseconds
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.tid
+                << ",\"ts\":" << (e.begin - origin) / 1000.0
+                << ",\"dur\":" << (e.end - e.begin) / 1000.0 << "}";
+            first = false;
+        }
+        total += n;
+        dropped += buf->dropped.load(std::memory_order_relaxed);
+    }
+    dropped += unclaimedDropped.load(std::memory_order_relaxed);
+    out << "\n]}\n";
+    cerr << "Trace written " << total << " events of " << nextTid.load(std::memory_order_relaxed) - 1 << " threads to " << traceFile
+        << ", dropped " << dropped << endl;
+    return true;
+}
+
+} // namespace Trace
+} // namespace PitchShifting
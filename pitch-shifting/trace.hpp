@@ -0,0 +1,54 @@
+#pragma once
+/*
+ * scoped trace points for hot path stages, dumped as chrome trace json (chrome://tracing or ui.perfetto.dev)
+ *   - TRACE_SCOPE("name") records begin/duration of the enclosing scope on the calling thread
+ *   - each thread appends to its own fixed size event buffer, buffers of up to 32 running threads are allocated by
+ *     Start(), a thread claims a free one by an atomic flag and returns it on exit, recording never locks or allocates
+ *     (safe in audio callbacks)
+ *   - disabled by default, a disabled scope costs one relaxed atomic load
+ * NOTE: name must be a string literal or outlive the trace dump, only the pointer is stored
+ */
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace PitchShifting {
+namespace Trace {
+
+extern std::atomic<bool> enabled;
+
+/* start recording, events are written to given file by Stop(), the first start allocates thread buffers */
+bool Start(const std::string& file, size_t eventsPerThread = 1 << 17);
+/* stop recording and write recorded events of all threads, \return false if file failed */
+bool Stop();
+
+/* label calling thread in trace viewer, only the first call of a thread takes effect */
+void SetThreadName(const char* name);
+
+/* monotonic clock in nanoseconds */
+uint64_t Now();
+/* append a complete event to calling thread buffer, dropped if buffer is full or all buffers are held by running threads */
+void Record(const char* name, uint64_t begin, uint64_t end);
+
+class Scope {
+public:
+    explicit Scope(const char* name) : name(enabled.load(std::memory_order_relaxed) ? name : nullptr) {
+        if (Scope::name) begin = Now();
+    }
+    ~Scope() {
+        if (name) Record(name, begin, Now());
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* name;
+    uint64_t begin = 0;
+};
+
+} // namespace Trace
+} // namespace PitchShifting
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) PitchShifting::Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
@@ -0,0 +1,235 @@
+#include "virtualdevice.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+using std::cerr;
+using std::endl;
+
+namespace PitchShifting {
+
+static const double twoPi = 6.283185307179586;
+
+VirtualDevice::VirtualDevice(Direction direction, const std::string& spec) : direction(direction) {
+    memset(&sfinfo, 0, sizeof(SF_INFO));
+    if (spec.empty() || spec == "null") {
+        signal = Signal::Null;
+    }
+    else if (direction == Direction::Input && spec.rfind("sine", 0) == 0 && (spec.size() == 4 || spec[4] == ':')) {
+        signal = Signal::Sine;
+        if (spec.size() > 5) {
+            frequency = atof(spec.c_str() + 5);
+        }
+        if (frequency <= 0.0) frequency = 440.0;
+    }
+    else if (direction == Direction::Input && spec == "noise") {
+        signal = Signal::Noise;
+    }
+    else if (direction == Direction::Output && spec == "mem") {
+        signal = Signal::Memory;
+    }
+    else {
+        signal = Signal::File;
+        path = spec;
+    }
+}
+
+VirtualDevice::~VirtualDevice() {
+    Close();
+}
+
+std::string
+VirtualDevice::GetName() const {
+    switch (signal) {
+    case Signal::Null: return "virtual:null";
+    case Signal::Sine: return "virtual:sine:" + std::to_string((int)frequency);
+    case Signal::Noise: return "virtual:noise";
+    case Signal::Memory: return "virtual:mem";
+    case Signal::File: return "virtual:" + path;
+    }
+    return "virtual";
+}
+
+bool
+VirtualDevice::Open(int sampleRate, int channels, unsigned long framesPerBuffer,
+    PaStreamCallback* callback, void* userData) {
+    Close();
+    VirtualDevice::sampleRate = sampleRate;
+    VirtualDevice::channels = channels;
+    VirtualDevice::framesPerBuffer = framesPerBuffer;
+    VirtualDevice::callback = callback;
+    VirtualDevice::userData = userData;
+
+    if (signal == Signal::File) {
+        memset(&sfinfo, 0, sizeof(SF_INFO));
+        if (direction == Direction::Input) {
+            sndfile = sf_open(path.c_str(), SFM_READ, &sfinfo);
+            if (!sndfile || sfinfo.samplerate == 0) {
+                cerr << "ERROR: Failed to open virtual input file \"" << path << "\": " << sf_strerror(sndfile) << endl;
+                return false;
+            }
+            // source format follows the file
+            VirtualDevice::sampleRate = sfinfo.samplerate;
+            VirtualDevice::channels = sfinfo.channels;
+            lengthFrames = sfinfo.frames;
+        }
+        else {
+            sfinfo.samplerate = sampleRate;
+            sfinfo.channels = channels;
+            sfinfo.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+            sndfile = sf_open(path.c_str(), SFM_WRITE, &sfinfo);
+            if (!sndfile) {
+                cerr << "ERROR: Failed to open virtual output file \"" << path << "\": " << sf_strerror(sndfile) << endl;
+                return false;
+            }
+        }
+    }
+    captured.clear();
+    position = 0;
+    phase = 0.0;
+    buffer = new float[(size_t)VirtualDevice::channels * framesPerBuffer];
+    memset(buffer, 0, sizeof(float) * VirtualDevice::channels * framesPerBuffer);
+    return true;
+}
+
+bool
+VirtualDevice::Start() {
+    if (!callback || !buffer) return false;
+    if (running) return true;
+    callbacks = 0;
+    lateCallbacks = 0;
+    running = true;
+    clockThread = new std::thread(&VirtualDevice::run, this);
+    return true;
+}
+
+void
+VirtualDevice::Stop() {
+    running = false;
+    if (clockThread) {
+        clockThread->join();
+        delete clockThread;
+        clockThread = nullptr;
+    }
+}
+
+void
+VirtualDevice::Close() {
+    Stop();
+    if (sndfile) {
+        sf_close(sndfile);
+        sndfile = nullptr;
+    }
+    if (buffer) {
+        delete[] buffer;
+        buffer = nullptr;
+    }
+}
+
+void
+VirtualDevice::run() {
+    using clock = std::chrono::steady_clock;
+    // fixed seed, jitter pattern is reproducible between runs
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> jitter(-jitterMs, jitterMs);
+    const double blockSec = (double)framesPerBuffer / sampleRate;
+    const auto begin = clock::now();
+    uint64_t block = 0;
+
+    while (running) {
+        double period = (rate > 0.0) ? blockSec / rate : 0.0;
+        if (rate > 0.0) {
+            // deadline from the beginning instead of last callback, so the clock never drifts
+            double offset = block * period + (jitterMs > 0.0 ? jitter(rng) / 1000.0 : 0.0);
+            auto deadline = begin + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(offset > 0.0 ? offset : 0.0));
+            std::this_thread::sleep_until(deadline);
+            if (clock::now() - deadline > std::chrono::duration<double>(period)) {
+                lateCallbacks.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        PaStreamCallbackTimeInfo timeInfo;
+        // steady clock is shared by all virtual devices, times of input and output are comparable like
+        // streams of the same portaudio host api
+        timeInfo.currentTime = std::chrono::duration<double>(clock::now().time_since_epoch()).count();
+        timeInfo.inputBufferAdcTime = timeInfo.currentTime - period;
+        timeInfo.outputBufferDacTime = timeInfo.currentTime + period;
+
+        int result;
+        if (direction == Direction::Input) {
+            fillInput(buffer, framesPerBuffer);
+            result = callback(buffer, nullptr, framesPerBuffer, &timeInfo, 0, userData);
+        }
+        else {
+            result = callback(nullptr, buffer, framesPerBuffer, &timeInfo, 0, userData);
+            consumeOutput(buffer, framesPerBuffer);
+        }
+        callbacks.fetch_add(1, std::memory_order_relaxed);
+        ++block;
+        if (result != paContinue) break;
+    }
+    running = false;
+}
+
+void
+VirtualDevice::fillInput(float* buf, unsigned long frames) {
+    unsigned long count = frames;
+    // source ends like an idle microphone, keeps clocking silence
+    if (lengthFrames > 0 && position + (int64_t)count > lengthFrames) {
+        count = (position < lengthFrames) ? (unsigned long)(lengthFrames - position) : 0;
+    }
+    switch (signal) {
+    case Signal::Sine: {
+        const double step = twoPi * frequency / sampleRate;
+        for (unsigned long i = 0; i < count; ++i) {
+            float v = 0.5f * (float)sin(phase);
+            phase += step;
+            if (phase > twoPi) phase -= twoPi;
+            for (int c = 0; c < channels; ++c) buf[i * channels + c] = v;
+        }
+        break;
+    }
+    case Signal::Noise:
+        for (unsigned long i = 0; i < count * channels; ++i) {
+            // xorshift32, cheap and deterministic
+            noiseState ^= noiseState << 13;
+            noiseState ^= noiseState >> 17;
+            noiseState ^= noiseState << 5;
+            buf[i] = (float)noiseState / 4294967296.f - 0.5f;
+        }
+        break;
+    case Signal::File:
+        if (count > 0) {
+            sf_count_t read = sf_readf_float(sndfile, buf, count);
+            count = (read > 0) ? (unsigned long)read : 0;
+        }
+        break;
+    default:
+        count = 0;
+        break;
+    }
+    if (count < frames) {
+        memset(buf + (size_t)count * channels, 0, sizeof(float) * (frames - count) * channels);
+    }
+    position += count;
+}
+
+void
+VirtualDevice::consumeOutput(const float* buf, unsigned long frames) {
+    switch (signal) {
+    case Signal::Memory:
+        captured.insert(captured.end(), buf, buf + (size_t)frames * channels);
+        break;
+    case Signal::File:
+        sf_writef_float(sndfile, buf, frames);
+        break;
+    default:
+        break;
+    }
+    position += frames;
+}
+
+} // namespace PitchShifting
@@ -0,0 +1,99 @@
+#pragma once
+/*
+ * headless audio device, drives the portaudio style stream callback from its own clock thread,
+ * for load testing the realtime path (callbacks, ring buffers, stretcher thread wakeup) without a sound card
+ *   - input source: silence, sine, white noise or wav file clocked into the callback
+ *   - output sink: rendered frames discarded, captured in memory or written to wav file
+ * NOTE: callback runs on the virtual device thread instead of audio driver thread, with the same block timing
+ */
+#include <portaudio.h>
+#include <sndfile.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace PitchShifting {
+
+class VirtualDevice {
+public:
+    enum Direction {
+        Input,
+        Output
+    };
+    enum Signal {
+        Null, // silence, or discard for output
+        Sine, // "sine" or "sine:<hz>", 440Hz by default
+        Noise, // white noise
+        Memory, // output only, capture rendered frames
+        File // wav file path
+    };
+
+    /* spec for input "null", "sine", "sine:<hz>", "noise" or wav file path; for output "null", "mem" or wav file path */
+    VirtualDevice(Direction direction, const std::string& spec);
+    virtual ~VirtualDevice();
+    VirtualDevice(const VirtualDevice&) = delete;
+    VirtualDevice& operator=(const VirtualDevice&) = delete;
+
+    /* open source/sink, input wav file overrides given sample rate and channels, \return false if file failed */
+    bool Open(int sampleRate, int channels, unsigned long framesPerBuffer,
+        PaStreamCallback* callback, void* userData);
+    // clock rate, 1.0 is wall clock, 4.0 is 4 times faster, 0 runs as fast as the callback returns
+    void SetRate(double val) { rate = val; };
+    // random offset in milliseconds on each callback deadline, simulates driver scheduling jitter
+    void SetJitter(double ms) { jitterMs = ms; };
+    // input only, source frames before falling back to silence, 0 for infinite synthetic signal
+    void SetLength(int64_t frames) { lengthFrames = frames; };
+
+    bool Start();
+    void Stop();
+    void Close();
+    bool IsActive() const { return running.load(); }
+
+    int GetSampleRate() const { return sampleRate; }
+    int GetChannels() const { return channels; }
+    /* input frames of source, wav file frames or given length, 0 for infinite */
+    int64_t GetLength() const { return lengthFrames; }
+    std::string GetName() const;
+    /* output captured frames if spec is "mem", interleaved */
+    const std::vector<float>& GetCaptured() const { return captured; }
+    uint64_t GetCallbackCount() const { return callbacks.load(); }
+    /* callbacks fired later than one block period after deadline */
+    uint64_t GetLateCount() const { return lateCallbacks.load(); }
+
+private:
+    void run();
+    void fillInput(float* buf, unsigned long frames);
+    void consumeOutput(const float* buf, unsigned long frames);
+
+    Direction direction;
+    Signal signal = Signal::Null;
+    std::string path;
+    double frequency = 440.0;
+    double phase = 0.0;
+    uint32_t noiseState = 22222;
+
+    int sampleRate = 48000;
+    int channels = 2;
+    unsigned long framesPerBuffer = 1024;
+    double rate = 1.0;
+    double jitterMs = 0.0;
+    int64_t lengthFrames = 0;
+    int64_t position = 0;
+
+    PaStreamCallback* callback = nullptr;
+    void* userData = nullptr;
+    float* buffer = nullptr;
+
+    SNDFILE* sndfile = nullptr;
+    SF_INFO sfinfo;
+    std::vector<float> captured;
+
+    std::thread* clockThread = nullptr;
+    std::atomic<bool> running{ false };
+    std::atomic<uint64_t> callbacks{ 0 };
+    std::atomic<uint64_t> lateCallbacks{ 0 };
+};
+
+} // namespace PitchShifting
@@ -0,0 +1,74 @@
+#include "workerpool.hpp"
+
+namespace PitchShifting {
+
+// worker index of current thread, set by worker loop
+static thread_local const WorkerPool* currentPool = nullptr;
+static thread_local int currentIndex = -1;
+
+WorkerPool::WorkerPool(int threads) {
+    if (threads <= 0) {
+        threads = (int)std::thread::hardware_concurrency();
+        if (threads <= 0) threads = 1;
+    }
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back(&WorkerPool::run, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    Wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    taskCond.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void
+WorkerPool::Submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    taskCond.notify_one();
+}
+
+void
+WorkerPool::Wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idleCond.wait(lock, [this] { return tasks.empty() && busy == 0; });
+}
+
+int
+WorkerPool::GetWorkerIndex() const {
+    return (currentPool == this) ? currentIndex : -1;
+}
+
+void
+WorkerPool::run(int index) {
+    currentPool = this;
+    currentIndex = index;
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskCond.wait(lock, [this] { return quit || !tasks.empty(); });
+            if (tasks.empty()) break; // quit
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            busy++;
+        }
+        task();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy--;
+            if (tasks.empty() && busy == 0) idleCond.notify_all();
+        }
+    }
+}
+
+} // namespace PitchShifting
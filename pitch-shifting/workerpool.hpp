@@ -0,0 +1,44 @@
+#pragma once
+/*
+ * fixed size worker thread pool for offline jobs (segment rendering, batch files),
+ * tasks run in submit order but may complete out of order, caller collects results by itself
+ * NOTE: not for realtime path, Submit() and task queue lock a mutex
+ */
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace PitchShifting {
+
+class WorkerPool {
+public:
+    /* threads <= 0 uses hardware concurrency */
+    explicit WorkerPool(int threads = 0);
+    /* waits for queued tasks then joins workers */
+    virtual ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void Submit(std::function<void()> task);
+    /* block until queue is empty and all workers are idle */
+    void Wait();
+    int GetThreadCount() const { return (int)workers.size(); }
+    /* index of calling worker thread in [0, GetThreadCount()), -1 if not a worker of this pool */
+    int GetWorkerIndex() const;
+
+private:
+    void run(int index);
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable taskCond;
+    std::condition_variable idleCond;
+    int busy = 0;
+    bool quit = false;
+};
+
+} // namespace PitchShifting